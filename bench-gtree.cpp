@@ -0,0 +1,378 @@
+typedef int GTREE_TYPE;
+
+#include "benchmark/benchmark.h"
+#include "gtree-gen.h"
+#include <vector>
+
+bool gTree_storeData(int data, size_t level, FILE *out)
+{
+    for (size_t i = 0; i < level; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "%d\n", data);
+    return 0;
+}
+
+bool gTree_restoreData(int *data, FILE *in)
+{
+    char buffer[MAX_BUFFER_LEN] = "";
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1 || sscanf(buffer, "%d", data) != 1)
+        return 1;
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1)
+        return 1;
+    return !consistsOnly(buffer, "]");
+}
+
+bool gTree_printData(int data, FILE *out)
+{
+    fprintf(out, "%d", data);
+    return 0;
+}
+
+enum Shape
+{
+    Shape_Chain,
+    Shape_Star,
+    Shape_Random,
+    Shape_Kary,
+    Shape_Cnt,
+};
+
+static const char *shapeNames[Shape_Cnt] = {"chain", "star", "random", "4-ary"};
+
+static const size_t MAX_STORED_DEPTH = 1000;        /// Deeper chains are indented past the restore line buffer
+
+static const gTree_GenParams shapeParams[Shape_Cnt] = {
+        {gTree_gen_Chain,     0, 0,   0, NULL, NULL, NULL},
+        {gTree_gen_Star,      0, 0,   0, NULL, NULL, NULL},
+        {gTree_gen_Recursive, 0, 179, 0, NULL, NULL, NULL},
+        {gTree_gen_Kary,      0, 0,   4, NULL, NULL, NULL},
+    };
+
+/**
+ * @brief builds tree of n nodes of the shape under the root, returns ids in insertion order
+ */
+static std::vector<size_t> buildShape(gTree *tree, Shape shape, size_t n)
+{
+    gTree_GenParams params = shapeParams[shape];
+    params.nodeCnt = n;
+    std::vector<size_t> ids(n);
+    gTree_generate(tree, tree->root, &params, ids.data());
+    return ids;
+}
+
+static std::vector<size_t> preorderIds(const gTree *tree)
+{
+    std::vector<size_t> ids;
+    for (size_t id = tree->root; id != -1; id = gTree_nextPreorder(tree, tree->root, id))
+        ids.push_back(id);
+    return ids;
+}
+
+/**
+ * @brief frees everything but the root without recursion
+ */
+static void clearTree(gTree *tree)
+{
+    while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child != -1)
+        gTree_delSubtreeDeferred(tree, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child);
+    gTree_collectDeferred(tree, -1, NULL);
+}
+
+/**
+ * @brief reports bytes per node of the tree (call while the tree is full)
+ */
+static void reportMemory(benchmark::State &state, const gTree *tree)
+{
+    gTree_MemoryUsage usage = {};
+    gTree_memoryUsage(tree, &usage);
+    state.SetLabel(shapeNames[state.range(0)]);
+    state.counters["bytes/node"] = (double)usage.total / tree->nodeCnt;
+}
+
+static void BM_addChild(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    gTree_GenParams params = shapeParams[shape];
+    params.nodeCnt = n;
+    std::vector<size_t> parents(n), ids(n);
+    gTree_genParents(&params, parents.data());
+    for (auto _ : state) {
+        ids[0] = tree.root;
+        for (size_t i = 1; i < n; ++i)
+            gTree_addChild(&tree, ids[parents[i]], &ids[i], i);
+        state.PauseTiming();
+        reportMemory(state, &tree);
+        clearTree(&tree);
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * (n - 1));
+}
+
+static void BM_addSibling(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<size_t> ids = buildShape(&tree, shape, n / 2);
+        std::vector<size_t> firstIds;
+        for (size_t id : ids)
+            if (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, id)->child != -1)
+                firstIds.push_back(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, id)->child);
+        state.ResumeTiming();
+        size_t id = -1;
+        for (size_t i = n / 2; i < n; ++i)
+            gTree_addSibling(&tree, firstIds[i % firstIds.size()], &id, i);
+        state.PauseTiming();
+        reportMemory(state, &tree);
+        clearTree(&tree);
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * (n - n / 2));
+}
+
+static void BM_addExistChild(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    for (auto _ : state) {
+        state.PauseTiming();
+        buildShape(&tree, shape, n);
+        reportMemory(state, &tree);
+        std::vector<size_t> ids = preorderIds(&tree);
+        std::vector<size_t> parents(n);
+        for (size_t i = 1; i < n; ++i) {
+            parents[i] = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, ids[i])->parent;
+            gTree_unlinkNode(&tree, ids[i]);           // in preorder every node is the first child by now
+        }
+        state.ResumeTiming();
+        for (size_t i = 1; i < n; ++i)
+            gTree_addExistChild(&tree, parents[i], ids[i]);
+        state.PauseTiming();
+        clearTree(&tree);
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * (n - 1));
+}
+
+static void BM_delChild(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    for (auto _ : state) {
+        state.PauseTiming();
+        buildShape(&tree, shape, n);
+        reportMemory(state, &tree);
+        state.ResumeTiming();
+        while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, tree.root)->child != -1)
+            gTree_delChild(&tree, tree.root, 0, NULL);
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * (n - 1));
+}
+
+static void BM_delSubtree(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    for (auto _ : state) {
+        state.PauseTiming();
+        buildShape(&tree, shape, n);
+        reportMemory(state, &tree);
+        state.ResumeTiming();
+        while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, tree.root)->child != -1)
+            gTree_delSubtree(&tree, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, tree.root)->child);
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * (n - 1));
+}
+
+static void BM_killSubtree(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    for (auto _ : state) {
+        state.PauseTiming();
+        buildShape(&tree, shape, n);
+        reportMemory(state, &tree);
+        std::vector<size_t> childIds;
+        for (size_t id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, tree.root)->child; id != -1;
+                                                    id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, id)->sibling)
+            childIds.push_back(id);
+        state.ResumeTiming();
+        for (size_t id : childIds)
+            gTree_killSubtree(&tree, id);
+        state.PauseTiming();
+        GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, tree.root)->child = -1;
+        GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, tree.root)->tail  = -1;
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * (n - 1));
+}
+
+static void BM_cloneSubtree(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    buildShape(&tree, shape, n);
+    for (auto _ : state) {
+        size_t cloneId = -1;
+        gTree_cloneSubtree(&tree, tree.root, &cloneId);
+        state.PauseTiming();
+        reportMemory(state, &tree);
+        gTree_delSubtreeDeferred(&tree, cloneId);
+        gTree_collectDeferred(&tree, -1, NULL);
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+static void BM_replaceNode(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    size_t opCnt = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        buildShape(&tree, shape, n);
+        std::vector<size_t> targetIds;          // first children, so that sibling walks do not dominate
+        for (size_t id : preorderIds(&tree))
+            if (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, id)->child != -1)
+                targetIds.push_back(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, id)->child);
+        size_t scratchId = -1, id = -1;
+        gTree_addChild(&tree, tree.root, &scratchId, 0);
+        gTree_unlinkNode(&tree, scratchId);
+        for (size_t i = 0; i < targetIds.size(); ++i)
+            gTree_addChild(&tree, scratchId, &id, i);
+        std::vector<size_t> replaceIds;
+        while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, scratchId)->child != -1) {
+            replaceIds.push_back(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, scratchId)->child);
+            gTree_unlinkNode(&tree, replaceIds.back());
+        }
+        reportMemory(state, &tree);
+        opCnt += targetIds.size();
+        state.ResumeTiming();
+        for (size_t i = 0; i < targetIds.size(); ++i)
+            gTree_replaceNode(&tree, targetIds[i], replaceIds[i]);
+        state.PauseTiming();
+        gTree_collectGarbage(&tree, -1, NULL, NULL);
+        clearTree(&tree);
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(opCnt);
+}
+
+static void BM_store(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    buildShape(&tree, shape, n);
+    for (auto _ : state) {
+        FILE *out = tmpfile();
+        gTree_storeSubTree(&tree, tree.root, 0, out);
+        fflush(out);
+        state.PauseTiming();
+        reportMemory(state, &tree);
+        fclose(out);
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+static void BM_restore(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    buildShape(&tree, shape, n);
+    FILE *stored = tmpfile();
+    gTree_storeSubTree(&tree, tree.root, 0, stored);
+    gTree_dtor(&tree);
+
+    for (auto _ : state) {
+        rewind(stored);
+        gTree restored;
+        gTree_restoreTree(&restored, NULL, stored);
+        state.PauseTiming();
+        reportMemory(state, &restored);
+        clearTree(&restored);
+        gTree_dtor(&restored);
+        state.ResumeTiming();
+    }
+    fclose(stored);
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+static void BM_dumpGraphViz(benchmark::State &state)
+{
+    Shape shape = (Shape)state.range(0);
+    size_t n = state.range(1);
+    gTree tree;
+    gTree_ctor(&tree, NULL);
+    buildShape(&tree, shape, n);
+    for (auto _ : state) {
+        FILE *out = tmpfile();
+        gTree_dumpPoolGraphViz(&tree, out);
+        fflush(out);
+        state.PauseTiming();
+        reportMemory(state, &tree);
+        fclose(out);
+        state.ResumeTiming();
+    }
+    gTree_dtor(&tree);
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+/**
+ * @brief all shapes and sizes from 1e3 to 1e7, chains of store and restore are capped
+ */
+template <bool stored>
+static void shapesAndSizes(benchmark::internal::Benchmark *bench)
+{
+    for (int shape = 0; shape < Shape_Cnt; ++shape)
+        for (int64_t n = 1000; n <= 10000000; n *= 10)
+            if (!stored || shape != Shape_Chain || n <= (int64_t)MAX_STORED_DEPTH)
+                bench->Args({shape, n});
+    bench->ArgNames({"shape", "n"})->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_addChild)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_addSibling)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_addExistChild)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_delChild)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_delSubtree)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_killSubtree)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_cloneSubtree)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_replaceNode)->Apply(shapesAndSizes<false>);
+BENCHMARK(BM_store)->Apply(shapesAndSizes<true>);
+BENCHMARK(BM_restore)->Apply(shapesAndSizes<true>);
+BENCHMARK(BM_dumpGraphViz)->Apply(shapesAndSizes<false>);
+
+BENCHMARK_MAIN();
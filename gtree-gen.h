@@ -0,0 +1,303 @@
+#pragma once
+
+/**
+ * @file Header containing seeded generators of gTree shapes for tests and benchmarks
+ */
+
+#include "gtree.h"
+
+
+/**
+ * @brief shapes the generator is able to build
+ */
+enum gTree_GenShape
+{
+    gTree_gen_Chain,                /// Every node is the only child of the previous one
+    gTree_gen_Star,                 /// Every node is a child of the root
+    gTree_gen_Kary,                 /// Complete k-ary tree filled in BFS order
+    gTree_gen_Recursive,            /// Random recursive tree: parent is uniform among earlier nodes
+    gTree_gen_Preferential,         /// Preferential attachment: parent is chosen proportionally to (fan-out + 1)
+    gTree_gen_GaltonWatson,         /// Galton-Watson tree conditioned on the node count
+    gTree_gen_Replay,               /// Tree replayed from a recorded parent array
+    gTree_gen_Cnt,
+};
+
+static const char gTree_genShapeMsg[gTree_gen_Cnt][MAX_MSG_LEN] = {
+        "chain",
+        "star",
+        "k-ary",
+        "recursive",
+        "preferential",
+        "galton-watson",
+        "replay",
+    };
+
+/**
+ * @brief user-provided payload for the idx-th generated node
+ */
+typedef GTREE_TYPE (*gTree_GenDataFunc)(size_t idx, void *arg);
+
+/**
+ * @brief generator parameters, node 0 of the shape is the node the tree is built under
+ */
+struct gTree_GenParams
+{
+    gTree_GenShape shape;
+    size_t nodeCnt;                 /// Number of nodes in the shape including its root
+    uint64_t seed;                  /// Seed of the random shapes
+    size_t arity;                   /// Fan-out of the k-ary tree; offspring law of Galton-Watson: Binomial(arity) or Poisson if 0
+    const size_t *parents;          /// Replayed parent array: parents[i] < i for every i > 0, parents[0] is ignored
+    gTree_GenDataFunc dataFunc;     /// Payload of the generated nodes (value-initialized if NULL)
+    void *dataArg;
+};
+
+
+/**
+ * @brief splitmix64 step, the generated shapes do not depend on the standard library
+ */
+static inline uint64_t gTree_genNext(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief draw in [0, n): the high half of the 128-bit product of a random word and n, built from 32x32 products
+ */
+static inline size_t gTree_genUniform(uint64_t *state, size_t n)
+{
+    uint64_t x = gTree_genNext(state), y = n;
+    uint64_t xLo = x & 0xFFFFFFFFull, xHi = x >> 32;
+    uint64_t yLo = y & 0xFFFFFFFFull, yHi = y >> 32;
+    uint64_t lolo = xLo * yLo, hilo = xHi * yLo, lohi = xLo * yHi;
+    uint64_t mid  = (lolo >> 32) + (hilo & 0xFFFFFFFFull) + lohi;     // fits: (2^32 - 1)^2 + 2 * (2^32 - 1) < 2^64
+    return (size_t)(xHi * yHi + (hilo >> 32) + (mid >> 32));
+}
+
+
+/**
+ * @brief offspring counts of a Galton-Watson tree conditioned on n nodes, listed in preorder
+ *        (n - 1 balls over n parents, then the cyclic shift that makes a valid Lukasiewicz path)
+ */
+static gTree_status gTree_genGaltonWatson(size_t n, size_t arity, uint64_t *state, size_t *offspring)
+{
+    size_t *shifted = (size_t*)calloc(n, sizeof(size_t));
+    if (shifted == NULL)
+        return gTree_status_AllocErr;
+
+    if (arity == 0) {
+        for (size_t i = 0; i + 1 < n; ++i)
+            ++shifted[gTree_genUniform(state, n)];
+    } else {
+        if (n * arity < n - 1) {
+            free(shifted);
+            return gTree_status_BadData;
+        }
+        size_t slotCnt = n * arity;     /// n - 1 distinct slots out of n * arity (Floyd's sampling)
+        uint64_t *seen = (uint64_t*)calloc((slotCnt + 63) / 64, sizeof(uint64_t));
+        if (seen == NULL) {
+            free(shifted);
+            return gTree_status_AllocErr;
+        }
+        for (size_t j = slotCnt - (n - 1); j < slotCnt; ++j) {
+            size_t slot = gTree_genUniform(state, j + 1);
+            if (!gTree_bitSet(seen, slot))
+                gTree_bitSet(seen, slot = j);
+            ++shifted[slot / arity];
+        }
+        free(seen);
+    }
+
+    size_t start = 0;
+    int64_t walk = 0, minWalk = 0;
+    for (size_t i = 0; i < n; ++i) {
+        walk += (int64_t)shifted[i] - 1;
+        if (walk < minWalk) {
+            minWalk = walk;
+            start = i + 1;
+        }
+    }
+    for (size_t i = 0; i < n; ++i)
+        offspring[i] = shifted[(start + i) % n];
+    free(shifted);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief fills parent indices of the shape: parents[0] = -1 and parents[i] < i
+ * @param params generator parameters
+ * @param parents array of params->nodeCnt indices to fill
+ * @return gTree status code (BadData for parameters that describe no tree)
+ */
+static gTree_status gTree_genParents(const gTree_GenParams *params, size_t *parents)
+{
+    if (!gPtrValid(params))
+        return gTree_status_BadData;
+    if (!gPtrValid(parents))
+        return gTree_status_BadOutPtr;
+    size_t n = params->nodeCnt;
+    if (n == 0)
+        return gTree_status_OK;
+
+    uint64_t state = params->seed;
+    parents[0] = -1;
+    switch (params->shape) {
+    case gTree_gen_Chain:
+        for (size_t i = 1; i < n; ++i)
+            parents[i] = i - 1;
+        break;
+    case gTree_gen_Star:
+        for (size_t i = 1; i < n; ++i)
+            parents[i] = 0;
+        break;
+    case gTree_gen_Kary:
+        if (params->arity == 0)
+            return gTree_status_BadData;
+        for (size_t i = 1; i < n; ++i)
+            parents[i] = (i - 1) / params->arity;
+        break;
+    case gTree_gen_Recursive:
+        for (size_t i = 1; i < n; ++i)
+            parents[i] = gTree_genUniform(&state, i);
+        break;
+    case gTree_gen_Preferential: {
+        size_t *ends = (size_t*)malloc((2 * n) * sizeof(size_t));    /// Node i is listed (fan-out + 1) times
+        if (ends == NULL)
+            return gTree_status_AllocErr;
+        size_t endCnt = 0;
+        ends[endCnt++] = 0;
+        for (size_t i = 1; i < n; ++i) {
+            parents[i] = ends[gTree_genUniform(&state, endCnt)];
+            ends[endCnt++] = parents[i];
+            ends[endCnt++] = i;
+        }
+        free(ends);
+        break;
+    }
+    case gTree_gen_GaltonWatson: {
+        size_t *offspring = (size_t*)malloc(2 * n * sizeof(size_t));
+        if (offspring == NULL)
+            return gTree_status_AllocErr;
+        gTree_status status = gTree_genGaltonWatson(n, params->arity, &state, offspring);
+        if (status != gTree_status_OK) {
+            free(offspring);
+            return status;
+        }
+        size_t *stack = offspring + n;      /// Preorder nodes with children left to attach
+        size_t stackCnt = 0;
+        if (offspring[0] > 0)
+            stack[stackCnt++] = 0;
+        for (size_t i = 1; i < n; ++i) {
+            size_t parent = stack[stackCnt - 1];
+            parents[i] = parent;
+            if (--offspring[parent] == 0)
+                --stackCnt;
+            if (offspring[i] > 0)
+                stack[stackCnt++] = i;
+        }
+        free(offspring);
+        break;
+    }
+    case gTree_gen_Replay:
+        if (!gPtrValid(params->parents))
+            return gTree_status_BadData;
+        for (size_t i = 1; i < n; ++i) {
+            if (params->parents[i] >= i)
+                return gTree_status_BadData;
+            parents[i] = params->parents[i];
+        }
+        break;
+    default:
+        return gTree_status_BadData;
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief builds the shape under a node in bulk: the pool is reserved once and exactly nodeCnt - 1 nodes are added
+ * @param tree pointer to structure
+ * @param rootId id of the node that becomes node 0 of the shape
+ * @param params generator parameters
+ * @param ids_out array of params->nodeCnt to write ids of the shape nodes to (nullable)
+ * @return gTree status code
+ */
+static gTree_status gTree_generate(gTree *tree, size_t rootId, const gTree_GenParams *params, size_t *ids_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(gPtrValid(params), gTree_status_BadData, tree->logStream);
+    GTREE_ID_VAL(rootId);
+    size_t n = params->nodeCnt;
+    if (n == 0)
+        return gTree_status_OK;
+
+    size_t *parents = (size_t*)malloc(n * sizeof(size_t));
+    size_t *ids = ids_out != NULL ? ids_out : (size_t*)malloc(n * sizeof(size_t));
+    if (parents == NULL || ids == NULL) {
+        free(parents);
+        if (ids != ids_out)
+            free(ids);
+        GTREE_ASSERT_LOG(false, gTree_status_AllocErr, tree->logStream);
+        return gTree_status_AllocErr;
+    }
+
+    gTree_status status = gTree_genParents(params, parents);
+    if (status == gTree_status_OK)
+        status = gTree_reserve(tree, n - 1);
+    ids[0] = rootId;
+    for (size_t i = 1; i < n && status == gTree_status_OK; ++i) {
+        GTREE_TYPE data = {};
+        if (params->dataFunc != NULL)
+            data = params->dataFunc(i, params->dataArg);
+        status = gTree_addChild(tree, ids[parents[i]], &ids[i], data);
+    }
+
+    free(parents);
+    if (ids != ids_out)
+        free(ids);
+    GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+    return status;
+}
+
+
+/**
+ * @brief records parent array of a subtree in preorder, so the shape could be replayed with gTree_gen_Replay
+ * @param tree pointer to structure
+ * @param rootId id of the subtree root
+ * @param parents_out ptr to write malloc'ed parent array to (free() it)
+ * @param cnt_out ptr to write number of recorded nodes to
+ * @return gTree status code
+ */
+static gTree_status gTree_recordParents(const gTree *tree, size_t rootId, size_t **parents_out, size_t *cnt_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(gPtrValid(parents_out) && gPtrValid(cnt_out), gTree_status_BadOutPtr, tree->logStream);
+    GTREE_ID_VAL(rootId);
+
+    size_t cnt = 0, cap = 0, pathCnt = 0, pathCap = 0;
+    size_t *parents = NULL;
+    size_t *path = NULL;                    /// Pairs (id, index) of the nodes on the path from the subtree root
+    for (size_t id = rootId; id != (size_t)-1; id = gTree_nextPreorder(tree, rootId, id)) {
+        if (!gTree_growArray((void**)&parents, &cap, cnt + 1, sizeof(size_t)) ||
+            !gTree_growArray((void**)&path, &pathCap, 2 * (pathCnt + 1), sizeof(size_t))) {
+            free(parents);
+            free(path);
+            GTREE_ASSERT_LOG(false, gTree_status_AllocErr, tree->logStream);
+            return gTree_status_AllocErr;
+        }
+        size_t parentId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->parent;
+        while (pathCnt > 0 && path[2 * (pathCnt - 1)] != parentId)
+            --pathCnt;
+        parents[cnt] = pathCnt > 0 ? path[2 * pathCnt - 1] : -1;
+        path[2 * pathCnt] = id;
+        path[2 * pathCnt + 1] = cnt++;
+        ++pathCnt;
+    }
+    free(path);
+    *parents_out = parents;
+    *cnt_out = cnt;
+    return gTree_status_OK;
+}
@@ -6,6 +6,18 @@
 
 #include "stdio.h"
 #include "stdlib.h"
+#include "stdint.h"
+#include "inttypes.h"
+#include "string.h"
+#include "pthread.h"
+#include "sched.h"
+#include "time.h"
+#if defined(GTREE_LATENCY_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+#include "x86intrin.h"
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+#include "immintrin.h"
+#endif
 
 #include "gutils.h"             /// Some handy utils
 
@@ -26,6 +38,11 @@ struct gTree_Node
     size_t child;                   /// Id of the first child
     size_t parent;                  /// Id of the previos node in tree
     size_t sibling;                 /// Id of the right sibling node
+    size_t tail;                    /// Id of the last child (-1 if there are no children), appends walk the siblings if hand-linked nodes left it stale
+    #ifdef GTREE_VERSIONED
+    size_t gen;                     /// Tree version the node was last written in (-1 for nodes kept only for snapshots)
+    size_t ver;                     /// Id of the newest copied out older state (-1 if none)
+    #endif
 } typedef gTree_Node;
 
 
@@ -45,6 +62,316 @@ bool  gTree_restoreData(GTREE_TYPE *data, FILE *in);
 bool  gTree_printData  (GTREE_TYPE  data, FILE *out);
 
 
+#ifdef GTREE_VERSIONED
+/**
+ * @brief read-only version handle returned by gTree_snapshot
+ */
+struct gTree_Snapshot
+{
+    size_t version;             /// Version of the tree the handle sees
+    size_t root;                /// Id of the root node in that version
+} typedef gTree_Snapshot;
+
+
+/**
+ * @brief copied out node state, listed by the newest active snapshot that still sees it
+ */
+struct gTree_VerRec
+{
+    gTree_Node node;            /// The state (`gen` is its version, `ver` links the older record of the owner)
+    size_t owner;               /// Id of the pool node the state belongs to (-1 for free records)
+    size_t newer;               /// Newer record of the owner (-1 if the owner links this one)
+    size_t next;                /// Next record of the snapshot list or of the free list
+} typedef gTree_VerRec;
+
+
+/**
+ * @brief active snapshot with the list of records it is the newest reader of
+ */
+struct gTree_SnapEntry
+{
+    size_t version;
+    size_t recs;                /// Head of the record list (-1 if empty)
+} typedef gTree_SnapEntry;
+#endif
+
+
+/**
+ * @brief types of transaction undo log records
+ */
+enum gTree_UndoType
+{
+    gTree_undo_Node,            /// Node links and data before the first write
+    gTree_undo_Alloc,           /// Node allocated inside the transaction
+    gTree_undo_Free,            /// Node freed inside the transaction (freeing is deferred until commit)
+} typedef gTree_UndoType;
+
+
+/**
+ * @brief transaction undo log record
+ */
+struct gTree_UndoRec
+{
+    gTree_UndoType type;
+    size_t id;
+    gTree_Node image;           /// Previous node state for gTree_undo_Node
+} typedef gTree_UndoRec;
+
+
+#ifndef GTREE_MAX_READERS
+#define GTREE_MAX_READERS 64            /// Max number of threads inside epoch reader sections at once
+#endif
+
+#ifndef GTREE_RECLAIM_BATCH
+#define GTREE_RECLAIM_BATCH 1024        /// Number of retired nodes that triggers reclamation attempt
+#endif
+
+
+/**
+ * @brief epoch announced by a reader (-1 if the slot is free), padded to its own cache line
+ */
+struct gTree_EpochSlot
+{
+    size_t epoch;
+    char pad[64 - sizeof(size_t)];
+} typedef gTree_EpochSlot;
+
+
+#ifndef GTREE_MAGAZINE_SIZE
+#define GTREE_MAGAZINE_SIZE 64          /// Number of free slots a thread could cache, half of it is moved to/from the pool at once
+#endif
+
+#ifndef GTREE_MAX_MAGAZINES
+#define GTREE_MAX_MAGAZINES 64          /// Number of per-thread caches of the concurrent mode
+#endif
+
+
+/**
+ * @brief per-thread cache of free pool slots used in the concurrent mode, the cached slots are marked free in the pool
+ *        (so ids of freed nodes do not pass the id checks) while they are still off its free list
+ */
+struct gTree_Magazine
+{
+    size_t owner;               /// Tag of the owning thread (0 if the magazine is free)
+    struct gTree *tree;         /// Tree to return the slots to when the owning thread exits
+    size_t cnt;
+    size_t ids[GTREE_MAGAZINE_SIZE];
+} typedef gTree_Magazine;
+
+
+/**
+ * @brief node unlinked in epoch mode, its slot is freed when no reader could still reach it
+ */
+struct gTree_Retired
+{
+    size_t id;
+    size_t epoch;               /// Global epoch at the moment of unlinking
+} typedef gTree_Retired;
+
+
+/**
+ * @brief user-provided hook returning heap bytes owned by all payloads (kept by the user, must be O(1))
+ */
+typedef size_t (*gTree_PayloadHeapFunc)(void *arg);
+
+
+/**
+ * @brief phases of the garbage collection cycle
+ */
+enum gTree_GcPhase
+{
+    gTree_gc_Idle,
+    gTree_gc_Mark,              /// Marking nodes reachable from the roots, written nodes are scanned again
+    gTree_gc_Sweep,             /// Freeing unmarked slots, slots taken from the pool are marked
+} typedef gTree_GcPhase;
+
+
+/**
+ * @brief hot-path event counters, collected only if GTREE_COUNTERS is defined
+ */
+struct gTree_Counters
+{
+    size_t poolGets;            /// Checked node lookups in the pool
+    size_t poolAllocs;          /// Slots taken from the pool or the thread cache
+    size_t poolFrees;           /// Slots given back to the pool or the thread cache
+    size_t siblingHops;         /// Sibling links followed by addSibling, addExistChild, delChild, delSubtree and replaceNode
+    size_t maxDepth;            /// Peak recursion depth of storeSubTree and restoreSubTree
+    size_t storeBytes;          /// Bytes written by the outermost storeSubTree calls
+    size_t restoreBytes;        /// Bytes read by the outermost restoreSubTree calls
+} typedef gTree_Counters;
+
+
+/**
+ * @brief public calls timed by the latency histograms (only the outermost one is recorded when they nest)
+ */
+enum gTree_LatOp
+{
+    gTree_lat_AddChild,
+    gTree_lat_AddSibling,
+    gTree_lat_AddExistChild,
+    gTree_lat_DelChild,
+    gTree_lat_DelSubtree,
+    gTree_lat_KillSubtree,
+    gTree_lat_ReplaceNode,
+    gTree_lat_CloneSubtree,
+    gTree_lat_Store,
+    gTree_lat_Restore,
+    gTree_lat_GetNode,
+    gTree_lat_GetData,
+    gTree_lat_SetData,
+    gTree_lat_Traverse,
+    gTree_lat_EpochTraverse,
+    gTree_lat_Snapshot,
+    gTree_lat_SnapshotNode,
+    gTree_lat_SnapshotRelease,
+    gTree_lat_HashSubtree,
+    gTree_lat_Diff,
+    gTree_lat_ApplyPatch,
+    gTree_lat_CanonicalHash,
+    gTree_lat_CanonicalForm,
+    gTree_lat_Isomorphic,
+    gTree_lat_SortChildren,
+    gTree_lat_SortSubtree,
+    gTree_lat_BeginTxn,
+    gTree_lat_Commit,
+    gTree_lat_Rollback,
+    gTree_lat_Reserve,
+    gTree_lat_UnlinkNode,
+    gTree_lat_ApplyBatch,
+    gTree_lat_ParallelForEach,
+    gTree_lat_ParallelReduce,
+    gTree_lat_DelSubtreeDeferred,
+    gTree_lat_CollectDeferred,
+    gTree_lat_BuildIntervals,
+    gTree_lat_FindAll,
+    gTree_lat_Verify,
+    gTree_lat_CollectGarbage,
+    gTree_lat_Stats,
+    gTree_lat_MemoryUsage,
+    gTree_lat_DumpGraphViz,
+    gTree_lat_Cnt,
+} typedef gTree_LatOp;
+
+static const char gTree_latOpMsg[gTree_lat_Cnt][MAX_MSG_LEN] = {
+        "addChild",
+        "addSibling",
+        "addExistChild",
+        "delChild",
+        "delSubtree",
+        "killSubtree",
+        "replaceNode",
+        "cloneSubtree",
+        "store",
+        "restore",
+        "getNode",
+        "getData",
+        "setData",
+        "traverse",
+        "epochTraverse",
+        "snapshot",
+        "snapshotNode",
+        "snapshotRelease",
+        "hashSubtree",
+        "diff",
+        "applyPatch",
+        "canonicalHash",
+        "canonicalForm",
+        "isomorphic",
+        "sortChildren",
+        "sortSubtree",
+        "beginTxn",
+        "commit",
+        "rollback",
+        "reserve",
+        "unlinkNode",
+        "applyBatch",
+        "parallelForEach",
+        "parallelReduce",
+        "delSubtreeDeferred",
+        "collectDeferred",
+        "buildIntervals",
+        "findAll",
+        "verify",
+        "collectGarbage",
+        "stats",
+        "memoryUsage",
+        "dumpPoolGraphViz",
+    };
+
+
+#ifndef GTREE_LAT_SUB_BITS
+#define GTREE_LAT_SUB_BITS 4            /// Each power of two range is split into 2^GTREE_LAT_SUB_BITS linear buckets
+#endif
+
+#define GTREE_LAT_SUB     (1 << GTREE_LAT_SUB_BITS)
+#define GTREE_LAT_BUCKETS (GTREE_LAT_SUB + (64 - GTREE_LAT_SUB_BITS) * GTREE_LAT_SUB)
+
+#ifndef GTREE_MAX_LAT_THREADS
+#define GTREE_MAX_LAT_THREADS 64        /// Number of per-thread histograms, other threads share one more
+#endif
+
+
+/**
+ * @brief log-linear latency histograms of one thread (written by it only, merged by readers)
+ */
+struct gTree_LatencyHist
+{
+    size_t owner;                                       /// Tag of the owning thread (0 for the shared one)
+    uint64_t cnt[gTree_lat_Cnt][GTREE_LAT_BUCKETS];
+    uint64_t sum[gTree_lat_Cnt];
+    uint64_t max[gTree_lat_Cnt];
+} typedef gTree_LatencyHist;
+
+
+/**
+ * @brief tree mutations reported to observers
+ */
+enum gTree_EventType
+{
+    gTree_ev_Insert,            /// New node linked to `parent` (for subtree copies the root only)
+    gTree_ev_Delete,            /// Single node deleted from `parent`, its payload is in `data`
+    gTree_ev_Move,              /// Existing node linked to `parent` (-1 if it was detached)
+    gTree_ev_Update,            /// Payload of the node was written
+    gTree_ev_Kill,              /// Subtree deleted from `parent` (the root only)
+    gTree_ev_Cnt,
+} typedef gTree_EventType;
+
+
+/**
+ * @brief single mutation reported to observers
+ */
+struct gTree_Event
+{
+    gTree_EventType type;
+    size_t id;
+    size_t parent;
+    GTREE_TYPE data;
+} typedef gTree_Event;
+
+
+/**
+ * @brief observer of tree mutations, called once per public call with all of its events
+ *        (from the mutating thread, so it must be thread-safe in the concurrent mode)
+ */
+typedef void (*gTree_ObserverFunc)(const struct gTree *tree, const gTree_Event *events, size_t cnt, void *arg);
+
+
+#ifndef GTREE_MAX_OBSERVERS
+#define GTREE_MAX_OBSERVERS 8           /// Max number of registered observers
+#endif
+
+#ifndef GTREE_OBSERVE_BATCH
+#define GTREE_OBSERVE_BATCH 64          /// Events buffered per thread in place, longer calls spill to the heap (still one batch)
+#endif
+
+
+struct gTree_Observer
+{
+    gTree_ObserverFunc func;
+    void *arg;
+} typedef gTree_Observer;
+
+
 /**
  * @brief main linked list structure
  */
@@ -53,6 +380,73 @@ struct gTree
     size_t root;                /// id of the root node
     gObjPool pool;              /// Object Pool for memory management
     FILE *logStream;            /// Log stream for centralized logging
+    bool concurrent;            /// If read APIs and batches synchronize on the lock
+    pthread_rwlock_t lock;      /// Reader-writer lock of the concurrent mode
+    pthread_mutex_t allocLock;  /// Guards the pool while children are appended under the read lock
+    gTree_Magazine *mags;       /// Per-thread caches of free slots (GTREE_MAX_MAGAZINES of them in the concurrent mode)
+    pthread_key_t magKey;       /// Flushes the magazine of an exiting thread
+    bool magKeyOn;
+    bool txnActive;             /// If writes are being recorded to the undo log
+    gTree_UndoRec *undo;        /// Undo log of the current transaction
+    size_t undoCnt;
+    size_t undoCap;
+    uint64_t *undoBits;         /// Nodes already in the undo log (image saved or allocated in the transaction)
+    size_t undoBitsCap;
+    size_t nodeCnt;             /// Number of pool slots held by the tree
+    size_t deadCnt;             /// Held slots of deleted nodes that id checks reject (see gTree_markDead)
+    bool epochMode;             /// If freed nodes wait in limbo until readers that could reach them leave
+    bool growing;               /// Set while the pool is reallocated, holds new epoch readers off
+    size_t epoch;               /// Global reclamation epoch
+    gTree_EpochSlot *readers;   /// Announced epochs of the readers (GTREE_MAX_READERS slots)
+    gTree_Retired *limbo;       /// Retired nodes in ascending epoch order
+    size_t limboHead;
+    size_t limboCnt;
+    size_t limboCap;
+    size_t *grave;              /// Roots of detached subtrees waiting to be freed
+    size_t graveCnt;
+    size_t graveCap;
+    bool reaperOn;              /// If the background thread frees the detached subtrees
+    size_t reaperBatch;         /// Max number of nodes the background thread frees per write lock
+    pthread_t reaper;
+    pthread_mutex_t graveLock;
+    pthread_cond_t graveCond;   /// Signaled when subtrees are detached or the reaper is stopped
+    gTree_GcPhase gcPhase;
+    uint64_t *gcBits;           /// Mark bitmap of the current collection cycle (slots past gcCap are treated as marked)
+    size_t gcCap;
+    size_t *gcStack;            /// Marked nodes waiting to be scanned
+    size_t gcStackCnt;
+    size_t gcStackCap;
+    size_t gcCursor;            /// Next slot to sweep
+    size_t *gcRoots;            /// Extra roots registered with gTree_addGcRoot
+    size_t gcRootCnt;
+    size_t gcRootCap;
+    gTree_PayloadHeapFunc payloadHeap;  /// Hook reporting heap memory owned by payloads (could be NULL)
+    void *payloadHeapArg;
+    #ifdef GTREE_COUNTERS
+    gTree_Counters counters;
+    #endif
+    #ifdef GTREE_LATENCY
+    gTree_LatencyHist *latency[GTREE_MAX_LAT_THREADS + 1];     /// Lazily allocated per-thread histograms
+    #endif
+    #ifdef GTREE_OBSERVERS
+    gTree_Observer observers[GTREE_MAX_OBSERVERS];
+    size_t observerCnt;
+    gTree_Event *txnEvents;     /// Events of the transaction in progress, reported on commit and dropped on rollback
+    size_t txnEventCnt;
+    size_t txnEventCap;
+    #endif
+    #ifdef GTREE_VERSIONED
+    size_t version;             /// Current write version, bumped by every snapshot
+    gTree_SnapEntry *snaps;     /// Active snapshots by ascending version
+    size_t snapCnt;
+    size_t snapCap;
+    gTree_VerRec *vers;         /// Copied out node states
+    size_t verCnt;
+    size_t verCap;
+    size_t verFree;             /// Head of the free list of version records
+    uint64_t *deadBits;         /// Bit per slot of a deleted node that is still held (see gTree_markDead)
+    size_t deadBitsCap;
+    #endif
 } typedef gTree;
 
 
@@ -75,6 +469,11 @@ enum gTree_status
     gTree_status_BadData,
     gTree_status_BadRestoration,
     gTree_status_FileErr,
+    gTree_status_BadSnapshot,
+    gTree_status_BadPatch,
+    gTree_status_BadTxn,
+    gTree_status_BadMode,
+    gTree_status_BadStructure,
     gTree_status_Cnt,
 };
 
@@ -95,6 +494,11 @@ static const char gTree_statusMsg[gTree_status_Cnt][MAX_MSG_LEN] = {
     "Error during data restoration",
     "Error during tree restoration",
     "Error in file IO",
+    "Bad snapshot handle provided",
+    "Bad patch provided",
+    "Bad transaction state",
+    "Operation is not available in the current mode",
+    "Tree structure is corrupted",
 };
 
 
@@ -122,13 +526,64 @@ static const char gTree_statusMsg[gTree_status_Cnt][MAX_MSG_LEN] = {
 #endif
 
 
+/**
+ * @brief Macros to count hot-path events, compiled out unless GTREE_COUNTERS is defined
+ */
+#ifdef GTREE_COUNTERS
+#define GTREE_COUNT(field, n) __atomic_fetch_add(&((gTree*)tree)->counters.field, (n), __ATOMIC_RELAXED)
+#define GTREE_COUNT_DEPTH() \
+    __attribute__((cleanup(gTree_depthLeave))) size_t macroDepth = gTree_depthEnter(tree)
+#else
+#define GTREE_COUNT(field, n) ((void)0)
+#define GTREE_COUNT_DEPTH()
+#endif
+
+
+/**
+ * @brief Macro to time the rest of the scope as an operation, compiled out unless GTREE_LATENCY is defined
+ */
+#ifdef GTREE_LATENCY
+#define GTREE_LATENCY_SCOPE(op) \
+    __attribute__((cleanup(gTree_latencyStop))) gTree_LatencyScope macroLatency = gTree_latencyStart(tree, op)
+#else
+#define GTREE_LATENCY_SCOPE(op)
+#endif
+
+
+/**
+ * @brief Macros to report mutations to observers, compiled out unless GTREE_OBSERVERS is defined:
+ *        the scope batches events until the outermost public call returns, quiet calls do not report,
+ *        events of a transaction are held until it ends (GTREE_TXN_EVENTS reports or drops them)
+ */
+#ifdef GTREE_OBSERVERS
+#define GTREE_OBSERVE_SCOPE() \
+    __attribute__((cleanup(gTree_observeLeave))) size_t macroObserve = gTree_observeEnter(tree)
+#define GTREE_EVENT(type, id, parent, data) gTree_observeEmit(tree, type, id, parent, data)
+#define GTREE_OBSERVED() (tree->observerCnt != 0 && gTree_eventBatch.quiet == 0)
+#define GTREE_TXN_EVENTS(report) gTree_observeTxnEnd(tree, report)
+#define GTREE_QUIET(expr) ({                                    \
+    ++gTree_eventBatch.quiet;                                    \
+    __typeof__(expr) macroQuiet = (expr);                         \
+    --gTree_eventBatch.quiet;                                      \
+    macroQuiet;                                                     \
+})
+#else
+#define GTREE_OBSERVE_SCOPE()
+#define GTREE_EVENT(type, id, parent, data) ((void)0)
+#define GTREE_OBSERVED() false
+#define GTREE_TXN_EVENTS(report) ((void)0)
+#define GTREE_QUIET(expr) (expr)
+#endif
+
+
 /**
  * @brief Macro for easier and more secure node access in gObjPool
  */
 #define GTREE_NODE_BY_ID(id) ({                                     \
     gTree_Node *node;                                                \
-    GTREE_CHECK_POOL_STATUS(gObjPool_get(&tree->pool, id, &node));    \
-    node;                                                              \
+    GTREE_COUNT(poolGets, 1);                                         \
+    GTREE_CHECK_POOL_STATUS(gObjPool_get(&tree->pool, id, &node));     \
+    node;                                                               \
 })
 
 
@@ -137,12 +592,8 @@ static const char gTree_statusMsg[gTree_status_Cnt][MAX_MSG_LEN] = {
  */
 #define GTREE_POOL_ALLOC() ({                                                                      \
     size_t macroId = -1;                                                                            \
-    GTREE_CHECK_POOL_STATUS(gObjPool_alloc(&tree->pool, &macroId));                                  \
-    gTree_Node *macroNode = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, macroId);                          \
-    macroNode->sibling = -1;                                                                           \
-    macroNode->parent  = -1;                                                                            \
-    macroNode->child   = -1;                                                                             \
-    macroId;                                                                                              \
+    GTREE_IS_OK(gTree_allocNode(tree, &macroId));                                                    \
+    macroId;                                                                                          \
 })
 
 
@@ -150,10 +601,38 @@ static const char gTree_statusMsg[gTree_status_Cnt][MAX_MSG_LEN] = {
  * @brief Macro for handy and secure deallocation
  */
 #define GTREE_POOL_FREE(id) ({                                                            \
-    GTREE_CHECK_POOL_STATUS(gObjPool_free(&tree->pool, id));                               \
+    GTREE_IS_OK(gTree_freeNode(tree, id));                                                 \
+})
+
+
+/**
+ * @brief Macro to mark node as written in the current version
+ */
+#ifdef GTREE_VERSIONED
+#define GTREE_VERSION_INIT(node) ({     \
+    (node)->gen = tree->version;         \
+    (node)->ver = -1;                     \
+})
+#else
+#define GTREE_VERSION_INIT(node)
+#endif
+
+
+/**
+ * @brief Macro to call before writing to an existing node
+ */
+#define GTREE_TOUCH(id) ({                      \
+    GTREE_IS_OK(gTree_touchNode(tree, id));      \
 })
 
 
+/**
+ * @brief Macro to write a link (or the allocated flag) that lock-free epoch readers could load,
+ *        the release store publishes the writes made before it, so a new node is initialized before it is linked
+ */
+#define GTREE_STORE_LINK(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+
+
 /**
  * @brief Macro to check if expression or status is OK
  */
@@ -167,596 +646,5961 @@ static const char gTree_statusMsg[gTree_status_Cnt][MAX_MSG_LEN] = {
 
 
 /**
- * @brief gTree constructor that initiates objPool and logStream and creates zero node
- * @param tree pointer to structure to construct on
- * @param newLogStream new log stream, could be `NULL`, then logs will be written to `stderr`
- * @return gTree status code
+ * @brief grows malloc'ed array so it could hold at least `need` elements
+ * @param arr pointer to the array pointer (could point to NULL)
+ * @param cap pointer to the current capacity
+ * @param need number of elements required
+ * @param elemSize size of a single element
+ * @return true on success, false on allocation failure
  */
-static gTree_status gTree_ctor(gTree *tree, FILE *newLogStream)
+static bool gTree_growArray(void **arr, size_t *cap, size_t need, size_t elemSize)
 {
-    if (!gPtrValid(tree)) {
-        FILE *out;
-        if (!gPtrValid(newLogStream))
-            out = stderr;
-        else
-            out = newLogStream;
-        fprintf(out, "ERROR: bad structure ptr provided to tree ctor!\n");
-        return gTree_status_BadStructPtr;
-    }
-
-    tree->logStream = stderr;
-    if (gPtrValid(newLogStream))
-        tree->logStream = newLogStream;
+    if (need <= *cap)
+        return true;
+    size_t newCap = (*cap < 8) ? 8 : *cap;
+    while (newCap < need)
+        newCap *= 2;
+    void *newArr = realloc(*arr, newCap * elemSize);
+    if (newArr == NULL)
+        return false;
+    *arr = newArr;
+    *cap = newCap;
+    return true;
+}
 
-    gObjPool_status status = gObjPool_ctor(&tree->pool, -1, newLogStream);
-    GTREE_CHECK_POOL_STATUS(status);
 
-    status = gObjPool_alloc(&tree->pool, &tree->root);
-    GTREE_CHECK_POOL_STATUS(status);
-    gTree_Node *node;
-    status = gObjPool_get(&tree->pool, tree->root, &node);
-    GTREE_CHECK_POOL_STATUS(status);
-    node->parent  = -1;
-    node->child   = -1;
-    node->sibling = -1;
-    return gTree_status_OK;
+static bool gTree_bitTest(const uint64_t *bits, size_t id)
+{
+    return (bits[id / 64] >> (id % 64)) & 1;
 }
 
 
 /**
- * @brief gTree destructor
- * @param tree pointer to structure to destruct
- * @return gTree status code
+ * @brief sets bit of the id
+ * @return false if it was already set
  */
-static gTree_status gTree_dtor(gTree *tree)
+static bool gTree_bitSet(uint64_t *bits, size_t id)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    bool was = gTree_bitTest(bits, id);
+    bits[id / 64] |= (uint64_t)1 << (id % 64);
+    return !was;
+}
 
-    gTree_Node *node = NULL;
-    gObjPool_status status = gObjPool_status_OK;
-    status = gObjPool_get(&tree->pool, tree->root, &node);
-    if (node != NULL) {
-        node->parent  = -1;
-        node->child   = -1;
-        node->sibling = -1;
-    }
-    status = gObjPool_dtor(&tree->pool);
-    return gTree_status_OK;
+
+#ifdef GTREE_COUNTERS
+static __thread size_t gTree_depth = 0;         /// Recursion depth of the counted functions in the current thread
+
+static size_t gTree_depthEnter(const gTree *tree)
+{
+    size_t depth = ++gTree_depth;
+    size_t *peak = (size_t*)&tree->counters.maxDepth;
+    size_t seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (seen < depth && !__atomic_compare_exchange_n(peak, &seen, depth, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    return depth;
+}
+
+static void gTree_depthLeave(size_t *)
+{
+    --gTree_depth;
 }
+#endif
 
 
 /**
- * @brief adds sibling after the last existing one
+ * @brief write barrier of the collector marking phase: node about to be written is scanned again if it was marked
  * @param tree pointer to structure
- * @param siblingId id of a node to add sibling to
- * @param id ptr to write new nodeId to
- * @param data data to write to new node
+ * @param id id of a node that is going to be written
  * @return gTree status code
  */
-static gTree_status gTree_addSibling(gTree *tree, size_t siblingId, size_t *id_out, GTREE_TYPE data)
+static gTree_status gTree_gcShade(gTree *tree, size_t id)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
-    GTREE_ID_VAL(siblingId);
-
-    gTree_Node *sibling = NULL, *child = NULL;
-    gObjPool_status status = gObjPool_status_OK;
-
-    size_t childId = -1;
-    childId = GTREE_POOL_ALLOC();
-
-    sibling = GTREE_NODE_BY_ID(siblingId);
-    child   = GTREE_NODE_BY_ID(childId);
-
-    while (sibling->sibling != -1) {
-        siblingId = sibling->sibling;
-        status = gObjPool_get(&tree->pool, siblingId, &sibling);
-        GTREE_CHECK_POOL_STATUS(status);
-    }
-    sibling->sibling = childId;
-    child->parent  = sibling->parent;
-    child->child   = -1;
-    child->sibling = -1;
-    child->data = data;
-    if (gPtrValid(id_out))
-        *id_out = childId;
-    else
-        fprintf(tree->logStream, "%s\n", gTree_statusMsg[gTree_status_BadOutPtr]);
-
+    if (id < tree->gcCap && !gTree_bitTest(tree->gcBits, id))
+        return gTree_status_OK;
+    GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->gcStack, &tree->gcStackCap, tree->gcStackCnt + 1, sizeof(size_t)),
+                                                                gTree_status_AllocErr, tree->logStream);
+    tree->gcStack[tree->gcStackCnt++] = id;
     return gTree_status_OK;
 }
 
 
 /**
- * @brief adds existing child to node after the last one
+ * @brief appends record to the undo log of the current transaction, a node image is saved only on the first write
+ *        (and never for nodes allocated in the transaction)
  * @param tree pointer to structure
- * @param nodeId id of a node to add child to
- * @param id id of a new child node
+ * @param type record type
+ * @param id id of a node the record is about
  * @return gTree status code
  */
-static gTree_status gTree_addExistChild(gTree *tree, size_t nodeId, size_t childId)
+static gTree_status gTree_logUndo(gTree *tree, gTree_UndoType type, size_t id)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
-    GTREE_ID_VAL(nodeId);
-    GTREE_ID_VAL(childId);
-
-    gTree_Node *node = NULL, *child = NULL, *sibling = NULL;
-    gObjPool_status status = gObjPool_status_OK;
-
-    status = gObjPool_get(&tree->pool, nodeId, &node);
-    GTREE_CHECK_POOL_STATUS(status);
-    size_t siblingId = node->child;
-
-    status = gObjPool_get(&tree->pool, childId, &child);
-    GTREE_CHECK_POOL_STATUS(status);
-
-    if (node->child == -1) {
-        node->child = childId;
-    } else {
-        status = gObjPool_get(&tree->pool, siblingId, &sibling);
-        GTREE_CHECK_POOL_STATUS(status);
-
-        while (sibling->sibling != -1) {
-            siblingId = sibling->sibling;
-            status = gObjPool_get(&tree->pool, siblingId, &sibling);
-            GTREE_CHECK_POOL_STATUS(status);
-        }
-        sibling->sibling = childId;
+    if (type != gTree_undo_Free) {
+        size_t oldCap = tree->undoBitsCap;
+        GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->undoBits, &tree->undoBitsCap, id / 64 + 1, sizeof(uint64_t)),
+                                                                gTree_status_AllocErr, tree->logStream);
+        memset(tree->undoBits + oldCap, 0, (tree->undoBitsCap - oldCap) * sizeof(uint64_t));
+        if (!gTree_bitSet(tree->undoBits, id))
+            return gTree_status_OK;
     }
-    child->parent  = nodeId;
-    child->sibling = -1;
-
+    GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->undo, &tree->undoCap, tree->undoCnt + 1, sizeof(gTree_UndoRec)),
+                                                                gTree_status_AllocErr, tree->logStream);
+    gTree_UndoRec *rec = &tree->undo[tree->undoCnt++];
+    rec->type = type;
+    rec->id   = id;
+    if (type == gTree_undo_Node)
+        rec->image = *GTREE_NODE_BY_ID(id);
     return gTree_status_OK;
 }
 
 
 /**
- * @brief replace node with parentless one (changes only nodes parent and siblings)
+ * @brief empties the undo log at the end of the transaction, O(records)
  * @param tree pointer to structure
- * @param currentId id of a node to replace
- * @param replaceId id of an parentless node to replace with
- * @return gTree status code
  */
-static gTree_status gTree_replaceNode(gTree *tree, size_t currentId, size_t replaceId)
+static void gTree_clearUndo(gTree *tree)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
-    GTREE_ID_VAL(currentId);
-    GTREE_ID_VAL(replaceId);
-
-    gTree_Node *current = GTREE_NODE_BY_ID(currentId);
-    gTree_Node *replace = GTREE_NODE_BY_ID(replaceId);
+    for (size_t i = 0; i < tree->undoCnt; ++i) {
+        size_t id = tree->undo[i].id;
+        if (tree->undo[i].type != gTree_undo_Free)
+            tree->undoBits[id / 64] &= ~((uint64_t)1 << (id % 64));
+    }
+    tree->undoCnt = 0;
+}
 
-    size_t currentParentId = current->parent;
 
-    if (currentParentId != -1) {
-        gTree_Node *currentParent = GTREE_NODE_BY_ID(currentParentId);
+/**
+ * @brief prepares existing node for in-place writing (copies out its state if some snapshot still sees it)
+ * @param tree pointer to structure
+ * @param id id of a node that is going to be written
+ * @return gTree status code
+ */
+static gTree_status gTree_touchNode(gTree *tree, size_t id)
+{
+    if (tree->gcPhase == gTree_gc_Mark) {
+        GTREE_IS_OK(gTree_gcShade(tree, id));
+    }
+    if (tree->txnActive) {
+        GTREE_IS_OK(gTree_logUndo(tree, gTree_undo_Node, id));
+    }
 
-        if (currentParent->child == currentId) {
-            currentParent->child = replaceId;
+    #ifdef GTREE_VERSIONED
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);     // checked by the caller (grave roots are dead)
+    gTree_SnapEntry *top = (tree->snapCnt != 0) ? &tree->snaps[tree->snapCnt - 1] : NULL;
+    if (top != NULL && node->gen <= top->version) {
+        size_t recId = tree->verFree;
+        if (recId != -1) {
+            tree->verFree = tree->vers[recId].next;
         } else {
-            size_t childId = currentParent->child;
-            gTree_Node *child = NULL;
-            while ((child = GTREE_NODE_BY_ID(childId))->sibling != currentId) {
-                childId = child->sibling;
-            }
-            child = GTREE_NODE_BY_ID(childId);
-            child->sibling = replaceId;
+            GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->vers, &tree->verCap, tree->verCnt + 1, sizeof(gTree_VerRec)),
+                                                                gTree_status_AllocErr, tree->logStream);
+            recId = tree->verCnt++;
         }
-
-        replace->parent  = currentParentId;
-        replace->sibling = current->sibling;
-        current->parent  = -1;
-        current->sibling = -1;
-    } else {
-        fprintf(tree->logStream, "WARNING: attempt to replace parentless node, nothing to do!\n");
+        gTree_VerRec *rec = &tree->vers[recId];
+        rec->node  = *node;
+        rec->owner = id;
+        rec->newer = -1;
+        rec->next  = top->recs;
+        top->recs  = recId;
+        if (node->ver != -1)
+            tree->vers[node->ver].newer = recId;
+        node->ver = recId;
     }
-
+    node->gen = tree->version;
+    #endif
     return gTree_status_OK;
 }
 
 
 /**
- * @brief adds child to node after the last existing one
+ * @brief waits until all epoch readers leave and holds new ones off till `growing` is cleared
  * @param tree pointer to structure
- * @param nodeId id of a node to add child to
- * @param id ptr to write new childId to
- * @param data data to write to new node
- * @return gTree status code
  */
-static gTree_status gTree_addChild(gTree *tree, size_t nodeId, size_t *id_out, GTREE_TYPE data)
+static void gTree_blockReaders(gTree *tree)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
-    GTREE_ID_VAL(nodeId);
-
-    gTree_Node *node = NULL, *child = NULL, *sibling = NULL;
-    size_t childId = -1;
-
+    __atomic_store_n(&tree->growing, true, __ATOMIC_SEQ_CST);
+    for (size_t i = 0; i < GTREE_MAX_READERS; ++i)
+        while (__atomic_load_n(&tree->readers[i].epoch, __ATOMIC_SEQ_CST) != -1)
+            sched_yield();
+}
 
-    childId = GTREE_POOL_ALLOC();
-    child   = GTREE_NODE_BY_ID(childId);
-    child->data = data;
 
-    gTree_status treeStatus = gTree_addExistChild(tree, nodeId, childId);
-    GTREE_ASSERT_LOG(treeStatus == gTree_status_OK, treeStatus, tree->logStream);
+/**
+ * @brief recounts pool slots in use, nodes allocated by hand through gObjPool_alloc included, in O(capacity):
+ *        allocations that must not grow the pool (epoch readers, shared appends) predict growth from nodeCnt
+ * @param tree pointer to structure
+ */
+static void gTree_syncNodeCnt(gTree *tree)
+{
+    size_t cnt = 0;
+    for (size_t i = 0; i < tree->pool.capacity; ++i)
+        cnt += GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, i)->allocated;
+    if (tree->mags != NULL)                     // cached slots are marked free but are off the free list
+        for (size_t i = 0; i < GTREE_MAX_MAGAZINES; ++i)
+            cnt += tree->mags[i].cnt;
+    tree->nodeCnt = cnt + tree->deadCnt;        // so are the dead ones
+}
 
-    if (gPtrValid(id_out))
-        *id_out = childId;
-    else
-        fprintf(tree->logStream, "%s\n", gTree_statusMsg[gTree_status_BadOutPtr]);
 
-    return gTree_status_OK;
-}
+static __thread char gTree_threadTag;      /// Its address tells threads apart
 
 
 /**
- * @brief deletes child of a node with the position pos
+ * @brief finds (or claims) cache of the calling thread
  * @param tree pointer to structure
- * @param parentId id of a node to delete child in
- * @param pos position of a child (starting with 0)
- * @param data data ptr to write to write poped data (could be NULL, then data discarded)
- * @return gTree status code
+ * @return magazine or NULL if there is no free one or the tree is not concurrent
  */
-static gTree_status gTree_delChild(gTree *tree, size_t parentId, size_t pos, GTREE_TYPE *data)
+static gTree_Magazine *gTree_magazine(gTree *tree)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
-    GTREE_ID_VAL(parentId);
-
-    size_t siblingId = GTREE_NODE_BY_ID(parentId)->child;
-    gTree_Node *node    = NULL;
-    gTree_Node *sibling = NULL;
-    size_t childId = -1;
-    size_t nodeId  = -1;
-    if (pos == 0) {
-        nodeId = siblingId;
-        node = GTREE_NODE_BY_ID(nodeId);
-        sibling = GTREE_NODE_BY_ID(siblingId);
-        childId = sibling->child;
-        GTREE_NODE_BY_ID(parentId)->child = childId;
-    } else {
-        for (size_t i = 0; i + 1 < pos; ++i) {
-            siblingId = GTREE_NODE_BY_ID(siblingId)->sibling;
+    if (tree->mags == NULL || !tree->concurrent)
+        return NULL;
+    size_t tag = (size_t)&gTree_threadTag;
+    size_t idx = (size_t)(((uint64_t)tag * 0x9E3779B97F4A7C15ull) >> 32);
+    for (size_t probe = 0; probe < 4; ++probe) {
+        gTree_Magazine *mag = &tree->mags[(idx + probe) % GTREE_MAX_MAGAZINES];
+        size_t owner = __atomic_load_n(&mag->owner, __ATOMIC_RELAXED);
+        if (owner == tag)
+            return mag;
+        if (owner == 0 && __atomic_compare_exchange_n(&mag->owner, &owner, tag, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            mag->tree = tree;
+            pthread_setspecific(tree->magKey, mag);
+            return mag;
         }
-        sibling = GTREE_NODE_BY_ID(siblingId);
-        nodeId = sibling->sibling;
-        node = GTREE_NODE_BY_ID(nodeId);
-        childId = node->child;
-        sibling->sibling = childId;
     }
+    return NULL;
+}
 
-    assert(gPtrValid(node));
 
-    if (childId != -1) {
-        size_t subSiblingId = childId;
-        gTree_Node *subSibling = NULL;
-        while (subSiblingId != -1) {
-            subSibling = GTREE_NODE_BY_ID(subSiblingId);
-            subSiblingId = subSibling->sibling;
-            subSibling->parent = parentId;
-        }
+/**
+ * @brief latency bucket of a value: exact below GTREE_LAT_SUB, then GTREE_LAT_SUB linear steps per power of two
+ */
+static inline size_t gTree_latencyBucket(uint64_t value)
+{
+    if (value < GTREE_LAT_SUB)
+        return value;
+    size_t exp = 63 - __builtin_clzll(value);
+    return GTREE_LAT_SUB + (exp - GTREE_LAT_SUB_BITS) * GTREE_LAT_SUB +
+           ((value >> (exp - GTREE_LAT_SUB_BITS)) & (GTREE_LAT_SUB - 1));
+}
 
-        subSibling->sibling = node->sibling;
-    } else {
-        sibling->sibling = node->sibling;
-        node->sibling = -1;
-    }
 
-    if (gPtrValid(data))
-        *data = node->data;
+/**
+ * @brief the smallest value of a latency bucket
+ */
+static inline uint64_t gTree_latencyBucketLow(size_t bucket)
+{
+    if (bucket < GTREE_LAT_SUB)
+        return bucket;
+    size_t exp = (bucket - GTREE_LAT_SUB) / GTREE_LAT_SUB + GTREE_LAT_SUB_BITS;
+    return (uint64_t)(GTREE_LAT_SUB + (bucket - GTREE_LAT_SUB) % GTREE_LAT_SUB) << (exp - GTREE_LAT_SUB_BITS);
+}
 
-    GTREE_POOL_FREE(nodeId);
-    return gTree_status_OK;
+
+/**
+ * @brief latency clock: TSC ticks if GTREE_LATENCY_RDTSC is defined on x86, monotonic nanoseconds otherwise
+ */
+static inline uint64_t gTree_latencyNow()
+{
+    #if defined(GTREE_LATENCY_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+    return __rdtsc();
+    #else
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    #endif
 }
 
 
+#ifdef GTREE_OBSERVERS
 /**
- * @brief dealloces subtree by a node (parent and sibling of root are not changed)
- * @param tree pointer to structure
- * @param rootId id of a subtree root to kill
- * @return gTree status code
+ * @brief events of the outermost public call in progress on the current thread
  */
-static gTree_status gTree_killSubtree(gTree *tree, size_t rootId)
+struct gTree_EventBatch
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
-    GTREE_ID_VAL(rootId);
+    const gTree *tree;          /// Tree of the outermost call
+    size_t depth;               /// Number of observed calls the thread is inside
+    size_t quiet;               /// Number of quiet calls the thread is inside
+    size_t cnt;
+    gTree_Event *spill;         /// Events of a call that emitted more than GTREE_OBSERVE_BATCH, freed once they are reported
+    size_t spillCap;
+    gTree_Event events[GTREE_OBSERVE_BATCH];
+} typedef gTree_EventBatch;
 
-    size_t childId = GTREE_NODE_BY_ID(rootId)->child;
-    while (childId != -1) {
-        size_t siblingId = GTREE_NODE_BY_ID(childId)->sibling;
-        gTree_killSubtree(tree, childId);
-        childId = siblingId;
+static __thread gTree_EventBatch gTree_eventBatch;
+
+
+static void gTree_observeDispatch(const gTree *tree, const gTree_Event *events, size_t cnt)
+{
+    ++gTree_eventBatch.quiet;                   // mutations made by observers are not reported
+    for (size_t i = 0; i < tree->observerCnt; ++i)
+        tree->observers[i].func(tree, events, cnt, tree->observers[i].arg);
+    --gTree_eventBatch.quiet;
+}
+
+
+static void gTree_observeFlush()
+{
+    gTree_EventBatch *batch = &gTree_eventBatch;
+    size_t cnt = batch->cnt;
+    gTree_Event *spill = batch->spill;
+    batch->cnt      = 0;
+    batch->spill    = NULL;
+    batch->spillCap = 0;
+    if (cnt != 0)
+        gTree_observeDispatch(batch->tree, (spill != NULL) ? spill : batch->events, cnt);
+    free(spill);
+}
+
+
+static void gTree_observeEmit(gTree *tree, gTree_EventType type, size_t id, size_t parent, const GTREE_TYPE *data)
+{
+    gTree_EventBatch *batch = &gTree_eventBatch;
+    if (tree->observerCnt == 0 || batch->quiet != 0)
+        return;
+
+    gTree_Event event = {type, id, parent, {}};
+    if (data != NULL)
+        event.data = *data;
+    if (tree->txnActive &&
+        gTree_growArray((void**)&tree->txnEvents, &tree->txnEventCap, tree->txnEventCnt + 1, sizeof(gTree_Event))) {
+        tree->txnEvents[tree->txnEventCnt++] = event;
+        return;
+    }
+    if (batch->depth == 0 || batch->tree != tree) {
+        gTree_observeDispatch(tree, &event, 1);
+        return;
+    }
+    if (batch->cnt < GTREE_OBSERVE_BATCH) {
+        batch->events[batch->cnt++] = event;
+        return;
     }
 
-    GTREE_POOL_FREE(rootId);
-    return gTree_status_OK;
+    bool spilled = batch->spill != NULL;
+    if (!gTree_growArray((void**)&batch->spill, &batch->spillCap, batch->cnt + 1, sizeof(gTree_Event))) {
+        gTree_observeFlush();                   // out of memory: report what is there rather than lose events
+        batch->events[batch->cnt++] = event;
+        return;
+    }
+    if (!spilled)
+        memcpy(batch->spill, batch->events, batch->cnt * sizeof(gTree_Event));
+    batch->spill[batch->cnt++] = event;
 }
 
 
 /**
- * @brief deletes subtree by a node (parent and sibling of root are modified accordingly)
- * @param tree pointer to structure
- * @param rootId id of a subtree root to delete
- * @return gTree status code
+ * @brief reports held events of the finished transaction (or drops them if it was rolled back)
  */
-static gTree_status gTree_delSubtree(gTree *tree, size_t rootId)
+static void gTree_observeTxnEnd(gTree *tree, bool report)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
-    GTREE_ID_VAL(rootId);
+    size_t cnt = tree->txnEventCnt;
+    tree->txnEventCnt = 0;
+    if (report && cnt != 0)
+        gTree_observeDispatch(tree, tree->txnEvents, cnt);
+}
 
-    size_t childId = GTREE_NODE_BY_ID(rootId)->child;
-    while (childId != -1) {
-        size_t siblingId = GTREE_NODE_BY_ID(childId)->sibling;
-        gTree_killSubtree(tree, childId);
-        childId = siblingId;
-    }
 
-    gTree_Node *node = GTREE_NODE_BY_ID(rootId);
-    node->child = -1;
-    if (node->parent != -1) {
-        size_t parentId = node->parent;
-        gTree_Node *parent = GTREE_NODE_BY_ID(parentId);
-        size_t siblingId = parent->child;
-        if (siblingId == rootId) {
-            parent->child = node->sibling;
-        } else {
-            while (GTREE_NODE_BY_ID(siblingId)->sibling != rootId) {
-                siblingId = GTREE_NODE_BY_ID(siblingId)->sibling;
-            }
-            GTREE_NODE_BY_ID(siblingId)->sibling = node->sibling;
-        }
-    }
+static size_t gTree_observeEnter(const gTree *tree)
+{
+    if (gTree_eventBatch.depth == 0)
+        gTree_eventBatch.tree = tree;
+    return ++gTree_eventBatch.depth;
+}
 
-    GTREE_POOL_FREE(rootId);
 
-    return gTree_status_OK;
+static void gTree_observeLeave(size_t *)
+{
+    if (--gTree_eventBatch.depth == 0)
+        gTree_observeFlush();
 }
+#endif
 
 
+#ifdef GTREE_LATENCY
 /**
- * @brief clones subtree by a node (creates parentless subtree same as the given)
- * @param tree pointer to structure
- * @param nodeId id of a subtree root to clone
- * @param[out] id_out id of the cloned root
- * @return gTree status code
+ * @brief timed operation in progress (start is 0 for nested operations, which are not recorded)
  */
-static gTree_status gTree_cloneSubtree(gTree *tree, const size_t nodeId, size_t *id_out) {
-    GTREE_ASSERT_LOG(gPtrValid(tree),   gTree_status_BadStructPtr,  stderr);
-    GTREE_ASSERT_LOG(gPtrValid(id_out), gTree_status_BadOutPtr, tree->logStream);
-    GTREE_ID_VAL(nodeId);
-    #ifdef EXTRA_VERBOSE
-        fprintf(stderr, "cloneSubtree: nodeId = %lu\n", nodeId);
-    #endif
+struct gTree_LatencyScope
+{
+    const gTree *tree;
+    gTree_LatOp op;
+    uint64_t start;
+} typedef gTree_LatencyScope;
 
-    gTree_status status = gTree_status_OK;
-    size_t newNodeId = GTREE_POOL_ALLOC();
-
-    gTree_Node *node    = GTREE_NODE_BY_ID(nodeId);
-    gTree_Node *newNode = GTREE_NODE_BY_ID(newNodeId);
-    newNode->data = node->data;
-    newNode->child   = -1;
-    newNode->sibling = -1;
-    newNode->parent  = -1;
-    size_t childId = node->child;
+static __thread size_t gTree_latencyDepth = 0;     /// Number of timed operations the current thread is inside
 
-    while (childId != -1) {
-        size_t newChildId = -1;
-        status = gTree_cloneSubtree(tree, childId, &newChildId);
-        GTREE_IS_OK(status);
-        status = gTree_addExistChild(tree, newNodeId, newChildId);
-        GTREE_IS_OK(status);
 
-        childId = GTREE_NODE_BY_ID(childId)->sibling;
+/**
+ * @brief finds (or claims and allocates) histograms of the calling thread without locking,
+ *        threads that do not get one of their own share the last one
+ */
+static gTree_LatencyHist *gTree_latencyHist(const gTree *tree)
+{
+    gTree_LatencyHist **slots = (gTree_LatencyHist**)tree->latency;
+    size_t tag = (size_t)&gTree_threadTag;
+    size_t idx = (size_t)(((uint64_t)tag * 0x9E3779B97F4A7C15ull) >> 32);
+    for (size_t probe = 0; probe <= 4; ++probe) {
+        gTree_LatencyHist **slot = (probe < 4) ? &slots[(idx + probe) % GTREE_MAX_LAT_THREADS] : &slots[GTREE_MAX_LAT_THREADS];
+        size_t owner = (probe < 4) ? tag : 0;
+        gTree_LatencyHist *hist = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (hist == NULL) {
+            gTree_LatencyHist *fresh = (gTree_LatencyHist*)calloc(1, sizeof(gTree_LatencyHist));
+            if (fresh == NULL)
+                return NULL;
+            fresh->owner = owner;
+            if (__atomic_compare_exchange_n(slot, &hist, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                return fresh;
+            free(fresh);
+        }
+        if (hist->owner == owner)
+            return hist;
     }
+    return NULL;
+}
 
-    *id_out = newNodeId;
-    return status;
+
+static gTree_LatencyScope gTree_latencyStart(const gTree *tree, gTree_LatOp op)
+{
+    gTree_LatencyScope scope = {tree, op, 0};
+    if (gTree_latencyDepth++ == 0)
+        scope.start = gTree_latencyNow();
+    return scope;
+}
+
+
+static void gTree_latencyStop(gTree_LatencyScope *scope)
+{
+    if (--gTree_latencyDepth != 0 || scope->start == 0)
+        return;
+    uint64_t elapsed = gTree_latencyNow() - scope->start;
+    gTree_LatencyHist *hist = gTree_latencyHist(scope->tree);
+    if (hist == NULL)
+        return;
+    __atomic_fetch_add(&hist->cnt[scope->op][gTree_latencyBucket(elapsed)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum[scope->op], elapsed, __ATOMIC_RELAXED);
+    uint64_t seen = __atomic_load_n(&hist->max[scope->op], __ATOMIC_RELAXED);
+    while (seen < elapsed && !__atomic_compare_exchange_n(&hist->max[scope->op], &seen, elapsed, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
 }
+#endif
 
 
 /**
- * @brief dumps objPool of the tree to fout stream in GraphViz format
+ * @brief takes free slot from the thread cache, refills the cache from the pool with a batch when it is empty
  * @param tree pointer to structure
- * @param fout stream to write dump to
- * @return gTree status code
+ * @param shared if called under the read lock (then the pool is never reallocated)
+ * @param[out] id_out ptr to write slot id to
+ * @return gTree status code (BadCapacity if shared allocation needs the pool to grow)
  */
-static gTree_status gTree_dumpPoolGraphViz(const gTree *tree, FILE *fout)
+static gTree_status gTree_poolAlloc(gTree *tree, bool shared, size_t *id_out)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
-    GTREE_ASSERT_LOG(gPtrValid(fout), gTree_status_BadDumpOutPtr, tree->logStream);
-
-    fprintf(fout, "digraph dilist {\n\tnode [shape=record]\n\tsubgraph cluster {\n");
+    gTree_Magazine *mag = gTree_magazine(tree);
+    if (mag != NULL && mag->cnt != 0) {
+        *id_out = mag->ids[--mag->cnt];
+        GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, *id_out)->allocated = true;
+        GTREE_COUNT(poolAllocs, 1);
+        return gTree_status_OK;
+    }
 
-    for (size_t i = 0; i < tree->pool.capacity; ++i) {
-        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, i);
-        #ifdef EXTRA_VERBOSE
-            fprintf(fout, "\t\tnode%lu [label=\"Node %lu | {child | %lu} | {sibling | %lu} | {data | ", i, i, node->child, node->sibling);
-        #else
-            fprintf(fout, "\t\tnode%lu [label=\"Node %lu | | {data | ", i, i);
-        #endif
-        if (GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, i)->allocated)
-            gTree_printData(node->data, fout);
-        fprintf(fout, "}\"]\n");
+    size_t want = (mag != NULL) ? GTREE_MAGAZINE_SIZE / 2 : 1;
+    size_t got  = 0;
+    size_t id   = -1;
+    size_t batch[GTREE_MAGAZINE_SIZE / 2 + 1];
+    gObjPool_status status = gObjPool_status_OK;
+    if (tree->concurrent)
+        pthread_mutex_lock(&tree->allocLock);
+    while (got < want) {
+        bool grow = tree->nodeCnt + 1 >= tree->pool.capacity;
+        if (grow && (shared || got != 0))
+            break;
+        if (grow && tree->epochMode)
+            gTree_blockReaders(tree);           // realloc must not happen under readers
+        status = gObjPool_alloc(&tree->pool, &id);
+        if (grow && tree->epochMode)
+            __atomic_store_n(&tree->growing, false, __ATOMIC_SEQ_CST);
+        if (status != gObjPool_status_OK)
+            break;
+        ++tree->nodeCnt;
+        batch[got++] = id;
     }
+    if (tree->concurrent)
+        pthread_mutex_unlock(&tree->allocLock);
+
+    if (got == 0)
+        return (status != gObjPool_status_OK) ? (gTree_status)status : gTree_status_BadCapacity;
+    if (tree->gcBits != NULL)                   // slots taken during a collection cycle are live
+        for (size_t i = 0; i < got; ++i)
+            if (batch[i] < tree->gcCap)
+                __atomic_fetch_or(&tree->gcBits[batch[i] / 64], (uint64_t)1 << (batch[i] % 64), __ATOMIC_RELAXED);
+    for (size_t i = got - 1; i > 0; --i) {     // cached slots are handed out in the pool order
+        GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, batch[i])->allocated = false;
+        mag->ids[mag->cnt++] = batch[i];
+    }
+    *id_out = batch[0];
+    GTREE_COUNT(poolAllocs, 1);
+    return gTree_status_OK;
+}
 
-    fprintf(fout, "\t}\n");
 
-    for (size_t i = 0; i < tree->pool.capacity; ++i) {
-        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, i);
-        if (GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, i)->allocated && (node->parent != -1)) {
-            fprintf(fout, "\tnode%lu -> node%lu\n", node->parent, i);
-            if (node->sibling != -1)
-                fprintf(fout, "\tnode%lu -> node%lu [style=dotted]\n", i, node->sibling);
-        }
+/**
+ * @brief returns cnt slots from the top of the magazine to the pool (called with allocLock held)
+ */
+static void gTree_drainMagazine(gTree *tree, gTree_Magazine *mag, size_t cnt)
+{
+    for (size_t i = 0; i < cnt; ++i) {
+        size_t id = mag->ids[--mag->cnt];
+        GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated = true;
+        gObjPool_free(&tree->pool, id);
     }
-
-    fprintf(fout, "}\n");
-    return gTree_status_OK;
+    tree->nodeCnt -= cnt;
 }
 
 
 /**
- * @brief stores subTree in a file in human-readable format
+ * @brief puts free slot to the thread cache, returns half of the cache to the pool when it is full
  * @param tree pointer to structure
- * @param nodeId id of a node to start storing from
- * @param level the number of tabulation to add before each output line
- * @param out filestream to write to
+ * @param id id of a slot to free
  * @return gTree status code
  */
-static gTree_status gTree_storeSubTree(const gTree *tree, size_t nodeId, size_t level, FILE *out)
+static gTree_status gTree_poolFree(gTree *tree, size_t id)
 {
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
-    GTREE_ASSERT_LOG(gPtrValid(out),  gTree_status_BadDumpOutPtr, tree->logStream);
-    GTREE_ID_VAL(nodeId);
-
-    gTree_Node *node = GTREE_NODE_BY_ID(nodeId);
-    gTree_status status = gTree_status_OK;
-
-    for (size_t i = 0; i < level; ++i)
-        fprintf(out, "\t");
-    fprintf(out, "{\n");
-    for (size_t i = 0; i < level + 1; ++i)
-        fprintf(out, "\t");
-    fprintf(out, "[\n");
-    gTree_storeData(node->data, level + 2, out);
-    for (size_t i = 0; i < level + 1; ++i)
-        fprintf(out, "\t");
-    fprintf(out, "]\n");
-
-    size_t childId = node->child;
-    while (childId != -1) {
-        status = gTree_storeSubTree(tree, childId, level + 1, out);
-        GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
-        childId = GTREE_NODE_BY_ID(childId)->sibling;
+    GTREE_ID_VAL(id);
+    GTREE_COUNT(poolFrees, 1);
+    gTree_Magazine *mag = gTree_magazine(tree);
+    if (mag == NULL) {
+        GTREE_CHECK_POOL_STATUS(gObjPool_free(&tree->pool, id));
+        --tree->nodeCnt;
+        return gTree_status_OK;
     }
 
-    for (size_t i = 0; i < level; ++i)
-        fprintf(out, "\t");
-    fprintf(out, "}\n");
-
+    if (mag->cnt == GTREE_MAGAZINE_SIZE) {
+        pthread_mutex_lock(&tree->allocLock);
+        gTree_drainMagazine(tree, mag, GTREE_MAGAZINE_SIZE / 2);
+        pthread_mutex_unlock(&tree->allocLock);
+    }
+    GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated = false;
+    mag->ids[mag->cnt++] = id;
     return gTree_status_OK;
 }
 
 
 /**
- * @brief checks if the haystack consists only needle and some spaces
- * @param haystack the null-terminating string to check
+ * @brief returns all cached slots to the pool and releases the magazines (called with the write lock held)
+ * @param tree pointer to structure
+ */
+static void gTree_flushMagazines(gTree *tree)
+{
+    if (tree->mags == NULL)
+        return;
+    pthread_mutex_lock(&tree->allocLock);
+    for (size_t i = 0; i < GTREE_MAX_MAGAZINES; ++i) {
+        gTree_drainMagazine(tree, &tree->mags[i], tree->mags[i].cnt);
+        __atomic_store_n(&tree->mags[i].owner, 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&tree->allocLock);
+}
+
+
+/**
+ * @brief destructor of the magazine key: the cache of an exiting thread goes back to the pool
+ */
+static void gTree_magazineExit(void *arg)
+{
+    gTree_Magazine *mag = (gTree_Magazine*)arg;
+    gTree *tree = mag->tree;
+    if (__atomic_load_n(&mag->owner, __ATOMIC_RELAXED) != (size_t)&gTree_threadTag)
+        return;                                 // flushed when the mode was switched off, maybe claimed again since
+    pthread_mutex_lock(&tree->allocLock);
+    gTree_drainMagazine(tree, mag, mag->cnt);
+    __atomic_store_n(&mag->owner, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&tree->allocLock);
+}
+
+
+/**
+ * @brief takes deleted node off id checks while its slot is still held, so it is rejected like a free slot;
+ *        gTree_markLive undoes it before the slot is released or the node is brought back
+ * @param tree pointer to structure
+ * @param id id of a node
+ */
+static void gTree_markDead(gTree *tree, size_t id)
+{
+    GTREE_STORE_LINK(GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated, false);
+    ++tree->deadCnt;
+    #ifdef GTREE_VERSIONED
+    /* snapshots could still see the node, gTree_snapshotNode tells held slots from free ones by this bit;
+     * if the bitmap can't grow, the node is only unreadable through snapshots */
+    size_t oldCap = tree->deadBitsCap;
+    if (gTree_growArray((void**)&tree->deadBits, &tree->deadBitsCap, id / 64 + 1, sizeof(uint64_t))) {
+        memset(tree->deadBits + oldCap, 0, (tree->deadBitsCap - oldCap) * sizeof(uint64_t));
+        gTree_bitSet(tree->deadBits, id);
+    }
+    #endif
+}
+
+static void gTree_markLive(gTree *tree, size_t id)
+{
+    GTREE_STORE_LINK(GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated, true);
+    --tree->deadCnt;
+    #ifdef GTREE_VERSIONED
+    if (id / 64 < tree->deadBitsCap)
+        tree->deadBits[id / 64] &= ~((uint64_t)1 << (id % 64));
+    #endif
+}
+
+
+/**
+ * @brief returns node to the pool (or keeps it for the snapshots that still see it)
+ * @param tree pointer to structure
+ * @param id id of a node to release
+ * @return gTree status code
+ */
+static gTree_status gTree_releaseNode(gTree *tree, size_t id)
+{
+    #ifdef GTREE_VERSIONED
+    if (tree->snapCnt != 0) {
+        GTREE_TOUCH(id);
+        gTree_Node *node = GTREE_NODE_BY_ID(id);
+        if (node->ver != -1) {
+            node->gen     = -1;
+            GTREE_STORE_LINK(node->child, -1);
+            GTREE_STORE_LINK(node->parent, -1);
+            GTREE_STORE_LINK(node->sibling, -1);
+            GTREE_STORE_LINK(node->tail, -1);
+            gTree_markDead(tree, id);           // held for the snapshots, gTree_verRelease frees it
+            return gTree_status_OK;
+        }
+    }
+    #endif
+    return gTree_poolFree(tree, id);
+}
+
+
+/**
+ * @brief frees retired nodes no epoch reader could still reach, never waits for the readers
+ * @param tree pointer to structure
+ * @return gTree status code
+ */
+static gTree_status gTree_reclaim(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(!tree->txnActive, gTree_status_BadTxn, tree->logStream);
+    if (tree->limboHead == tree->limboCnt)
+        return gTree_status_OK;
+
+    /* readers entering from now on could not reach anything retired before */
+    size_t minEpoch = __atomic_add_fetch(&tree->epoch, 1, __ATOMIC_SEQ_CST);
+    for (size_t i = 0; i < GTREE_MAX_READERS; ++i) {
+        size_t readerEpoch = __atomic_load_n(&tree->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (readerEpoch < minEpoch)
+            minEpoch = readerEpoch;
+    }
+
+    while (tree->limboHead < tree->limboCnt && tree->limbo[tree->limboHead].epoch < minEpoch) {
+        size_t id = tree->limbo[tree->limboHead++].id;
+        gTree_markLive(tree, id);
+        GTREE_IS_OK(gTree_releaseNode(tree, id));
+    }
+    if (tree->limboHead == tree->limboCnt)
+        tree->limboHead = tree->limboCnt = 0;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief puts unlinked node to limbo, it is freed by gTree_reclaim once older readers leave
+ * @param tree pointer to structure
+ * @param id id of a node to retire
+ * @return gTree status code
+ */
+static gTree_status gTree_retireNode(gTree *tree, size_t id)
+{
+    if (tree->limboCnt == tree->limboCap && tree->limboHead != 0) {
+        tree->limboCnt -= tree->limboHead;
+        memmove(tree->limbo, tree->limbo + tree->limboHead, tree->limboCnt * sizeof(gTree_Retired));
+        tree->limboHead = 0;
+    }
+    GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->limbo, &tree->limboCap, tree->limboCnt + 1, sizeof(gTree_Retired)),
+                                                                gTree_status_AllocErr, tree->logStream);
+    tree->limbo[tree->limboCnt].id    = id;
+    tree->limbo[tree->limboCnt].epoch = __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST);
+    ++tree->limboCnt;
+    gTree_markDead(tree, id);                   // readers could still be inside, but the id is not valid any more
+
+    if (tree->limboCnt - tree->limboHead >= GTREE_RECLAIM_BATCH)
+        GTREE_IS_OK(gTree_reclaim(tree));
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief frees node: defers it in transaction and in epoch mode, releases it right away otherwise
+ * @param tree pointer to structure
+ * @param id id of a node to free
+ * @return gTree status code
+ */
+static gTree_status gTree_freeNode(gTree *tree, size_t id)
+{
+    if (tree->txnActive) {
+        GTREE_IS_OK(gTree_logUndo(tree, gTree_undo_Free, id));
+        gTree_markDead(tree, id);               // the slot is held until the commit, the id is not
+        return gTree_status_OK;
+    }
+    if (tree->epochMode)
+        return gTree_retireNode(tree, id);
+    return gTree_releaseNode(tree, id);
+}
+
+
+/**
+ * @brief allocates parentless childless node
+ * @param tree pointer to structure
+ * @param[out] id_out ptr to write new node id to
+ * @return gTree status code
+ */
+static gTree_status gTree_allocNode(gTree *tree, size_t *id_out)
+{
+    size_t id = -1;
+    GTREE_IS_OK(gTree_poolAlloc(tree, false, &id));
+
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    GTREE_STORE_LINK(node->sibling, -1);
+    GTREE_STORE_LINK(node->parent, -1);
+    GTREE_STORE_LINK(node->child, -1);
+    GTREE_STORE_LINK(node->tail, -1);
+    GTREE_VERSION_INIT(node);
+
+    if (tree->txnActive) {
+        gTree_status status = gTree_logUndo(tree, gTree_undo_Alloc, id);
+        if (status != gTree_status_OK) {
+            gTree_poolFree(tree, id);
+            return status;
+        }
+    }
+
+    *id_out = id;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief gTree constructor that initiates objPool and logStream and creates zero node
+ * @param tree pointer to structure to construct on
+ * @param newLogStream new log stream, could be `NULL`, then logs will be written to `stderr`
+ * @return gTree status code
+ */
+static gTree_status gTree_ctor(gTree *tree, FILE *newLogStream)
+{
+    if (!gPtrValid(tree)) {
+        FILE *out;
+        if (!gPtrValid(newLogStream))
+            out = stderr;
+        else
+            out = newLogStream;
+        fprintf(out, "ERROR: bad structure ptr provided to tree ctor!\n");
+        return gTree_status_BadStructPtr;
+    }
+
+    tree->logStream = stderr;
+    if (gPtrValid(newLogStream))
+        tree->logStream = newLogStream;
+    tree->concurrent = false;
+    pthread_rwlockattr_t lockAttr;
+    pthread_rwlockattr_init(&lockAttr);
+    #ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(&lockAttr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);   // writers must not starve
+    #endif
+    int lockStatus = pthread_rwlock_init(&tree->lock, &lockAttr);
+    pthread_rwlockattr_destroy(&lockAttr);
+    GTREE_ASSERT_LOG(lockStatus == 0, gTree_status_AllocErr, tree->logStream);
+    lockStatus = pthread_mutex_init(&tree->allocLock, NULL);
+    GTREE_ASSERT_LOG(lockStatus == 0, gTree_status_AllocErr, tree->logStream);
+    lockStatus = pthread_mutex_init(&tree->graveLock, NULL);
+    GTREE_ASSERT_LOG(lockStatus == 0, gTree_status_AllocErr, tree->logStream);
+    lockStatus = pthread_cond_init(&tree->graveCond, NULL);
+    GTREE_ASSERT_LOG(lockStatus == 0, gTree_status_AllocErr, tree->logStream);
+    tree->txnActive = false;
+    tree->undo      = NULL;
+    tree->undoCnt   = 0;
+    tree->undoCap   = 0;
+    tree->undoBits    = NULL;
+    tree->undoBitsCap = 0;
+    tree->nodeCnt   = 1;
+    tree->deadCnt   = 0;
+    tree->mags      = NULL;
+    tree->magKeyOn  = false;
+    tree->epochMode = false;
+    tree->growing   = false;
+    tree->epoch     = 0;
+    tree->readers   = NULL;
+    tree->limbo     = NULL;
+    tree->limboHead = 0;
+    tree->limboCnt  = 0;
+    tree->limboCap  = 0;
+    tree->grave     = NULL;
+    tree->graveCnt  = 0;
+    tree->graveCap  = 0;
+    tree->reaperOn  = false;
+    tree->gcPhase    = gTree_gc_Idle;
+    tree->gcBits     = NULL;
+    tree->gcCap      = 0;
+    tree->gcStack    = NULL;
+    tree->gcStackCnt = 0;
+    tree->gcStackCap = 0;
+    tree->gcCursor   = 0;
+    tree->gcRoots    = NULL;
+    tree->gcRootCnt  = 0;
+    tree->gcRootCap  = 0;
+    tree->payloadHeap    = NULL;
+    tree->payloadHeapArg = NULL;
+    #ifdef GTREE_COUNTERS
+    memset(&tree->counters, 0, sizeof(gTree_Counters));
+    #endif
+    #ifdef GTREE_LATENCY
+    memset(tree->latency, 0, sizeof(tree->latency));
+    #endif
+    #ifdef GTREE_OBSERVERS
+    tree->observerCnt = 0;
+    tree->txnEvents   = NULL;
+    tree->txnEventCnt = 0;
+    tree->txnEventCap = 0;
+    #endif
+
+    gObjPool_status status = gObjPool_ctor(&tree->pool, -1, newLogStream);
+    GTREE_CHECK_POOL_STATUS(status);
+
+    status = gObjPool_alloc(&tree->pool, &tree->root);
+    GTREE_CHECK_POOL_STATUS(status);
+    gTree_Node *node;
+    status = gObjPool_get(&tree->pool, tree->root, &node);
+    GTREE_CHECK_POOL_STATUS(status);
+    node->parent  = -1;
+    node->child   = -1;
+    node->sibling = -1;
+    node->tail    = -1;
+
+    #ifdef GTREE_VERSIONED
+    tree->version  = 0;
+    tree->snaps    = NULL;
+    tree->snapCnt  = 0;
+    tree->snapCap  = 0;
+    tree->vers     = NULL;
+    tree->verCnt   = 0;
+    tree->verCap   = 0;
+    tree->verFree  = -1;
+    tree->deadBits = NULL;
+    tree->deadBitsCap = 0;
+    #endif
+    GTREE_VERSION_INIT(node);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief stops background freeing thread started by gTree_startReaper (not freed subtrees stay queued)
+ * @param tree pointer to structure
+ * @return gTree status code
+ */
+static gTree_status gTree_stopReaper(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    if (!tree->reaperOn)
+        return gTree_status_OK;
+
+    pthread_mutex_lock(&tree->graveLock);
+    tree->reaperOn = false;
+    pthread_cond_broadcast(&tree->graveCond);
+    pthread_mutex_unlock(&tree->graveLock);
+    pthread_join(tree->reaper, NULL);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief gTree destructor
+ * @param tree pointer to structure to destruct
+ * @return gTree status code
+ */
+static gTree_status gTree_dtor(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    gTree_stopReaper(tree);
+
+    gTree_Node *node = NULL;
+    gObjPool_status status = gObjPool_status_OK;
+    status = gObjPool_get(&tree->pool, tree->root, &node);
+    if (node != NULL) {
+        node->parent  = -1;
+        node->child   = -1;
+        node->sibling = -1;
+        node->tail    = -1;
+    }
+    status = gObjPool_dtor(&tree->pool);
+
+    pthread_rwlock_destroy(&tree->lock);
+    pthread_mutex_destroy(&tree->allocLock);
+    pthread_mutex_destroy(&tree->graveLock);
+    pthread_cond_destroy(&tree->graveCond);
+    free(tree->grave);
+    tree->grave    = NULL;
+    tree->graveCnt = 0;
+    free(tree->gcBits);
+    free(tree->gcStack);
+    free(tree->gcRoots);
+    tree->gcBits  = NULL;
+    tree->gcStack = NULL;
+    tree->gcRoots = NULL;
+    tree->gcPhase = gTree_gc_Idle;
+    if (tree->magKeyOn)
+        pthread_key_delete(tree->magKey);
+    tree->magKeyOn = false;
+    free(tree->mags);
+    tree->mags = NULL;
+    #ifdef GTREE_LATENCY
+    for (size_t i = 0; i <= GTREE_MAX_LAT_THREADS; ++i) {
+        free(tree->latency[i]);
+        tree->latency[i] = NULL;
+    }
+    #endif
+    free(tree->undo);
+    tree->undo      = NULL;
+    tree->undoCnt   = 0;
+    free(tree->undoBits);
+    tree->undoBits  = NULL;
+    tree->txnActive = false;
+    free(tree->readers);
+    free(tree->limbo);
+    tree->readers   = NULL;
+    tree->limbo     = NULL;
+    tree->limboHead = tree->limboCnt = 0;
+    tree->epochMode = false;
+
+    #ifdef GTREE_VERSIONED
+    free(tree->snaps);
+    free(tree->vers);
+    free(tree->deadBits);
+    tree->snaps  = NULL;
+    tree->vers   = NULL;
+    tree->deadBits = NULL;
+    tree->deadBitsCap = 0;
+    tree->snapCnt = tree->verCnt = 0;
+    #endif
+    #ifdef GTREE_OBSERVERS
+    free(tree->txnEvents);
+    tree->txnEvents = NULL;
+    tree->txnEventCnt = tree->txnEventCap = 0;
+    #endif
+    return gTree_status_OK;
+}
+
+
+#ifndef GTREE_MAX_HELD_LOCKS
+#define GTREE_MAX_HELD_LOCKS 8      /// Trees a thread can hold the lock of at once and still re-enter it
+#endif
+
+/**
+ * @brief lock of one tree as held by the current thread, the shared lock state is never read to tell it
+ */
+struct gTree_HeldLock
+{
+    const gTree *tree;
+    size_t readDepth;           /// Nested reader sections (only the outer one holds the rdlock)
+    bool writer;                /// If the thread holds the write lock
+} typedef gTree_HeldLock;
+
+static __thread gTree_HeldLock gTree_heldLocks[GTREE_MAX_HELD_LOCKS];
+
+
+/**
+ * @brief finds the record of the tree lock held by the current thread
+ * @param tree pointer to structure
+ * @param add whether to take a free record if there is none
+ * @return the record or NULL (a thread holding too many locks at once is not tracked and cannot re-enter them)
+ */
+static gTree_HeldLock *gTree_heldLock(const gTree *tree, bool add)
+{
+    gTree_HeldLock *empty = NULL;
+    for (size_t i = 0; i < GTREE_MAX_HELD_LOCKS; ++i) {
+        if (gTree_heldLocks[i].tree == tree)
+            return &gTree_heldLocks[i];
+        if (empty == NULL && gTree_heldLocks[i].tree == NULL)
+            empty = &gTree_heldLocks[i];
+    }
+    if (add && empty != NULL)
+        empty->tree = tree;
+    return add ? empty : NULL;
+}
+
+
+static void gTree_releaseHeld(gTree_HeldLock *held)
+{
+    if (held->readDepth == 0 && !held->writer)
+        held->tree = NULL;
+}
+
+
+/**
+ * @brief enters reader section (no-op out of concurrent mode); re-entrant, so a visitor may call back into the read APIs
+ *        and gTree_addChild (it fails rather than upgrade the lock), and a no-op inside the writer section of the same thread
+ * @param tree pointer to structure
+ */
+static void gTree_readLock(gTree *tree)
+{
+    gTree_HeldLock *held = gTree_heldLock(tree, false);
+    if (held != NULL) {
+        ++held->readDepth;
+        return;
+    }
+    if (!__atomic_load_n(&tree->concurrent, __ATOMIC_ACQUIRE))
+        return;
+    pthread_rwlock_rdlock(&tree->lock);
+    held = gTree_heldLock(tree, true);
+    if (held != NULL)
+        held->readDepth = 1;
+}
+
+
+/**
+ * @brief leaves reader section
+ * @param tree pointer to structure
+ */
+static void gTree_readUnlock(gTree *tree)
+{
+    gTree_HeldLock *held = gTree_heldLock(tree, false);
+    if (held == NULL) {                 // untracked: out of records or taken out of concurrent mode
+        if (__atomic_load_n(&tree->concurrent, __ATOMIC_ACQUIRE))
+            pthread_rwlock_unlock(&tree->lock);
+        return;
+    }
+    if (--held->readDepth == 0 && !held->writer)
+        pthread_rwlock_unlock(&tree->lock);
+    gTree_releaseHeld(held);
+}
+
+
+/**
+ * @brief enters writer section, all mutations inside it are seen by readers at once;
+ *        must not be called from a reader section of the same tree (the lock cannot be upgraded)
+ * @param tree pointer to structure
+ */
+static void gTree_writeLock(gTree *tree)
+{
+    if (!__atomic_load_n(&tree->concurrent, __ATOMIC_ACQUIRE))
+        return;
+    pthread_rwlock_wrlock(&tree->lock);
+    gTree_HeldLock *held = gTree_heldLock(tree, true);
+    if (held != NULL)
+        held->writer = true;
+}
+
+
+/**
+ * @brief leaves writer section
+ * @param tree pointer to structure
+ */
+static void gTree_writeUnlock(gTree *tree)
+{
+    gTree_HeldLock *held = gTree_heldLock(tree, false);
+    if (held == NULL) {
+        if (__atomic_load_n(&tree->concurrent, __ATOMIC_ACQUIRE))
+            pthread_rwlock_unlock(&tree->lock);
+        return;
+    }
+    held->writer = false;
+    pthread_rwlock_unlock(&tree->lock);
+    gTree_releaseHeld(held);
+}
+
+
+/**
+ * @brief checks if the calling thread holds the write lock
+ * @param tree pointer to structure
+ */
+static bool gTree_isWriter(const gTree *tree)
+{
+    const gTree_HeldLock *held = gTree_heldLock(tree, false);
+    return held != NULL && held->writer;
+}
+
+
+/**
+ * @brief enters writer section unless the calling thread is already in it
+ * @param tree pointer to structure
+ * @return true if the lock was taken and must be released with gTree_writeUnlock
+ */
+static bool gTree_writeEnter(gTree *tree)
+{
+    if (!tree->concurrent || gTree_isWriter(tree))
+        return false;
+    gTree_writeLock(tree);
+    return true;
+}
+
+
+/**
+ * @brief allocates node from the thread cache while other threads append under the read lock, never grows the pool
+ * @param tree pointer to structure
+ * @param[out] id_out ptr to write new node id to
+ * @return gTree status code (BadCapacity if the pool has to grow under the write lock)
+ */
+static gTree_status gTree_allocShared(gTree *tree, size_t *id_out)
+{
+    size_t id = -1;
+    gTree_status status = gTree_poolAlloc(tree, true, &id);
+    if (status != gTree_status_OK)
+        return status;
+
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    GTREE_STORE_LINK(node->sibling, -1);
+    GTREE_STORE_LINK(node->parent, -1);
+    GTREE_STORE_LINK(node->child, -1);
+    GTREE_STORE_LINK(node->tail, -1);
+    GTREE_VERSION_INIT(node);
+    *id_out = id;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief links node as the last child with CAS on the tail link (Michael-Scott queue append),
+ *        other appenders could run concurrently, the lagging tail is helped forward
+ * @param tree pointer to structure
+ * @param nodeId id of a node to add child to
+ * @param childId id of an initialized parentless node
+ */
+static void gTree_publishChild(gTree *tree, size_t nodeId, size_t childId)
+{
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+    for (;;) {
+        size_t tailId = __atomic_load_n(&node->tail, __ATOMIC_ACQUIRE);
+        size_t nextId = -1;
+        if (tailId == -1) {
+            if (__atomic_compare_exchange_n(&node->child, &nextId, childId, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+                __atomic_compare_exchange_n(&node->tail, &tailId, childId, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+                return;
+            }
+            /* other appender linked the first child but did not set the tail yet */
+            __atomic_compare_exchange_n(&node->tail, &tailId, nextId, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        gTree_Node *last = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tailId);
+        if (__atomic_compare_exchange_n(&last->sibling, &nextId, childId, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+            __atomic_compare_exchange_n(&node->tail, &tailId, childId, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+            return;
+        }
+        __atomic_compare_exchange_n(&node->tail, &tailId, nextId, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ * @brief appends child under the read lock of the concurrent mode, so appends do not wait for each other
+ * @param tree pointer to structure
+ * @param nodeId id of a node to add child to
+ * @param[out] id_out ptr to write new childId to
+ * @param data data to write to new node
+ * @return gTree status code, not OK if the append needs the write lock (BadId, BadMode in transaction,
+ *         with snapshots or a tail left by hand-linking outside the children, BadCapacity if the pool has to grow)
+ */
+static gTree_status gTree_addChildShared(gTree *tree, size_t nodeId, size_t *id_out, GTREE_TYPE data)
+{
+    if (!gObjPool_idValid(&tree->pool, nodeId))
+        return gTree_status_BadId;
+    if (tree->txnActive)
+        return gTree_status_BadMode;
+    #ifdef GTREE_VERSIONED
+    if (tree->snapCnt != 0)
+        return gTree_status_BadMode;
+    #endif
+    /* a lagging tail is helped forward along the siblings, but one naming a node of another parent would link there
+       (gTree_lastChild walks the siblings instead) */
+    size_t tailId = __atomic_load_n(&GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->tail, __ATOMIC_ACQUIRE);
+    if (tailId != -1 && (!gObjPool_idValid(&tree->pool, tailId) || GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tailId)->parent != nodeId))
+        return gTree_status_BadMode;
+
+    size_t childId = -1;
+    gTree_status status = gTree_allocShared(tree, &childId);
+    if (status != gTree_status_OK)
+        return status;
+    gTree_Node *child = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId);
+    child->data   = data;
+    child->parent = nodeId;
+    gTree_publishChild(tree, nodeId, childId);
+    GTREE_EVENT(gTree_ev_Insert, childId, nodeId, NULL);
+
+    if (gPtrValid(id_out))
+        *id_out = childId;
+    else
+        fprintf(tree->logStream, "%s\n", gTree_statusMsg[gTree_status_BadOutPtr]);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief id of the last child of a node with children: the tail link if it is consistent, otherwise found by
+ *        walking the siblings (nodes linked by hand through the pool may leave the tail uninitialized)
+ */
+static size_t gTree_lastChild(gTree *tree, size_t nodeId)
+{
+    const gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+    size_t lastId = node->tail;
+    if (lastId != -1 && gObjPool_idValid(&tree->pool, lastId)) {
+        const gTree_Node *last = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, lastId);
+        if (last->parent == nodeId && last->sibling == -1)
+            return lastId;
+    }
+    lastId = node->child;
+    while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, lastId)->sibling != -1) {
+        GTREE_COUNT(siblingHops, 1);
+        lastId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, lastId)->sibling;
+    }
+    return lastId;
+}
+
+
+/**
+ * @brief adds sibling after the last existing one
+ * @param tree pointer to structure
+ * @param siblingId id of a node to add sibling to
+ * @param id ptr to write new nodeId to
+ * @param data data to write to new node
+ * @return gTree status code
+ */
+static gTree_status gTree_addSibling(gTree *tree, size_t siblingId, size_t *id_out, GTREE_TYPE data)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_AddSibling);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ID_VAL(siblingId);
+
+    gTree_Node *sibling = NULL, *child = NULL;
+    gObjPool_status status = gObjPool_status_OK;
+
+    size_t childId = -1;
+    childId = GTREE_POOL_ALLOC();
+
+    sibling = GTREE_NODE_BY_ID(siblingId);
+    child   = GTREE_NODE_BY_ID(childId);
+
+    size_t parentId = sibling->parent;
+    if (parentId != -1) {
+        GTREE_TOUCH(parentId);
+        gTree_Node *parent = GTREE_NODE_BY_ID(parentId);
+        siblingId = gTree_lastChild(tree, parentId);
+        parent->tail = childId;
+        sibling = GTREE_NODE_BY_ID(siblingId);
+    }
+    while (sibling->sibling != -1) {
+        siblingId = sibling->sibling;
+        GTREE_COUNT(siblingHops, 1);
+        GTREE_COUNT(poolGets, 1);
+        status = gObjPool_get(&tree->pool, siblingId, &sibling);
+        GTREE_CHECK_POOL_STATUS(status);
+    }
+    child->data = data;
+    GTREE_STORE_LINK(child->parent, parentId);
+    GTREE_STORE_LINK(child->child, -1);
+    GTREE_STORE_LINK(child->sibling, -1);
+    GTREE_STORE_LINK(child->tail, -1);
+    GTREE_TOUCH(siblingId);
+    GTREE_STORE_LINK(sibling->sibling, childId);       // the child is published last
+    GTREE_EVENT(gTree_ev_Insert, childId, parentId, NULL);
+    if (gPtrValid(id_out))
+        *id_out = childId;
+    else
+        fprintf(tree->logStream, "%s\n", gTree_statusMsg[gTree_status_BadOutPtr]);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief links parentless node after the last child of a node, ids are not checked (callers validate them)
+ * @param tree pointer to structure
+ * @param nodeId id of a node to add child to
+ * @param childId id of a parentless node
+ * @return gTree status code
+ */
+static gTree_status gTree_linkLast(gTree *tree, size_t nodeId, size_t childId)
+{
+    gTree_Node *node  = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+    gTree_Node *child = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId);
+    size_t siblingId = (node->child != -1) ? gTree_lastChild(tree, nodeId) : -1;
+
+    GTREE_TOUCH(childId);
+    GTREE_STORE_LINK(child->parent, nodeId);
+    GTREE_STORE_LINK(child->sibling, -1);
+    GTREE_TOUCH(nodeId);
+    if (siblingId == -1) {                      // the child is published last, so readers never see its old links
+        GTREE_STORE_LINK(node->child, childId);
+    } else {
+        GTREE_COUNT(siblingHops, 1);
+        GTREE_TOUCH(siblingId);
+        GTREE_STORE_LINK(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, siblingId)->sibling, childId);
+    }
+    GTREE_STORE_LINK(node->tail, childId);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief unlinks node from its parent (the node keeps its subtree), ids are not checked (callers validate them)
+ * @param tree pointer to structure
+ * @param nodeId id of a node to unlink
+ * @return gTree status code
+ */
+static gTree_status gTree_unlinkFrom(gTree *tree, size_t nodeId)
+{
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+    size_t parentId = node->parent;
+    if (parentId == -1)
+        return gTree_status_OK;
+
+    gTree_Node *parent = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, parentId);
+    size_t prevId = -1;
+    for (size_t siblingId = parent->child; siblingId != nodeId; siblingId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, siblingId)->sibling) {
+        GTREE_ASSERT_LOG(siblingId != -1, gTree_status_BadId, tree->logStream);
+        GTREE_COUNT(siblingHops, 1);
+        prevId = siblingId;
+    }
+
+    if (prevId == -1) {
+        GTREE_TOUCH(parentId);
+        GTREE_STORE_LINK(parent->child, node->sibling);
+    } else {
+        GTREE_TOUCH(prevId);
+        GTREE_STORE_LINK(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, prevId)->sibling, node->sibling);
+    }
+    if (parent->tail == nodeId) {
+        GTREE_TOUCH(parentId);
+        GTREE_STORE_LINK(parent->tail, prevId);
+    }
+    GTREE_TOUCH(nodeId);
+    GTREE_STORE_LINK(node->parent, -1);
+    GTREE_STORE_LINK(node->sibling, -1);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief adds existing child to node after the last one
+ * @param tree pointer to structure
+ * @param nodeId id of a node to add child to
+ * @param id id of a new child node
+ * @return gTree status code
+ */
+static gTree_status gTree_addExistChild(gTree *tree, size_t nodeId, size_t childId)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_AddExistChild);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ID_VAL(nodeId);
+    GTREE_ID_VAL(childId);
+
+    GTREE_COUNT(poolGets, 2);
+    GTREE_IS_OK(gTree_linkLast(tree, nodeId, childId));
+    GTREE_EVENT(gTree_ev_Move, childId, nodeId, NULL);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief replace node with parentless one (changes only nodes parent and siblings)
+ * @param tree pointer to structure
+ * @param currentId id of a node to replace
+ * @param replaceId id of an parentless node to replace with
+ * @return gTree status code
+ */
+static gTree_status gTree_replaceNode(gTree *tree, size_t currentId, size_t replaceId)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_ReplaceNode);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ID_VAL(currentId);
+    GTREE_ID_VAL(replaceId);
+
+    gTree_Node *current = GTREE_NODE_BY_ID(currentId);
+    gTree_Node *replace = GTREE_NODE_BY_ID(replaceId);
+
+    size_t currentParentId = current->parent;
+
+    if (currentParentId != -1) {
+        gTree_Node *currentParent = GTREE_NODE_BY_ID(currentParentId);
+
+        if (currentParent->child == currentId) {
+            GTREE_TOUCH(currentParentId);
+            GTREE_STORE_LINK(currentParent->child, replaceId);
+        } else {
+            size_t childId = currentParent->child;
+            gTree_Node *child = NULL;
+            while ((child = GTREE_NODE_BY_ID(childId))->sibling != currentId) {
+                childId = child->sibling;
+                GTREE_COUNT(siblingHops, 1);
+            }
+            GTREE_TOUCH(childId);
+            child = GTREE_NODE_BY_ID(childId);
+            GTREE_STORE_LINK(child->sibling, replaceId);
+        }
+
+        if (currentParent->tail == currentId) {
+            GTREE_TOUCH(currentParentId);
+            GTREE_STORE_LINK(currentParent->tail, replaceId);
+        }
+
+        GTREE_TOUCH(replaceId);
+        GTREE_TOUCH(currentId);
+        GTREE_STORE_LINK(replace->parent, currentParentId);
+        GTREE_STORE_LINK(replace->sibling, current->sibling);
+        GTREE_STORE_LINK(current->parent, -1);
+        GTREE_STORE_LINK(current->sibling, -1);
+        GTREE_EVENT(gTree_ev_Move, replaceId, currentParentId, NULL);
+        GTREE_EVENT(gTree_ev_Move, currentId, -1, NULL);
+    } else {
+        fprintf(tree->logStream, "WARNING: attempt to replace parentless node, nothing to do!\n");
+    }
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief gTree_addChild body, called with the write lock held in the concurrent mode
+ */
+static gTree_status gTree_addChildLocked(gTree *tree, size_t nodeId, size_t *id_out, GTREE_TYPE data)
+{
+    GTREE_ID_VAL(nodeId);
+
+    gTree_Node *node = NULL, *child = NULL, *sibling = NULL;
+    size_t childId = -1;
+
+
+    childId = GTREE_POOL_ALLOC();
+    child   = GTREE_NODE_BY_ID(childId);
+    child->data = data;
+
+    gTree_status treeStatus = GTREE_QUIET(gTree_addExistChild(tree, nodeId, childId));
+    GTREE_ASSERT_LOG(treeStatus == gTree_status_OK, treeStatus, tree->logStream);
+    GTREE_EVENT(gTree_ev_Insert, childId, nodeId, NULL);
+
+    if (gPtrValid(id_out))
+        *id_out = childId;
+    else
+        fprintf(tree->logStream, "%s\n", gTree_statusMsg[gTree_status_BadOutPtr]);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief adds child to node after the last existing one in O(1);
+ *        in the concurrent mode appends from several threads run under the read lock and do not wait for each other;
+ *        called from a reader section (e.g. a visitor) it never takes the write lock, so the appends that need it
+ *        fail instead (BadMode in transaction or with snapshots, BadCapacity if the pool has to grow)
+ * @param tree pointer to structure
+ * @param nodeId id of a node to add child to
+ * @param id ptr to write new childId to
+ * @param data data to write to new node
+ * @return gTree status code
+ */
+static gTree_status gTree_addChild(gTree *tree, size_t nodeId, size_t *id_out, GTREE_TYPE data)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_AddChild);
+    GTREE_OBSERVE_SCOPE();
+
+    if (tree->concurrent && !gTree_isWriter(tree)) {
+        const gTree_HeldLock *held = gTree_heldLock(tree, false);
+        bool reader = held != NULL && held->readDepth != 0;
+        gTree_readLock(tree);
+        gTree_status status = gTree_addChildShared(tree, nodeId, id_out, data);
+        gTree_readUnlock(tree);
+        if (status == gTree_status_OK)
+            return gTree_status_OK;
+        if (reader) {                       // the read lock cannot be upgraded
+            GTREE_ASSERT_LOG(false, status, tree->logStream);
+            return status;
+        }
+    }
+
+    bool locked = gTree_writeEnter(tree);
+    gTree_status status = gTree_addChildLocked(tree, nodeId, id_out, data);
+    if (locked)
+        gTree_writeUnlock(tree);
+    return status;
+}
+
+
+/**
+ * @brief writes new data to the node
+ * @param tree pointer to structure
+ * @param nodeId id of a node to write to
+ * @param data data to write
+ * @return gTree status code
+ */
+static gTree_status gTree_setData(gTree *tree, size_t nodeId, GTREE_TYPE data)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_SetData);
+    GTREE_ID_VAL(nodeId);
+
+    GTREE_OBSERVE_SCOPE();
+    GTREE_TOUCH(nodeId);
+    GTREE_NODE_BY_ID(nodeId)->data = data;
+    GTREE_EVENT(gTree_ev_Update, nodeId, GTREE_NODE_BY_ID(nodeId)->parent, NULL);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief deletes child of a node that follows prevId (the first one if prevId is -1), its children are lifted in place;
+ *        ids are not checked (callers validate them)
+ * @param tree pointer to structure
+ * @param parentId id of a node to delete child in
+ * @param prevId id of the previous child or -1
+ * @param nodeId id of a child to delete
+ * @param data data ptr to write to write poped data (could be NULL, then data discarded)
+ * @return gTree status code
+ */
+static gTree_status gTree_liftChild(gTree *tree, size_t parentId, size_t prevId, size_t nodeId, GTREE_TYPE *data)
+{
+    gTree_Node *node = GTREE_NODE_BY_ID(nodeId);
+    size_t childId = node->child;
+
+    size_t nextId = node->sibling;
+    size_t lastId = prevId;
+    if (childId != -1) {
+        size_t subSiblingId = childId;
+        while (subSiblingId != -1) {
+            GTREE_TOUCH(subSiblingId);
+            gTree_Node *subSibling = GTREE_NODE_BY_ID(subSiblingId);
+            GTREE_STORE_LINK(subSibling->parent, parentId);
+            GTREE_EVENT(gTree_ev_Move, subSiblingId, parentId, NULL);
+            lastId = subSiblingId;
+            subSiblingId = subSibling->sibling;
+            GTREE_COUNT(siblingHops, 1);
+        }
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(lastId)->sibling, nextId);
+        nextId = childId;
+    }
+
+    if (prevId == -1) {
+        GTREE_TOUCH(parentId);
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(parentId)->child, nextId);
+    } else {
+        GTREE_TOUCH(prevId);
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(prevId)->sibling, nextId);
+    }
+    if (GTREE_NODE_BY_ID(parentId)->tail == nodeId) {
+        GTREE_TOUCH(parentId);
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(parentId)->tail, lastId);
+    }
+
+    assert(gPtrValid(node));
+
+    if (gPtrValid(data))
+        *data = node->data;
+
+    GTREE_EVENT(gTree_ev_Delete, nodeId, parentId, &node->data);
+    GTREE_POOL_FREE(nodeId);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief deletes child of a node with the position pos
+ * @param tree pointer to structure
+ * @param parentId id of a node to delete child in
+ * @param pos position of a child (starting with 0)
+ * @param data data ptr to write to write poped data (could be NULL, then data discarded)
+ * @return gTree status code
+ */
+static gTree_status gTree_delChild(gTree *tree, size_t parentId, size_t pos, GTREE_TYPE *data)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_DelChild);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ID_VAL(parentId);
+
+    size_t siblingId = GTREE_NODE_BY_ID(parentId)->child;
+    GTREE_ASSERT_LOG(siblingId != -1, gTree_status_BadPos, tree->logStream);
+    size_t nodeId  = -1;
+    size_t prevId  = -1;
+    if (pos == 0) {
+        nodeId = siblingId;
+    } else {
+        for (size_t i = 0; i + 1 < pos; ++i) {
+            siblingId = GTREE_NODE_BY_ID(siblingId)->sibling;
+            GTREE_ASSERT_LOG(siblingId != -1, gTree_status_BadPos, tree->logStream);
+        }
+        GTREE_COUNT(siblingHops, pos);
+        prevId = siblingId;
+        nodeId = GTREE_NODE_BY_ID(prevId)->sibling;
+        GTREE_ASSERT_LOG(nodeId != -1, gTree_status_BadPos, tree->logStream);
+    }
+    return gTree_liftChild(tree, parentId, prevId, nodeId, data);
+}
+
+
+/**
+ * @brief gets the first node of the subtree in postorder
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @return id of the first node
+ */
+static size_t gTree_firstPostorder(const gTree *tree, size_t rootId)
+{
+    size_t id = rootId;
+    while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->child != -1)
+        id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->child;
+    return id;
+}
+
+
+/**
+ * @brief gets the next node of the subtree in postorder (walks by parent links, no extra memory)
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param id id of the current node
+ * @return id of the next node or -1 if id is the subtree root
+ */
+static size_t gTree_nextPostorder(const gTree *tree, size_t rootId, size_t id)
+{
+    if (id == rootId)
+        return -1;
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    if (node->sibling != -1)
+        return gTree_firstPostorder(tree, node->sibling);
+    return node->parent;
+}
+
+
+/**
+ * @brief dealloces subtree by a node (parent and sibling of root are not changed)
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root to kill
+ * @return gTree status code
+ */
+static gTree_status gTree_killSubtree(gTree *tree, size_t rootId)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_KillSubtree);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ID_VAL(rootId);
+
+    GTREE_EVENT(gTree_ev_Kill, rootId, GTREE_NODE_BY_ID(rootId)->parent, NULL);
+    /* postorder by parent links, so deep subtrees do not overflow the stack; the next node is found before freeing */
+    size_t id = gTree_firstPostorder(tree, rootId);
+    while (id != -1) {
+        size_t nextId = gTree_nextPostorder(tree, rootId, id);
+        GTREE_POOL_FREE(id);
+        id = nextId;
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief deletes subtree by a node (parent and sibling of root are modified accordingly), the id is not checked
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root to delete
+ * @return gTree status code
+ */
+static gTree_status gTree_cutSubtree(gTree *tree, size_t rootId)
+{
+    GTREE_EVENT(gTree_ev_Kill, rootId, GTREE_NODE_BY_ID(rootId)->parent, NULL);
+    /* unlinked before anything is retired: a reclaim in the middle must not free nodes new epoch readers still reach */
+    gTree_Node *node = GTREE_NODE_BY_ID(rootId);
+    size_t nextId = node->sibling;
+    if (node->parent != -1) {
+        size_t parentId = node->parent;
+        gTree_Node *parent = GTREE_NODE_BY_ID(parentId);
+        size_t siblingId = parent->child;
+        GTREE_TOUCH(parentId);
+        if (siblingId == rootId) {
+            GTREE_STORE_LINK(parent->child, nextId);
+            siblingId = -1;
+        } else {
+            while (GTREE_NODE_BY_ID(siblingId)->sibling != rootId) {
+                siblingId = GTREE_NODE_BY_ID(siblingId)->sibling;
+                GTREE_COUNT(siblingHops, 1);
+            }
+            GTREE_TOUCH(siblingId);
+            GTREE_STORE_LINK(GTREE_NODE_BY_ID(siblingId)->sibling, nextId);
+        }
+        if (parent->tail == rootId)
+            GTREE_STORE_LINK(parent->tail, siblingId);
+    }
+
+    size_t childId = GTREE_NODE_BY_ID(rootId)->child;
+    while (childId != -1) {
+        size_t siblingId = GTREE_NODE_BY_ID(childId)->sibling;
+        GTREE_QUIET(gTree_killSubtree(tree, childId));
+        childId = siblingId;
+    }
+
+    GTREE_TOUCH(rootId);
+    node = GTREE_NODE_BY_ID(rootId);
+    GTREE_STORE_LINK(node->child, -1);
+    GTREE_STORE_LINK(node->tail, -1);
+    GTREE_POOL_FREE(rootId);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief deletes subtree by a node (parent and sibling of root are modified accordingly)
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root to delete
+ * @return gTree status code
+ */
+static gTree_status gTree_delSubtree(gTree *tree, size_t rootId)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_DelSubtree);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ID_VAL(rootId);
+
+    return gTree_cutSubtree(tree, rootId);
+}
+
+
+/**
+ * @brief dumps objPool of the tree to fout stream in GraphViz format
+ * @param tree pointer to structure
+ * @param fout stream to write dump to
+ * @return gTree status code
+ */
+static gTree_status gTree_dumpPoolGraphViz(const gTree *tree, FILE *fout)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_DumpGraphViz);
+    GTREE_ASSERT_LOG(gPtrValid(fout), gTree_status_BadDumpOutPtr, tree->logStream);
+
+    fprintf(fout, "digraph dilist {\n\tnode [shape=record]\n\tsubgraph cluster {\n");
+
+    for (size_t i = 0; i < tree->pool.capacity; ++i) {
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, i);
+        #ifdef EXTRA_VERBOSE
+            fprintf(fout, "\t\tnode%lu [label=\"Node %lu | {child | %lu} | {sibling | %lu} | {data | ", i, i, node->child, node->sibling);
+        #else
+            fprintf(fout, "\t\tnode%lu [label=\"Node %lu | | {data | ", i, i);
+        #endif
+        if (GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, i)->allocated)
+            gTree_printData(node->data, fout);
+        fprintf(fout, "}\"]\n");
+    }
+
+    fprintf(fout, "\t}\n");
+
+    for (size_t i = 0; i < tree->pool.capacity; ++i) {
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, i);
+        if (GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, i)->allocated && (node->parent != -1)) {
+            fprintf(fout, "\tnode%lu -> node%lu\n", node->parent, i);
+            if (node->sibling != -1)
+                fprintf(fout, "\tnode%lu -> node%lu [style=dotted]\n", i, node->sibling);
+        }
+    }
+
+    fprintf(fout, "}\n");
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief stores subTree in a file in human-readable format
+ * @param tree pointer to structure
+ * @param nodeId id of a node to start storing from
+ * @param level the number of tabulation to add before each output line
+ * @param out filestream to write to
+ * @return gTree status code
+ */
+static gTree_status gTree_storeSubTree(const gTree *tree, size_t nodeId, size_t level, FILE *out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Store);
+    GTREE_ASSERT_LOG(gPtrValid(out),  gTree_status_BadDumpOutPtr, tree->logStream);
+    GTREE_ID_VAL(nodeId);
+
+    gTree_Node *node = GTREE_NODE_BY_ID(nodeId);
+    gTree_status status = gTree_status_OK;
+    #ifdef GTREE_COUNTERS
+    GTREE_COUNT_DEPTH();
+    long startPos = (macroDepth == 1) ? ftell(out) : -1;
+    #endif
+
+    for (size_t i = 0; i < level; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "{\n");
+    for (size_t i = 0; i < level + 1; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "[\n");
+    gTree_storeData(node->data, level + 2, out);
+    for (size_t i = 0; i < level + 1; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "]\n");
+
+    size_t childId = node->child;
+    while (childId != -1) {
+        status = gTree_storeSubTree(tree, childId, level + 1, out);
+        GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+        childId = GTREE_NODE_BY_ID(childId)->sibling;
+    }
+
+    for (size_t i = 0; i < level; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "}\n");
+
+    #ifdef GTREE_COUNTERS
+    if (startPos != -1)
+        GTREE_COUNT(storeBytes, ftell(out) - startPos);
+    #endif
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief checks if the haystack consists only needle and some spaces
+ * @param haystack the null-terminating string to check
  * @param needle   the null-terminating string to search for in haystack
  * @return true if consists only needle and surrounding spaces, false otherwize
  */
-static bool consistsOnly(const char *const haystack, const char *const needle)
+static bool consistsOnly(const char *const haystack, const char *const needle)
+{
+    /* WARINING: needle and haystack must be null-terminating */
+    assert(gPtrValid(haystack));
+    assert(gPtrValid(needle));
+
+    char *haystackIter = (char*)haystack;
+    char *needleIter   = (char*)needle;
+    while (isspace(*(haystackIter)))
+        ++haystackIter;
+    while (*needleIter != '\0' && *haystackIter != '\0') {
+        if (*needleIter != *haystackIter)
+            return false;
+        ++needleIter;
+        ++haystackIter;
+    }
+    if (*needleIter != '\0')
+        return false;
+    if (*haystackIter == '\0')
+        return true;
+
+    while (isspace(*(haystackIter)))
+        ++haystackIter;
+    if (*haystackIter == '\0')
+        return true;
+    else
+        return false;
+}
+
+
+/**
+ * @brief restores subTree from a file in human-readable format
+ * @param tree pointer to structure
+ * @param nodeId id of a node to start restoring from
+ * @param in filestream to read from
+ * @return gTree status code
+ */
+static gTree_status gTree_restoreSubTree(gTree *tree, size_t nodeId, FILE *in)
+{
+    /*
+     * WARNING: Tree restoration (below) just somewhat supports
+     *          empty lines and doesn't support nor checks lines
+     *          that don't follow the format.
+     */
+
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Restore);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ASSERT_LOG(gPtrValid(in),   gTree_status_FileErr,       tree->logStream);
+    GTREE_ID_VAL(nodeId);
+
+    gTree_Node *node = GTREE_NODE_BY_ID(nodeId);
+    gTree_status status = gTree_status_OK;
+    #ifdef GTREE_COUNTERS
+    GTREE_COUNT_DEPTH();
+    long startPos = (macroDepth == 1) ? ftell(in) : -1;
+    #endif
+
+    char buffer[MAX_BUFFER_LEN] = "";
+    #ifdef EXTRA_VERBOSE
+        fprintf(stderr, "Restoring subTree from node %lu\n", nodeId);
+    #endif
+
+    size_t  curChildId = -1;
+    size_t prevChildId = -1;
+    GTREE_TYPE dummyData = {};
+    int bracketCnt = 1;
+    while ((bracketCnt > 0) && !feof(in)) {
+        GTREE_ASSERT_LOG(getline(buffer, MAX_BUFFER_LEN, in) == 0, gTree_status_FileErr, tree->logStream);
+        if (consistsOnly(buffer, "{")) {
+            ++bracketCnt;
+            prevChildId = curChildId;
+            status = gTree_addChild(tree, nodeId, &curChildId, dummyData);
+            GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+            gTree_Node *curChild = GTREE_NODE_BY_ID(curChildId);
+            curChild->parent = nodeId;
+            curChild->child  = -1;
+
+            status = gTree_restoreSubTree(tree, curChildId, in);
+            --bracketCnt;
+            GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+
+            GTREE_TOUCH(prevChildId != -1 ? prevChildId : nodeId);
+            if (prevChildId != -1)
+                GTREE_NODE_BY_ID(prevChildId)->sibling = curChildId;
+            else
+                GTREE_NODE_BY_ID(nodeId)->child = curChildId;
+        } else if (consistsOnly(buffer, "}")) {
+            --bracketCnt;
+        } else if (consistsOnly(buffer, "[")) {
+            GTREE_TOUCH(nodeId);
+            node = GTREE_NODE_BY_ID(nodeId);
+            GTREE_ASSERT_LOG(gTree_restoreData(&node->data, in) == 0, gTree_status_BadData, tree->logStream);
+        }
+    }
+
+    #ifdef EXTRA_VERBOSE
+        fprintf(stderr, "End of restoring subTree from node %lu\n", nodeId);
+    #endif
+
+    GTREE_ASSERT_LOG(bracketCnt == 0, gTree_status_BadRestoration, tree->logStream);
+    #ifdef GTREE_COUNTERS
+    if (startPos != -1)
+        GTREE_COUNT(restoreBytes, ftell(in) - startPos);
+    #endif
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief constructs tree and restores it from a file in human-readable format
+ * @param tree pointer to structure
+ * @param newLogStream logStream to forward to constructor
+ * @param in filestream to read from
+ * @return gTree status code
+ */
+static gTree_status gTree_restoreTree(gTree *tree, FILE *newLogStream, FILE *in)
+{
+    /* WARNING: tree structure must be uninitialized */
+
+    gTree_ctor(tree, newLogStream);
+    char buffer[MAX_BUFFER_LEN] = "";
+    GTREE_ASSERT_LOG(getline(buffer, MAX_BUFFER_LEN, in) == 0, gTree_status_FileErr, tree->logStream);
+    gTree_status status = gTree_status_OK;
+
+    if (consistsOnly(buffer, "{")) {
+        status = gTree_restoreSubTree(tree, tree->root, in);
+        GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+    }
+
+    return gTree_status_OK;
+}
+
+
+#ifdef GTREE_VERSIONED
+/**
+ * @brief gTree_snapshot body, called with the write lock held in the concurrent mode
+ */
+static gTree_status gTree_snapshotLocked(gTree *tree, gTree_Snapshot *snap_out)
+{
+    GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->snaps, &tree->snapCap, tree->snapCnt + 1, sizeof(gTree_SnapEntry)),
+                                                                gTree_status_AllocErr, tree->logStream);
+    tree->snaps[tree->snapCnt].version = tree->version;
+    tree->snaps[tree->snapCnt].recs    = -1;
+    ++tree->snapCnt;
+    snap_out->version = tree->version;
+    snap_out->root    = tree->root;
+    ++tree->version;
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief takes O(1) read-only snapshot of the tree, later writes copy out only the nodes they modify;
+ *        it is a point-in-time view: the writes made after it are not seen through it, but reads of it still wait for
+ *        writer sections (see gTree_snapshotNode). Enters the writer section in the concurrent mode, so it must not be
+ *        called from a reader section; out of it snapshots must not be taken concurrently with other calls
+ * @param tree pointer to structure
+ * @param[out] snap_out handle to write snapshot to
+ * @return gTree status code
+ */
+static gTree_status gTree_snapshot(gTree *tree, gTree_Snapshot *snap_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),     gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Snapshot);
+    GTREE_ASSERT_LOG(gPtrValid(snap_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    bool locked = gTree_writeEnter(tree);
+    gTree_status status = gTree_snapshotLocked(tree, snap_out);
+    if (locked)
+        gTree_writeUnlock(tree);
+    return status;
+}
+
+
+/**
+ * @brief copy of the node as it was at the moment of the snapshot; in the concurrent mode it takes the read lock,
+ *        so it runs alongside other readers but waits for a writer section in progress (the copied out states
+ *        and the pool could move under it), out of the concurrent mode it must not overlap writes to the tree
+ * @param tree pointer to structure
+ * @param snap snapshot handle
+ * @param nodeId id of a node to get
+ * @param[out] node_out ptr to copy node to
+ * @return gTree status code
+ */
+static gTree_status gTree_snapshotNode(gTree *tree, const gTree_Snapshot *snap, size_t nodeId, gTree_Node *node_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),     gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_SnapshotNode);
+    GTREE_ASSERT_LOG(gPtrValid(snap),     gTree_status_BadSnapshot,  tree->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(node_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    gTree_readLock(tree);
+    gTree_status status = gTree_status_OK;
+    if (snap->version >= tree->version)
+        status = gTree_status_BadSnapshot;
+    else if (nodeId >= tree->pool.capacity)
+        status = gTree_status_BadId;
+    else if (!GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, nodeId)->allocated &&     // deleted nodes are read through their versions
+             (nodeId / 64 >= tree->deadBitsCap || !gTree_bitTest(tree->deadBits, nodeId)))
+        status = gTree_status_BadId;
+
+    const gTree_Node *node = (status == gTree_status_OK) ? GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId) : NULL;
+    while (node != NULL && node->gen > snap->version) {
+        if (node->ver == -1) {
+            status = gTree_status_BadId;
+            break;
+        }
+        node = &tree->vers[node->ver].node;
+    }
+    if (status == gTree_status_OK)
+        *node_out = *node;
+    gTree_readUnlock(tree);
+
+    GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief unlinks version record from the chain of its owner and frees it (with the owner slot if only snapshots kept it)
+ */
+static gTree_status gTree_verRelease(gTree *tree, size_t recId)
+{
+    gTree_VerRec *rec = &tree->vers[recId];
+    size_t ownerId = rec->owner;
+    gTree_Node *owner = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ownerId);
+
+    if (rec->newer == -1)
+        owner->ver = rec->node.ver;
+    else
+        tree->vers[rec->newer].node.ver = rec->node.ver;
+    if (rec->node.ver != -1)
+        tree->vers[rec->node.ver].newer = rec->newer;
+    rec->owner = -1;
+    rec->next  = tree->verFree;
+    tree->verFree = recId;
+
+    if (owner->ver == -1 && owner->gen == -1) {
+        gTree_markLive(tree, ownerId);
+        return gTree_poolFree(tree, ownerId);
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief gTree_snapshotRelease body, called with the write lock held in the concurrent mode
+ */
+static gTree_status gTree_snapshotReleaseLocked(gTree *tree, const gTree_Snapshot *snap)
+{
+    size_t lo = 0, hi = tree->snapCnt;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (tree->snaps[mid].version < snap->version)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t pos = lo;
+    GTREE_ASSERT_LOG(pos < tree->snapCnt && tree->snaps[pos].version == snap->version, gTree_status_BadSnapshot, tree->logStream);
+
+    /* record is seen by the snapshots in [its gen, gen of the newer state), the released one was the newest of them */
+    gTree_SnapEntry *prev = (pos != 0) ? &tree->snaps[pos - 1] : NULL;
+    size_t recId = tree->snaps[pos].recs;
+    gTree_status status = gTree_status_OK;
+    while (recId != -1) {
+        gTree_VerRec *rec = &tree->vers[recId];
+        size_t next = rec->next;
+        if (prev != NULL && prev->version >= rec->node.gen) {
+            rec->next  = prev->recs;
+            prev->recs = recId;
+        } else {
+            gTree_status recStatus = gTree_verRelease(tree, recId);
+            if (status == gTree_status_OK)
+                status = recStatus;
+        }
+        recId = next;
+    }
+
+    memmove(&tree->snaps[pos], &tree->snaps[pos + 1], (tree->snapCnt - pos - 1) * sizeof(gTree_SnapEntry));
+    --tree->snapCnt;
+    GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief releases snapshot and reclaims node states and slots no other snapshot sees,
+ *        in O(records the snapshot was the newest reader of): each of them is handed to the previous snapshot or freed;
+ *        enters the writer section in the concurrent mode (not to be called from a reader section)
+ * @param tree pointer to structure
+ * @param snap snapshot handle to release
+ * @return gTree status code
+ */
+static gTree_status gTree_snapshotRelease(gTree *tree, const gTree_Snapshot *snap)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_SnapshotRelease);
+    GTREE_ASSERT_LOG(gPtrValid(snap), gTree_status_BadSnapshot,  tree->logStream);
+
+    bool locked = gTree_writeEnter(tree);
+    gTree_status status = gTree_snapshotReleaseLocked(tree, snap);
+    if (locked)
+        gTree_writeUnlock(tree);
+    return status;
+}
+#endif
+
+
+/**
+ * @brief user-provided payload hash, could be used instead of hashing the raw bytes of GTREE_TYPE
+ */
+typedef uint64_t (*gTree_HashFunc)(const GTREE_TYPE *data);
+
+
+/**
+ * @brief user-provided payload comparator (negative, zero or positive like for qsort)
+ */
+typedef int (*gTree_CmpFunc)(const GTREE_TYPE *first, const GTREE_TYPE *second);
+
+
+/**
+ * @brief edit operation types of gTree_Patch
+ */
+enum gTree_PatchOpType
+{
+    gTree_patch_Insert,         /// Insert new leaf with `data` as child number `pos` of the node at path
+    gTree_patch_Delete,         /// Delete subtree of the child number `pos` of the node at path
+    gTree_patch_Move,           /// Move child number `from` of the node at path to position `pos`
+    gTree_patch_Update,         /// Write `data` to the node at path
+} typedef gTree_PatchOpType;
+
+
+/**
+ * @brief single edit operation, nodes are addressed by path of child positions from the root
+ */
+struct gTree_PatchOp
+{
+    gTree_PatchOpType type;
+    size_t path;                /// Offset of the path in gTree_Patch::paths
+    size_t depth;               /// Length of the path (0 for the root)
+    size_t pos;
+    size_t from;
+    GTREE_TYPE data;
+} typedef gTree_PatchOp;
+
+
+/**
+ * @brief edit script that transforms one tree into another
+ */
+struct gTree_Patch
+{
+    gTree_PatchOp *ops;
+    size_t opCnt;
+    size_t opCap;
+    size_t *paths;              /// Storage for the paths of all operations
+    size_t pathCnt;
+    size_t pathCap;
+} typedef gTree_Patch;
+
+
+/**
+ * @brief gets the next node of the subtree in preorder (walks by parent links, no extra memory)
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param id id of the current node
+ * @return id of the next node or -1 if there is none
+ */
+static size_t gTree_nextPreorder(const gTree *tree, size_t rootId, size_t id)
+{
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    if (node->child != -1)
+        return node->child;
+    while (id != rootId) {
+        if (node->sibling != -1)
+            return node->sibling;
+        id   = node->parent;
+        node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    }
+    return -1;
+}
+
+
+/**
+ * @brief hashes node payload
+ */
+static uint64_t gTree_hashData(const GTREE_TYPE *data, gTree_HashFunc hasher)
+{
+    if (hasher != NULL)
+        return hasher(data);
+
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < sizeof(GTREE_TYPE); ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+/**
+ * @brief mixes two hashes together (order-dependent)
+ */
+static uint64_t gTree_hashMix(uint64_t hash, uint64_t value)
+{
+    hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 31;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 27;
+    return hash;
+}
+
+
+/**
+ * @brief modes of structural comparison
+ */
+enum gTree_canonMode
+{
+    gTree_canon_Ordered,        /// Order of children matters
+    gTree_canon_Unordered,      /// Children are compared as a multiset
+} typedef gTree_canonMode;
+
+
+/**
+ * @brief structural hashes of a subtree, all arrays are indexed by preorder rank inside the subtree
+ *        (children of the node with rank r are r + 1, then each next one is sizes[previous] further)
+ */
+struct gTree_SubtreeHashes
+{
+    size_t cnt;                 /// Number of nodes in the subtree
+    size_t *ids;                /// Node ids
+    size_t *sizes;              /// Subtree sizes
+    uint64_t *hashes;           /// Structural hashes
+} typedef gTree_SubtreeHashes;
+
+
+/**
+ * @brief gTree_SubtreeHashes destructor
+ * @param hashes pointer to structure to destruct
+ * @return gTree status code
+ */
+static gTree_status gTree_subtreeHashesDtor(gTree_SubtreeHashes *hashes)
+{
+    if (!gPtrValid(hashes))
+        return gTree_status_BadStructPtr;
+    free(hashes->ids);
+    hashes->cnt    = 0;
+    hashes->ids    = NULL;
+    hashes->sizes  = NULL;
+    hashes->hashes = NULL;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief computes structural hashes of all nodes of the subtree (AHU-style, bottom-up) in O(n) for both modes:
+ *        unordered children are combined as a multiset (sum of mixed hashes), so they need no sorting
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param mode whether order of children matters
+ * @param hasher payload hash (could be NULL, then raw bytes are hashed)
+ * @param[out] hashes_out ptr to structure to build (must be destructed with gTree_subtreeHashesDtor)
+ * @return gTree status code
+ */
+static gTree_status gTree_hashSubtree(const gTree *tree, size_t rootId, gTree_canonMode mode, gTree_HashFunc hasher,
+                                                                                gTree_SubtreeHashes *hashes_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),       gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_HashSubtree);
+    GTREE_ASSERT_LOG(gPtrValid(hashes_out), gTree_status_BadOutPtr,    tree->logStream);
+    GTREE_ID_VAL(rootId);
+
+    size_t cnt = 0;
+    for (size_t id = rootId; id != -1; id = gTree_nextPreorder(tree, rootId, id))
+        ++cnt;
+    size_t *ids = (size_t*)malloc(cnt * (2 * sizeof(size_t) + sizeof(uint64_t)));
+    GTREE_ASSERT_LOG(ids != NULL, gTree_status_AllocErr, tree->logStream);
+    size_t *sizes    = ids + cnt;
+    uint64_t *hashes = (uint64_t*)(sizes + cnt);
+
+    size_t rank = 0;
+    for (size_t id = rootId; id != -1; id = gTree_nextPreorder(tree, rootId, id))
+        ids[rank++] = id;
+
+    /* reverse preorder visits children before their parent */
+    for (rank = cnt; rank-- > 0;) {
+        const gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[rank]);
+        uint64_t hash = gTree_hashData(&node->data, hasher);
+        uint64_t bag  = 0;
+        size_t size = 1, childCnt = 0, childRank = rank + 1;
+        for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+            if (mode == gTree_canon_Ordered)
+                hash = gTree_hashMix(hash, hashes[childRank]);
+            else
+                bag += gTree_hashMix(0, hashes[childRank]);
+            size      += sizes[childRank];
+            childRank += sizes[childRank];
+            ++childCnt;
+        }
+        if (mode == gTree_canon_Unordered && childCnt != 0)
+            hash = gTree_hashMix(hash, bag);
+        sizes[rank]  = size;
+        hashes[rank] = gTree_hashMix(hash, childCnt);
+    }
+
+    hashes_out->cnt    = cnt;
+    hashes_out->ids    = ids;
+    hashes_out->sizes  = sizes;
+    hashes_out->hashes = hashes;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief gTree_Patch constructor
+ * @param patch pointer to structure to construct on
+ * @return gTree status code
+ */
+static gTree_status gTree_patchCtor(gTree_Patch *patch)
+{
+    if (!gPtrValid(patch))
+        return gTree_status_BadPatch;
+    patch->ops     = NULL;
+    patch->opCnt   = 0;
+    patch->opCap   = 0;
+    patch->paths   = NULL;
+    patch->pathCnt = 0;
+    patch->pathCap = 0;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief gTree_Patch destructor
+ * @param patch pointer to structure to destruct
+ * @return gTree status code
+ */
+static gTree_status gTree_patchDtor(gTree_Patch *patch)
+{
+    if (!gPtrValid(patch))
+        return gTree_status_BadPatch;
+    free(patch->ops);
+    free(patch->paths);
+    return gTree_patchCtor(patch);
+}
+
+
+/**
+ * @brief state of gTree_diff shared by all levels of recursion
+ */
+struct gTree_DiffCtx
+{
+    const gTree *a;
+    const gTree *b;
+    gTree_SubtreeHashes hashA;
+    gTree_SubtreeHashes hashB;
+    gTree_HashFunc hasher;
+    gTree_Patch *patch;
+    size_t *path;               /// Path of the node being diffed
+    size_t pathCap;
+    struct gTree_DiffFrame *frames;     /// Node pairs being diffed, from the root down
+    size_t frameCnt;
+    size_t frameCap;
+} typedef gTree_DiffCtx;
+
+
+/**
+ * @brief appends operation with the current path of the context to the patch
+ */
+static bool gTree_diffPushOp(gTree_DiffCtx *ctx, gTree_PatchOpType type, size_t depth, size_t pos, size_t from, const GTREE_TYPE *data)
+{
+    gTree_Patch *patch = ctx->patch;
+    if (!gTree_growArray((void**)&patch->ops,   &patch->opCap,   patch->opCnt + 1,       sizeof(gTree_PatchOp)) ||
+        !gTree_growArray((void**)&patch->paths, &patch->pathCap, patch->pathCnt + depth, sizeof(size_t)))
+        return false;
+
+    gTree_PatchOp *op = &patch->ops[patch->opCnt++];
+    op->type  = type;
+    op->path  = patch->pathCnt;
+    op->depth = depth;
+    op->pos   = pos;
+    op->from  = from;
+    if (data != NULL)
+        op->data = *data;
+    else
+        memset((void*)&op->data, 0, sizeof(GTREE_TYPE));
+    if (depth != 0)
+        memcpy(patch->paths + patch->pathCnt, ctx->path, depth * sizeof(size_t));
+    patch->pathCnt += depth;
+    return true;
+}
+
+
+/**
+ * @brief emits inserts of the whole `b` subtree as child number pos of the node at path of length depth (in preorder)
+ */
+static gTree_status gTree_diffInsert(gTree_DiffCtx *ctx, size_t depth, size_t pos, size_t nodeId)
+{
+    const gTree *tree = ctx->a;
+    size_t id = nodeId;
+    for (;;) {
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, id);
+        GTREE_ASSERT_LOG(gTree_diffPushOp(ctx, gTree_patch_Insert, depth, pos, 0, &node->data), gTree_status_AllocErr, tree->logStream);
+        if (node->child != -1) {
+            GTREE_ASSERT_LOG(gTree_growArray((void**)&ctx->path, &ctx->pathCap, depth + 1, sizeof(size_t)),
+                                                                gTree_status_AllocErr, tree->logStream);
+            ctx->path[depth++] = pos;
+            pos = 0;
+            id  = node->child;
+            continue;
+        }
+        while (id != nodeId && GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, id)->sibling == -1) {
+            id  = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, id)->parent;
+            pos = ctx->path[--depth];
+        }
+        if (id == nodeId)
+            return gTree_status_OK;
+        id = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, id)->sibling;
+        ++pos;
+    }
+}
+
+
+/**
+ * @brief checks if payloads of `a` node and `b` node are the same
+ */
+static bool gTree_diffSameData(const gTree_DiffCtx *ctx, size_t aId, size_t bId)
+{
+    gTree_Node *aNode = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->a->pool, aId);
+    gTree_Node *bNode = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, bId);
+    if (ctx->hasher != NULL)
+        return ctx->hasher(&aNode->data) == ctx->hasher(&bNode->data);
+    return memcmp((const void*)&aNode->data, (const void*)&bNode->data, sizeof(GTREE_TYPE)) == 0;
+}
+
+
+/**
+ * @brief child number idx keyed by its subtree or payload hash
+ */
+struct gTree_DiffKey
+{
+    uint64_t key;
+    size_t idx;
+} typedef gTree_DiffKey;
+
+
+static int gTree_diffKeyCmp(const void *first, const void *second)
+{
+    const gTree_DiffKey *a = (const gTree_DiffKey*)first;
+    const gTree_DiffKey *b = (const gTree_DiffKey*)second;
+    if (a->key != b->key)
+        return (a->key > b->key) - (a->key < b->key);
+    return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+
+/**
+ * @brief children of a node pair being diffed; `a` children not used yet keep their order,
+ *        so their positions are counted by a Fenwick tree and matches are found in tables sorted by key
+ */
+struct gTree_DiffFrame
+{
+    size_t depth;
+    size_t curCnt;              /// Number of `a` children
+    size_t wantCnt;             /// Number of `b` children
+    size_t j;                   /// Number of `b` children done, all of them are in place
+    size_t head;                /// First `a` child not used yet (it is at position j)
+    size_t leftCnt;             /// Number of `a` children not used yet
+    size_t *cur;                /// `a` children
+    size_t *want;               /// `b` children
+    size_t *curRank;            /// Preorder ranks of `a` children in ctx->hashA
+    size_t *wantRank;           /// Preorder ranks of `b` children in ctx->hashB
+    size_t *ranks;              /// Fenwick tree of the `a` children not used yet
+    gTree_DiffKey *byHash;      /// `a` children by subtree hash
+    gTree_DiffKey *byData;      /// `a` children by payload hash
+    size_t *hashNext;           /// Entry of a byHash group to look for unused children from (by group start)
+    size_t *dataNext;
+    gTree_DiffKey *wantLeft;    /// `b` children by subtree hash
+    size_t *leftInGroup;        /// `b` children not done yet (by group start)
+    bool *used;
+} typedef gTree_DiffFrame;
+
+
+/**
+ * @brief first entry with the key in a sorted table, or cnt
+ */
+static size_t gTree_diffFind(const gTree_DiffKey *keys, size_t cnt, uint64_t key)
+{
+    size_t lo = 0, hi = cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < cnt && keys[lo].key == key) ? lo : cnt;
+}
+
+
+/**
+ * @brief first `a` child with the key not used yet, or -1 (skipped entries are never looked at again)
+ */
+static size_t gTree_diffFirstUnused(const gTree_DiffFrame *frame, const gTree_DiffKey *keys, size_t *next, uint64_t key)
+{
+    size_t group = gTree_diffFind(keys, frame->curCnt, key);
+    if (group == frame->curCnt)
+        return -1;
+    size_t entry = next[group];
+    while (entry < frame->curCnt && keys[entry].key == key && frame->used[keys[entry].idx])
+        ++entry;
+    next[group] = entry;
+    return (entry < frame->curCnt && keys[entry].key == key) ? keys[entry].idx : -1;
+}
+
+
+/**
+ * @brief current position of the unused `a` child number idx
+ */
+static size_t gTree_diffPos(const gTree_DiffFrame *frame, size_t idx)
+{
+    size_t pos = frame->j;
+    for (size_t i = idx; i > 0; i -= i & -i)
+        pos += frame->ranks[i];
+    return pos;
+}
+
+
+static void gTree_diffUse(gTree_DiffFrame *frame, size_t idx)
+{
+    frame->used[idx] = true;
+    --frame->leftCnt;
+    for (size_t i = idx + 1; i <= frame->curCnt; i += i & -i)
+        --frame->ranks[i];
+    while (frame->head < frame->curCnt && frame->used[frame->head])
+        ++frame->head;
+}
+
+
+/**
+ * @brief marks the current `b` child as done
+ */
+static void gTree_diffAdvance(const gTree_DiffCtx *ctx, gTree_DiffFrame *frame)
+{
+    --frame->leftInGroup[gTree_diffFind(frame->wantLeft, frame->wantCnt, ctx->hashB.hashes[frame->wantRank[frame->j]])];
+    ++frame->j;
+}
+
+
+/**
+ * @brief checks if some `b` child not done yet has the subtree hash
+ */
+static bool gTree_diffWanted(const gTree_DiffFrame *frame, uint64_t hash)
+{
+    size_t group = gTree_diffFind(frame->wantLeft, frame->wantCnt, hash);
+    return group != frame->wantCnt && frame->leftInGroup[group] != 0;
+}
+
+
+/**
+ * @brief starts diffing `a` node against `b` node (given with their preorder ranks) at path of length depth, pushes its frame
+ */
+static gTree_status gTree_diffEnter(gTree_DiffCtx *ctx, size_t depth, size_t aId, size_t bId, size_t aRank, size_t bRank)
+{
+    const gTree *tree = ctx->a;
+    gTree_Node *aNode = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->a->pool, aId);
+    gTree_Node *bNode = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, bId);
+
+    if (!gTree_diffSameData(ctx, aId, bId))
+        GTREE_ASSERT_LOG(gTree_diffPushOp(ctx, gTree_patch_Update, depth, 0, 0, &bNode->data), gTree_status_AllocErr, tree->logStream);
+
+    size_t n = 0, m = 0;
+    for (size_t id = aNode->child; id != -1; id = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->a->pool, id)->sibling)
+        ++n;
+    for (size_t id = bNode->child; id != -1; id = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, id)->sibling)
+        ++m;
+    GTREE_ASSERT_LOG(gTree_growArray((void**)&ctx->frames, &ctx->frameCap, ctx->frameCnt + 1, sizeof(gTree_DiffFrame)),
+                                                                gTree_status_AllocErr, tree->logStream);
+
+    gTree_DiffFrame *frame = &ctx->frames[ctx->frameCnt];
+    memset((void*)frame, 0, sizeof(gTree_DiffFrame));
+    gTree_DiffKey *keys = (gTree_DiffKey*)malloc((2 * n + m) * sizeof(gTree_DiffKey) + (5 * n + 3 * m + 1) * sizeof(size_t) + n);
+    GTREE_ASSERT_LOG(keys != NULL, gTree_status_AllocErr, tree->logStream);
+    ++ctx->frameCnt;
+    frame->depth       = depth;
+    frame->curCnt      = frame->leftCnt = n;
+    frame->wantCnt     = m;
+    frame->byHash      = keys;
+    frame->byData      = keys + n;
+    frame->wantLeft    = keys + 2 * n;
+    frame->cur         = (size_t*)(keys + 2 * n + m);
+    frame->want        = frame->cur + n;
+    frame->curRank     = frame->want + m;
+    frame->wantRank    = frame->curRank + n;
+    frame->ranks       = frame->wantRank + m;
+    frame->hashNext    = frame->ranks + n + 1;
+    frame->dataNext    = frame->hashNext + n;
+    frame->leftInGroup = frame->dataNext + n;
+    frame->used        = (bool*)(frame->leftInGroup + m);
+
+    size_t i = 0, rank = aRank + 1;
+    for (size_t id = aNode->child; id != -1; id = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->a->pool, id)->sibling, ++i) {
+        frame->cur[i]     = id;
+        frame->curRank[i] = rank;
+        frame->byHash[i]  = {ctx->hashA.hashes[rank], i};
+        rank += ctx->hashA.sizes[rank];
+        frame->byData[i] = {gTree_hashData(&GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->a->pool, id)->data, ctx->hasher), i};
+        frame->hashNext[i] = frame->dataNext[i] = i;
+        frame->ranks[i + 1] = (i + 1) & -(i + 1);      // every child is unused
+        frame->used[i] = false;
+    }
+    i = 0;
+    rank = bRank + 1;
+    for (size_t id = bNode->child; id != -1; id = GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, id)->sibling, ++i) {
+        frame->want[i]     = id;
+        frame->wantRank[i] = rank;
+        frame->wantLeft[i] = {ctx->hashB.hashes[rank], i};
+        rank += ctx->hashB.sizes[rank];
+    }
+    qsort(frame->byHash,   n, sizeof(gTree_DiffKey), gTree_diffKeyCmp);
+    qsort(frame->byData,   n, sizeof(gTree_DiffKey), gTree_diffKeyCmp);
+    qsort(frame->wantLeft, m, sizeof(gTree_DiffKey), gTree_diffKeyCmp);
+    for (i = 0; i < m; ++i)
+        frame->leftInGroup[gTree_diffFind(frame->wantLeft, m, frame->wantLeft[i].key)] = 0;
+    for (i = 0; i < m; ++i)
+        ++frame->leftInGroup[gTree_diffFind(frame->wantLeft, m, frame->wantLeft[i].key)];
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief emits operations transforming `a` subtree into `b` subtree (one frame per level instead of recursion),
+ *        O((c + k) log(c + k)) for a node with c children in `a` and k in `b`
+ */
+static gTree_status gTree_diffNode(gTree_DiffCtx *ctx, size_t aId, size_t bId)
+{
+    gTree_status status = gTree_diffEnter(ctx, 0, aId, bId, 0, 0);
+    while (status == gTree_status_OK && ctx->frameCnt != 0) {
+        gTree_DiffFrame *frame = &ctx->frames[ctx->frameCnt - 1];
+        size_t depth = frame->depth;
+        size_t j     = frame->j;
+        if (j == frame->wantCnt) {
+            for (size_t pos = j + frame->leftCnt; pos > frame->wantCnt && status == gTree_status_OK; --pos)
+                if (!gTree_diffPushOp(ctx, gTree_patch_Delete, depth, pos - 1, 0, NULL))
+                    status = gTree_status_AllocErr;
+            free(frame->byHash);
+            --ctx->frameCnt;
+            continue;
+        }
+
+        size_t wantId = frame->want[j];
+        uint64_t wantHash = ctx->hashB.hashes[frame->wantRank[j]];
+        size_t head = frame->head;
+        bool hasHead = (head < frame->curCnt);
+        if (hasHead && ctx->hashA.hashes[frame->curRank[head]] == wantHash) {
+            gTree_diffUse(frame, head);
+            gTree_diffAdvance(ctx, frame);
+            continue;
+        }
+
+        bool wantedLater = hasHead && gTree_diffWanted(frame, ctx->hashA.hashes[frame->curRank[head]]);
+        size_t idx = gTree_diffFirstUnused(frame, frame->byHash, frame->hashNext, wantHash);
+        if (idx != -1) {
+            /* wanted child is further: either current one was deleted or the wanted one was moved */
+            bool deleted = !wantedLater;
+            if (!gTree_diffPushOp(ctx, deleted ? gTree_patch_Delete : gTree_patch_Move, depth, j, deleted ? 0 : gTree_diffPos(frame, idx), NULL)) {
+                status = gTree_status_AllocErr;
+                break;
+            }
+            if (deleted) {
+                gTree_diffUse(frame, head);
+            } else {
+                gTree_diffUse(frame, idx);
+                gTree_diffAdvance(ctx, frame);
+            }
+            continue;
+        }
+
+        /* changed subtree, prefer the one with the same root payload (it could be moved as well) */
+        uint64_t dataKey = gTree_hashData(&GOBJPOOL_VAL_BY_ID_UNSAFE(&ctx->b->pool, wantId)->data, ctx->hasher);
+        idx = gTree_diffFirstUnused(frame, frame->byData, frame->dataNext, dataKey);
+        if (idx != -1 && idx != head) {
+            if (!gTree_diffPushOp(ctx, gTree_patch_Move, depth, j, gTree_diffPos(frame, idx), NULL)) {
+                status = gTree_status_AllocErr;
+                break;
+            }
+            head = idx;
+            wantedLater = false;
+        }
+
+        gTree_diffAdvance(ctx, frame);
+        if (hasHead && !wantedLater) {
+            size_t curId   = frame->cur[head];
+            size_t curRank = frame->curRank[head];
+            gTree_diffUse(frame, head);
+            if (!gTree_growArray((void**)&ctx->path, &ctx->pathCap, depth + 1, sizeof(size_t))) {
+                status = gTree_status_AllocErr;
+                break;
+            }
+            ctx->path[depth] = j;
+            status = gTree_diffEnter(ctx, depth + 1, curId, wantId, curRank, frame->wantRank[j]);
+        } else {
+            status = gTree_diffInsert(ctx, depth, j, wantId);
+        }
+    }
+
+    for (; ctx->frameCnt != 0; --ctx->frameCnt)
+        free(ctx->frames[ctx->frameCnt - 1].byHash);
+    return status;
+}
+
+
+/**
+ * @brief computes edit script that transforms tree `a` into tree `b`, identical subtrees are skipped by hash
+ * @param a pointer to the source tree
+ * @param b pointer to the target tree
+ * @param[out] patch constructed patch to append operations to
+ * @param hasher payload hash (could be NULL, then payloads are compared byte by byte)
+ * @return gTree status code
+ */
+static gTree_status gTree_diff(const gTree *a, const gTree *b, gTree_Patch *patch, gTree_HashFunc hasher)
+{
+    const gTree *tree = a;
+    GTREE_ASSERT_LOG(gPtrValid(a),     gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Diff);
+    GTREE_ASSERT_LOG(gPtrValid(b),     gTree_status_BadStructPtr, a->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(patch), gTree_status_BadPatch,     a->logStream);
+
+    gTree_DiffCtx ctx = {};
+    ctx.a = a;
+    ctx.b = b;
+    ctx.hasher = hasher;
+    ctx.patch  = patch;
+
+    gTree_status status = gTree_hashSubtree(a, a->root, gTree_canon_Ordered, hasher, &ctx.hashA);
+    GTREE_IS_OK(status);
+    status = gTree_hashSubtree(b, b->root, gTree_canon_Ordered, hasher, &ctx.hashB);
+    if (status == gTree_status_OK && ctx.hashA.hashes[0] != ctx.hashB.hashes[0])
+        status = gTree_diffNode(&ctx, a->root, b->root);
+
+    gTree_subtreeHashesDtor(&ctx.hashA);
+    gTree_subtreeHashesDtor(&ctx.hashB);
+    free(ctx.path);
+    free(ctx.frames);
+    return status;
+}
+
+
+/**
+ * @brief links parentless node as the child number pos
+ * @param tree pointer to structure
+ * @param parentId id of a parent node
+ * @param pos position to put the child at (starting with 0)
+ * @param childId id of a parentless node
+ * @return gTree status code
+ */
+static gTree_status gTree_linkChildAt(gTree *tree, size_t parentId, size_t pos, size_t childId)
+{
+    GTREE_ID_VAL(parentId);
+    GTREE_ID_VAL(childId);
+
+    GTREE_TOUCH(childId);
+    gTree_Node *child = GTREE_NODE_BY_ID(childId);
+    GTREE_STORE_LINK(child->parent, parentId);
+    if (pos == 0) {
+        GTREE_TOUCH(parentId);
+        gTree_Node *parent = GTREE_NODE_BY_ID(parentId);
+        GTREE_STORE_LINK(child->sibling, parent->child);
+        GTREE_STORE_LINK(parent->child, childId);
+        if (parent->tail == -1)
+            GTREE_STORE_LINK(parent->tail, childId);
+        return gTree_status_OK;
+    }
+
+    size_t prevId = GTREE_NODE_BY_ID(parentId)->child;
+    for (size_t i = 0; i + 1 < pos && prevId != -1; ++i)
+        prevId = GTREE_NODE_BY_ID(prevId)->sibling;
+    GTREE_ASSERT_LOG(prevId != -1, gTree_status_BadPos, tree->logStream);
+
+    GTREE_TOUCH(prevId);
+    gTree_Node *prev = GTREE_NODE_BY_ID(prevId);
+    GTREE_STORE_LINK(child->sibling, prev->sibling);
+    GTREE_STORE_LINK(prev->sibling, childId);
+    if (GTREE_NODE_BY_ID(parentId)->tail == prevId) {
+        GTREE_TOUCH(parentId);
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(parentId)->tail, childId);
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief unlinks the child number pos (the child keeps its subtree)
+ * @param tree pointer to structure
+ * @param parentId id of a parent node
+ * @param pos position of the child (starting with 0)
+ * @param[out] id_out ptr to write unlinked child id to
+ * @return gTree status code
+ */
+static gTree_status gTree_unlinkChildAt(gTree *tree, size_t parentId, size_t pos, size_t *id_out)
+{
+    GTREE_ID_VAL(parentId);
+
+    size_t prevId  = -1;
+    size_t childId = GTREE_NODE_BY_ID(parentId)->child;
+    for (size_t i = 0; i < pos && childId != -1; ++i) {
+        prevId  = childId;
+        childId = GTREE_NODE_BY_ID(childId)->sibling;
+    }
+    GTREE_ASSERT_LOG(childId != -1, gTree_status_BadPos, tree->logStream);
+
+    size_t nextId = GTREE_NODE_BY_ID(childId)->sibling;
+    if (prevId == -1) {
+        GTREE_TOUCH(parentId);
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(parentId)->child, nextId);
+    } else {
+        GTREE_TOUCH(prevId);
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(prevId)->sibling, nextId);
+    }
+    if (GTREE_NODE_BY_ID(parentId)->tail == childId) {
+        GTREE_TOUCH(parentId);
+        GTREE_STORE_LINK(GTREE_NODE_BY_ID(parentId)->tail, prevId);
+    }
+    GTREE_TOUCH(childId);
+    gTree_Node *child = GTREE_NODE_BY_ID(childId);
+    GTREE_STORE_LINK(child->parent, -1);
+    GTREE_STORE_LINK(child->sibling, -1);
+
+    *id_out = childId;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief applies edit script produced by gTree_diff
+ * @param tree pointer to structure
+ * @param patch patch to apply
+ * @return gTree status code
+ */
+static gTree_status gTree_applyPatch(gTree *tree, const gTree_Patch *patch)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),  gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_ApplyPatch);
+    GTREE_ASSERT_LOG(gPtrValid(patch), gTree_status_BadPatch,     tree->logStream);
+    GTREE_OBSERVE_SCOPE();
+
+    for (size_t i = 0; i < patch->opCnt; ++i) {
+        const gTree_PatchOp *op = &patch->ops[i];
+        GTREE_ASSERT_LOG(op->path + op->depth <= patch->pathCnt, gTree_status_BadPatch, tree->logStream);
+
+        size_t nodeId = tree->root;
+        for (size_t d = 0; d < op->depth; ++d) {
+            nodeId = GTREE_NODE_BY_ID(nodeId)->child;
+            for (size_t j = 0; j < patch->paths[op->path + d] && nodeId != -1; ++j)
+                nodeId = GTREE_NODE_BY_ID(nodeId)->sibling;
+            GTREE_ASSERT_LOG(nodeId != -1, gTree_status_BadPatch, tree->logStream);
+        }
+
+        size_t childId = -1;
+        switch (op->type) {
+            case gTree_patch_Insert:
+                childId = GTREE_POOL_ALLOC();
+                GTREE_NODE_BY_ID(childId)->data = op->data;
+                GTREE_IS_OK(gTree_linkChildAt(tree, nodeId, op->pos, childId));
+                GTREE_EVENT(gTree_ev_Insert, childId, nodeId, NULL);
+                break;
+            case gTree_patch_Delete:
+                GTREE_IS_OK(gTree_unlinkChildAt(tree, nodeId, op->pos, &childId));
+                GTREE_EVENT(gTree_ev_Kill, childId, nodeId, NULL);
+                GTREE_IS_OK(GTREE_QUIET(gTree_killSubtree(tree, childId)));
+                break;
+            case gTree_patch_Move:
+                GTREE_IS_OK(gTree_unlinkChildAt(tree, nodeId, op->from, &childId));
+                GTREE_IS_OK(gTree_linkChildAt(tree, nodeId, op->pos, childId));
+                GTREE_EVENT(gTree_ev_Move, childId, nodeId, NULL);
+                break;
+            case gTree_patch_Update:
+                GTREE_IS_OK(gTree_setData(tree, nodeId, op->data));
+                break;
+            default:
+                GTREE_ASSERT_LOG(false, gTree_status_BadPatch, tree->logStream);
+        }
+    }
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief computes canonical hash of the subtree, isomorphic subtrees get equal hashes
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param mode whether order of children matters
+ * @param hasher payload key (could be NULL, then raw bytes are hashed; return constant to ignore payloads)
+ * @param[out] hash_out ptr to write hash to
+ * @return gTree status code
+ */
+static gTree_status gTree_canonicalHash(const gTree *tree, size_t rootId, gTree_canonMode mode, gTree_HashFunc hasher, uint64_t *hash_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),     gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_CanonicalHash);
+    GTREE_ASSERT_LOG(gPtrValid(hash_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    gTree_SubtreeHashes hashes = {};
+    GTREE_IS_OK(gTree_hashSubtree(tree, rootId, mode, hasher, &hashes));
+    *hash_out = hashes.hashes[0];
+    gTree_subtreeHashesDtor(&hashes);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief sorts keys by LSD radix sort (O(cnt) per byte of the key), tmp must hold cnt keys
+ */
+static void gTree_radixSortKeys(gTree_DiffKey *keys, gTree_DiffKey *tmp, size_t cnt)
+{
+    for (size_t shift = 0; shift < 64; shift += 8) {
+        size_t starts[257] = {};
+        for (size_t i = 0; i < cnt; ++i)
+            ++starts[((keys[i].key >> shift) & 0xFF) + 1];
+        if (cnt != 0 && starts[((keys[0].key >> shift) & 0xFF) + 1] == cnt)
+            continue;
+        for (size_t digit = 0; digit < 256; ++digit)
+            starts[digit + 1] += starts[digit];
+        for (size_t i = 0; i < cnt; ++i)
+            tmp[starts[(keys[i].key >> shift) & 0xFF]++] = keys[i];
+        memcpy((void*)keys, (const void*)tmp, cnt * sizeof(gTree_DiffKey));
+    }
+}
+
+
+/**
+ * @brief compares payloads for canonical forms: by the comparator, else by their keys, else by their raw bytes
+ */
+static int gTree_canonDataCmp(const GTREE_TYPE *first, const GTREE_TYPE *second, gTree_HashFunc hasher, gTree_CmpFunc cmp)
+{
+    if (cmp != NULL)
+        return cmp(first, second);
+    if (hasher != NULL) {
+        uint64_t keyA = hasher(first), keyB = hasher(second);
+        return (keyA > keyB) - (keyA < keyB);
+    }
+    return memcmp((const void*)first, (const void*)second, sizeof(GTREE_TYPE));
+}
+
+
+/**
+ * @brief payload hash of canonical forms ordered by a comparator without a key: payloads it finds equal could
+ *        differ in bytes, so siblings are grouped by shape only and the comparator orders them
+ */
+static uint64_t gTree_shapeKey(const GTREE_TYPE *)
+{
+    return 0;
+}
+
+
+/**
+ * @brief number of form words a payload takes: its key if only the hasher is given, its raw bytes otherwise
+ */
+static size_t gTree_canonDataWords(gTree_HashFunc hasher, gTree_CmpFunc cmp)
+{
+    return (hasher != NULL && cmp == NULL) ? 1 : (sizeof(GTREE_TYPE) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+
+/**
+ * @brief state of gTree_canonicalForm shared by the sibling comparisons
+ */
+struct gTree_CanonCtx
+{
+    const gTree *tree;
+    gTree_HashFunc hasher;
+    gTree_CmpFunc cmp;
+    const gTree_SubtreeHashes *hashes;
+    const size_t *order;        /// Children ranks grouped by parent rank
+    const size_t *starts;       /// Children of rank r are order[starts[r]..starts[r + 1])
+    size_t *stackA;             /// Walk stacks of gTree_canonCmp (subtree size each)
+    size_t *stackB;
+} typedef gTree_CanonCtx;
+
+
+/**
+ * @brief compares canonical encodings of two subtrees whose children are already in canonical order
+ * @return negative, zero or positive like for qsort
+ */
+static int gTree_canonCmp(const gTree_CanonCtx *ctx, size_t a, size_t b)
+{
+    const gTree *tree = ctx->tree;
+    size_t lenA = 0, lenB = 0;
+    ctx->stackA[lenA++] = a;
+    ctx->stackB[lenB++] = b;
+    while (lenA != 0) {
+        size_t rankA = ctx->stackA[--lenA], rankB = ctx->stackB[--lenB];
+        int dataCmp = gTree_canonDataCmp(&GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ctx->hashes->ids[rankA])->data,
+                                         &GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ctx->hashes->ids[rankB])->data, ctx->hasher, ctx->cmp);
+        if (dataCmp != 0)
+            return dataCmp;
+        size_t cntA = ctx->starts[rankA + 1] - ctx->starts[rankA], cntB = ctx->starts[rankB + 1] - ctx->starts[rankB];
+        if (cntA != cntB)
+            return (cntA < cntB) ? -1 : 1;
+        for (size_t i = cntA; i > 0; --i) {
+            ctx->stackA[lenA++] = ctx->order[ctx->starts[rankA] + i - 1];
+            ctx->stackB[lenB++] = ctx->order[ctx->starts[rankB] + i - 1];
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief stable bottom-up merge sort of sibling ranks by their canonical encodings, tmp must hold cnt ranks
+ */
+static void gTree_canonSort(const gTree_CanonCtx *ctx, size_t *ranks, size_t *tmp, size_t cnt)
+{
+    for (size_t width = 1; width < cnt; width *= 2) {
+        for (size_t lo = 0; lo < cnt; lo += 2 * width) {
+            size_t mid = (lo + width < cnt) ? lo + width : cnt;
+            size_t hi  = (mid + width < cnt) ? mid + width : cnt;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                tmp[k++] = (gTree_canonCmp(ctx, ranks[j], ranks[i]) < 0) ? ranks[j++] : ranks[i++];
+            while (i < mid)
+                tmp[k++] = ranks[i++];
+            while (j < hi)
+                tmp[k++] = ranks[j++];
+        }
+        memcpy(ranks, tmp, cnt * sizeof(size_t));
+    }
+}
+
+
+/**
+ * @brief computes canonical encoding of the subtree: for each node in preorder its payload and
+ *        number of children, children of unordered mode are taken in the order of their hashes
+ *        (radix sorted all at once and grouped by parent, so it is O(n) as well);
+ *        siblings with equal hashes are ordered by their encodings as in AHU, so neither colliding subtree hashes
+ *        nor colliding payload hashes make trees equal or different (O(n log n) comparisons at worst)
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param mode whether order of children matters
+ * @param hasher payload key (could be NULL; return constant to ignore payloads), with cmp it must give
+ *        equal keys to the payloads cmp finds equal
+ * @param cmp payload comparator (could be NULL, then payloads are compared by their keys, or by their raw bytes,
+ *        padding included, if hasher is NULL too)
+ * @param[out] form_out ptr to write malloc'ed encoding to (payload takes one word if only hasher is given,
+ *        its raw bytes otherwise; with cmp the forms must be compared by gTree_isomorphic)
+ * @param[out] len_out ptr to write encoding length to
+ * @return gTree status code
+ */
+static gTree_status gTree_canonicalForm(const gTree *tree, size_t rootId, gTree_canonMode mode, gTree_HashFunc hasher,
+                                                            gTree_CmpFunc cmp, uint64_t **form_out, size_t *len_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),     gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_CanonicalForm);
+    GTREE_ASSERT_LOG(gPtrValid(form_out), gTree_status_BadOutPtr,    tree->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(len_out),  gTree_status_BadOutPtr,    tree->logStream);
+
+    gTree_SubtreeHashes hashes = {};
+    GTREE_IS_OK(gTree_hashSubtree(tree, rootId, mode, (cmp != NULL && hasher == NULL) ? gTree_shapeKey : hasher, &hashes));
+    size_t cnt = hashes.cnt;
+    size_t dataWords = gTree_canonDataWords(hasher, cmp);
+
+    /* children ranks grouped by parent rank (children of r are order[starts[r]..starts[r + 1])) */
+    uint64_t *form = (uint64_t*)malloc((dataWords + 1) * cnt * sizeof(uint64_t));
+    size_t *order  = (size_t*)malloc((3 * cnt + 1) * sizeof(size_t));
+    gTree_DiffKey *keys = (gTree_DiffKey*)malloc(2 * cnt * sizeof(gTree_DiffKey));
+    if (form == NULL || order == NULL || keys == NULL) {
+        free(form);
+        free(order);
+        free(keys);
+        gTree_subtreeHashesDtor(&hashes);
+        GTREE_ASSERT_LOG(false, gTree_status_AllocErr, tree->logStream);
+    }
+    size_t *parents = order + cnt;
+    size_t *starts  = parents + cnt;
+
+    memset(starts, 0, (cnt + 1) * sizeof(size_t));
+    for (size_t rank = 0; rank < cnt; ++rank) {
+        keys[rank] = {(mode == gTree_canon_Unordered) ? hashes.hashes[rank] : 0, rank};
+        for (size_t child = rank + 1; child < rank + hashes.sizes[rank]; child += hashes.sizes[child]) {
+            parents[child] = rank;
+            ++starts[rank + 1];
+        }
+    }
+    if (mode == gTree_canon_Unordered)
+        gTree_radixSortKeys(keys, keys + cnt, cnt);
+    for (size_t rank = 0; rank < cnt; ++rank)
+        starts[rank + 1] += starts[rank];
+    for (size_t i = 0; i < cnt; ++i)
+        if (keys[i].idx != 0)
+            order[starts[parents[keys[i].idx]]++] = keys[i].idx;
+    for (size_t rank = cnt; rank > 0; --rank)
+        starts[rank] = starts[rank - 1];
+    starts[0] = 0;
+
+    /* descendants have greater ranks, so going down the ranks compares subtrees already in canonical order;
+       keys are reused as the two walk stacks and the merge buffer */
+    gTree_CanonCtx ctx = {tree, hasher, cmp, &hashes, order, starts, (size_t*)keys, (size_t*)keys + cnt};
+    for (size_t rank = cnt; mode == gTree_canon_Unordered && rank > 0; --rank) {
+        size_t *children = order + starts[rank - 1];
+        size_t childCnt  = starts[rank] - starts[rank - 1];
+        for (size_t first = 0, last = 0; first < childCnt; first = last) {
+            bool same = true;
+            for (last = first + 1; last < childCnt && hashes.hashes[children[last]] == hashes.hashes[children[first]]; ++last)
+                same = same && gTree_canonCmp(&ctx, children[first], children[last]) == 0;
+            if (!same)
+                gTree_canonSort(&ctx, children + first, (size_t*)keys + 2 * cnt, last - first);
+        }
+    }
+
+    /* preorder by the canonical order, the stack reuses keys */
+    size_t *stack = (size_t*)keys;
+    size_t stackLen = 0, formLen = 0;
+    if (cnt != 0)
+        stack[stackLen++] = 0;
+    while (stackLen != 0) {
+        size_t rank = stack[--stackLen];
+        const GTREE_TYPE *data = &GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, hashes.ids[rank])->data;
+        if (hasher != NULL && cmp == NULL) {
+            form[formLen] = hasher(data);
+        } else {
+            memset(form + formLen, 0, dataWords * sizeof(uint64_t));
+            memcpy((void*)(form + formLen), (const void*)data, sizeof(GTREE_TYPE));
+        }
+        formLen += dataWords;
+        form[formLen++] = starts[rank + 1] - starts[rank];
+        for (size_t i = starts[rank + 1]; i > starts[rank]; --i)
+            stack[stackLen++] = order[i - 1];
+    }
+
+    free(order);
+    free(keys);
+    gTree_subtreeHashesDtor(&hashes);
+    *form_out = form;
+    *len_out  = formLen;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief checks if two subtrees are isomorphic by comparing their canonical forms
+ * @param a pointer to the first tree
+ * @param aRoot id of a subtree root in the first tree
+ * @param b pointer to the second tree
+ * @param bRoot id of a subtree root in the second tree
+ * @param mode whether order of children matters
+ * @param hasher payload key (could be NULL; return constant to ignore payloads), see gTree_canonicalForm
+ * @param cmp payload comparator (could be NULL, then payloads are compared by their keys or raw bytes)
+ * @param[out] result_out ptr to write result to
+ * @return gTree status code
+ */
+static gTree_status gTree_isomorphic(const gTree *a, size_t aRoot, const gTree *b, size_t bRoot, gTree_canonMode mode,
+                                                    gTree_HashFunc hasher, gTree_CmpFunc cmp, bool *result_out)
+{
+    const gTree *tree = a;
+    GTREE_ASSERT_LOG(gPtrValid(a),          gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Isomorphic);
+    GTREE_ASSERT_LOG(gPtrValid(b),          gTree_status_BadStructPtr, a->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(result_out), gTree_status_BadOutPtr,    a->logStream);
+
+    uint64_t *formA = NULL, *formB = NULL;
+    size_t lenA = 0, lenB = 0;
+    GTREE_IS_OK(gTree_canonicalForm(a, aRoot, mode, hasher, cmp, &formA, &lenA));
+    gTree_status status = gTree_canonicalForm(b, bRoot, mode, hasher, cmp, &formB, &lenB);
+    if (status == gTree_status_OK) {
+        bool same = (lenA == lenB);
+        if (cmp == NULL)
+            same = same && memcmp(formA, formB, lenA * sizeof(uint64_t)) == 0;
+        size_t step = gTree_canonDataWords(hasher, cmp) + 1;
+        for (size_t i = 0; cmp != NULL && same && i < lenA; i += step) {
+            GTREE_TYPE dataA, dataB;
+            memcpy((void*)&dataA, (const void*)(formA + i), sizeof(GTREE_TYPE));
+            memcpy((void*)&dataB, (const void*)(formB + i), sizeof(GTREE_TYPE));
+            same = formA[i + step - 1] == formB[i + step - 1] && cmp(&dataA, &dataB) == 0;
+        }
+        *result_out = same;
+    }
+
+    free(formA);
+    free(formB);
+    return status;
+}
+
+
+/**
+ * @brief state of gTree_parallelFor shared by the threads
+ */
+struct gTree_ParallelFor
+{
+    size_t taskCnt;
+    size_t next;                /// Next task to take (atomic)
+    void (*fn)(size_t task, void *arg);
+    void *arg;
+} typedef gTree_ParallelFor;
+
+static void *gTree_parallelForWorker(void *state)
+{
+    gTree_ParallelFor *pf = (gTree_ParallelFor*)state;
+    size_t task = 0;
+    while ((task = __atomic_fetch_add(&pf->next, 1, __ATOMIC_RELAXED)) < pf->taskCnt)
+        pf->fn(task, pf->arg);
+    return NULL;
+}
+
+/**
+ * @brief runs fn(task, arg) for every task in [0, taskCnt) on nThreads threads (the calling one included)
+ * @param nThreads number of threads to use (0 or 1 means run in the calling thread)
+ * @param taskCnt number of tasks
+ * @param fn task function
+ * @param arg argument to forward to fn
+ * @return true on success, false on allocation failure
+ */
+static bool gTree_parallelFor(size_t nThreads, size_t taskCnt, void (*fn)(size_t task, void *arg), void *arg)
+{
+    gTree_ParallelFor pf = {taskCnt, 0, fn, arg};
+    if (nThreads > taskCnt)
+        nThreads = taskCnt;
+    if (nThreads <= 1) {
+        gTree_parallelForWorker(&pf);
+        return true;
+    }
+
+    pthread_t *threads = (pthread_t*)calloc(nThreads - 1, sizeof(pthread_t));
+    if (threads == NULL)
+        return false;
+    size_t started = 0;
+    while (started + 1 < nThreads && pthread_create(&threads[started], NULL, gTree_parallelForWorker, &pf) == 0)
+        ++started;
+    gTree_parallelForWorker(&pf);
+    for (size_t i = 0; i < started; ++i)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    return true;
+}
+
+
+/**
+ * @brief stable merge sort of the sibling list (nodes must be touched already)
+ * @param tree pointer to structure
+ * @param head id of the first node of the list
+ * @param len length of the list
+ * @param cmp payload comparator
+ * @param[out] tail_out ptr to write id of the new last node to
+ * @return id of the new first node
+ */
+static size_t gTree_sortSiblings(gTree *tree, size_t head, size_t len, gTree_CmpFunc cmp, size_t *tail_out)
+{
+    if (len < 2) {
+        *tail_out = head;
+        return head;
+    }
+
+    size_t half = len / 2;
+    size_t lastId = head;
+    for (size_t i = 1; i < half; ++i)
+        lastId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, lastId)->sibling;
+    gTree_Node *last = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, lastId);
+    size_t second = last->sibling;
+    GTREE_STORE_LINK(last->sibling, -1);
+
+    size_t firstTail = -1, secondTail = -1;
+    size_t first = gTree_sortSiblings(tree, head,   half,       cmp, &firstTail);
+    second       = gTree_sortSiblings(tree, second, len - half, cmp, &secondTail);
+
+    size_t newHead = -1;
+    size_t *link = &newHead;
+    while (first != -1 && second != -1) {
+        gTree_Node *firstNode  = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, first);
+        gTree_Node *secondNode = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, second);
+        if (cmp(&secondNode->data, &firstNode->data) < 0) {
+            GTREE_STORE_LINK(*link, second);
+            link   = &secondNode->sibling;
+            second = secondNode->sibling;
+        } else {
+            GTREE_STORE_LINK(*link, first);
+            link  = &firstNode->sibling;
+            first = firstNode->sibling;
+        }
+    }
+    GTREE_STORE_LINK(*link, (first != -1) ? first : second);
+    *tail_out = (first != -1) ? firstTail : secondTail;
+    return newHead;
+}
+
+
+/**
+ * @brief touches node and all its children, counts the children
+ */
+static gTree_status gTree_touchChildren(gTree *tree, size_t nodeId, size_t *cnt_out)
+{
+    GTREE_TOUCH(nodeId);
+    size_t cnt = 0;
+    for (size_t childId = GTREE_NODE_BY_ID(nodeId)->child; childId != -1; childId = GTREE_NODE_BY_ID(childId)->sibling) {
+        GTREE_TOUCH(childId);
+        ++cnt;
+    }
+    *cnt_out = cnt;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief appends children of the node to the saved order, so the ones moved by sorting could be reported
+ */
+static bool gTree_saveOrder(gTree *tree, size_t nodeId, size_t **order, size_t *cnt, size_t *cap)
+{
+    for (size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->child; childId != -1;
+                                            childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+        if (!gTree_growArray((void**)order, cap, *cnt + 1, sizeof(size_t)))
+            return false;
+        (*order)[(*cnt)++] = childId;
+    }
+    return true;
+}
+
+
+/**
+ * @brief reports children of the node that are not at their saved positions as moved
+ * @param pos position of the first child in the saved order, advanced past the last one
+ */
+static void gTree_reportOrder(gTree *tree, size_t nodeId, const size_t *order, size_t *pos)
+{
+    for (size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->child; childId != -1;
+                                            childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+        if (order[(*pos)++] != childId)
+            GTREE_EVENT(gTree_ev_Move, childId, nodeId, NULL);
+    }
+}
+
+
+/**
+ * @brief sorts children of the node with stable merge sort, O(k log k), children that changed places are reported as moved
+ * @param tree pointer to structure
+ * @param nodeId id of a node to sort children of
+ * @param cmp payload comparator
+ * @return gTree status code
+ */
+static gTree_status gTree_sortChildren(gTree *tree, size_t nodeId, gTree_CmpFunc cmp)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_SortChildren);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ASSERT_LOG(cmp != NULL,     gTree_status_BadData,      tree->logStream);
+    GTREE_ID_VAL(nodeId);
+
+    size_t *order = NULL;
+    size_t orderCnt = 0, orderCap = 0;
+    if (GTREE_OBSERVED() && !gTree_saveOrder(tree, nodeId, &order, &orderCnt, &orderCap)) {
+        free(order);
+        GTREE_ASSERT_LOG(false, gTree_status_AllocErr, tree->logStream);
+    }
+
+    size_t cnt = 0;
+    gTree_status status = gTree_touchChildren(tree, nodeId, &cnt);
+    if (status == gTree_status_OK) {
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+        GTREE_STORE_LINK(node->child, gTree_sortSiblings(tree, node->child, cnt, cmp, &node->tail));
+        size_t pos = 0;
+        if (order != NULL)
+            gTree_reportOrder(tree, nodeId, order, &pos);
+    }
+
+    free(order);
+    GTREE_IS_OK(status);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief state of parallel gTree_sortSubtree
+ */
+struct gTree_SortTask
+{
+    gTree *tree;
+    gTree_CmpFunc cmp;
+    size_t *nodes;              /// Ids of the nodes with children
+    size_t *counts;             /// Number of children of each of them
+    size_t nodeCnt;
+    size_t chunk;               /// Number of nodes per task
+} typedef gTree_SortTask;
+
+static void gTree_sortSubtreeTask(size_t task, void *arg)
+{
+    gTree_SortTask *st = (gTree_SortTask*)arg;
+    size_t end = (task + 1) * st->chunk;
+    if (end > st->nodeCnt)
+        end = st->nodeCnt;
+    for (size_t i = task * st->chunk; i < end; ++i) {
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&st->tree->pool, st->nodes[i]);
+        GTREE_STORE_LINK(node->child, gTree_sortSiblings(st->tree, node->child, st->counts[i], st->cmp, &node->tail));
+    }
+}
+
+
+/**
+ * @brief sorts children of every node of the subtree, children that changed places are reported as moved
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param cmp payload comparator
+ * @param nThreads number of threads to sort on (0 or 1 to sort in the calling thread)
+ * @return gTree status code
+ */
+static gTree_status gTree_sortSubtree(gTree *tree, size_t rootId, gTree_CmpFunc cmp, size_t nThreads)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_SortSubtree);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ASSERT_LOG(cmp != NULL,     gTree_status_BadData,      tree->logStream);
+    GTREE_ID_VAL(rootId);
+
+    /* all nodes are touched before sorting, so the sort itself writes only sibling links of disjoint lists */
+    gTree_SortTask st = {tree, cmp, NULL, NULL, 0, 0};
+    size_t nodeCap = 0, countCap = 0;
+    size_t *order = NULL;
+    size_t orderCnt = 0, orderCap = 0;
+    bool observed = GTREE_OBSERVED();
+    gTree_status status = gTree_status_OK;
+    for (size_t id = rootId; id != -1 && status == gTree_status_OK; id = gTree_nextPreorder(tree, rootId, id)) {
+        size_t cnt = 0;
+        status = gTree_touchChildren(tree, id, &cnt);
+        if (status != gTree_status_OK || cnt < 2)
+            continue;
+        if (!gTree_growArray((void**)&st.nodes,  &nodeCap,  st.nodeCnt + 1, sizeof(size_t)) ||
+            !gTree_growArray((void**)&st.counts, &countCap, st.nodeCnt + 1, sizeof(size_t)) ||
+            (observed && !gTree_saveOrder(tree, id, &order, &orderCnt, &orderCap))) {
+            status = gTree_status_AllocErr;
+            break;
+        }
+        st.nodes [st.nodeCnt] = id;
+        st.counts[st.nodeCnt] = cnt;
+        ++st.nodeCnt;
+    }
+
+    if (status == gTree_status_OK) {
+        st.chunk = 64;
+        if (!gTree_parallelFor(nThreads, (st.nodeCnt + st.chunk - 1) / st.chunk, gTree_sortSubtreeTask, &st))
+            status = gTree_status_AllocErr;
+    }
+    if (status == gTree_status_OK && observed)
+        for (size_t i = 0, pos = 0; i < st.nodeCnt; ++i)
+            gTree_reportOrder(tree, st.nodes[i], order, &pos);
+
+    free(st.nodes);
+    free(st.counts);
+    free(order);
+    GTREE_IS_OK(status);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief starts transaction, all following writes could be undone with gTree_rollback
+ * @param tree pointer to structure
+ * @return gTree status code
+ */
+static gTree_status gTree_beginTxn(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_BeginTxn);
+    GTREE_ASSERT_LOG(!tree->txnActive, gTree_status_BadTxn, tree->logStream);
+
+    gTree_clearUndo(tree);                  // leftovers of a commit or rollback that failed halfway
+    GTREE_TXN_EVENTS(false);
+    tree->txnActive = true;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief finishes transaction, reports its events to observers and frees nodes deleted in it
+ * @param tree pointer to structure
+ * @return gTree status code
+ */
+static gTree_status gTree_commit(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Commit);
+    GTREE_ASSERT_LOG(tree->txnActive, gTree_status_BadTxn, tree->logStream);
+
+    tree->txnActive = false;
+    GTREE_TXN_EVENTS(true);
+    for (size_t i = 0; i < tree->undoCnt; ++i) {
+        if (tree->undo[i].type == gTree_undo_Free) {
+            gTree_markLive(tree, tree->undo[i].id);
+            GTREE_IS_OK(gTree_freeNode(tree, tree->undo[i].id));
+        }
+    }
+    gTree_clearUndo(tree);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief undoes all writes of the transaction in O(changes) and frees nodes allocated in it
+ *        (observers never see its events, they are dropped)
+ * @param tree pointer to structure
+ * @return gTree status code
+ */
+static gTree_status gTree_rollback(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Rollback);
+    GTREE_ASSERT_LOG(tree->txnActive, gTree_status_BadTxn, tree->logStream);
+
+    tree->txnActive = false;
+    GTREE_TXN_EVENTS(false);
+    for (size_t i = 0; i < tree->undoCnt; ++i)
+        if (tree->undo[i].type == gTree_undo_Free)
+            gTree_markLive(tree, tree->undo[i].id);
+    for (size_t i = tree->undoCnt; i > 0; --i) {
+        gTree_UndoRec *rec = &tree->undo[i - 1];
+        if (rec->type != gTree_undo_Node)
+            continue;
+        GTREE_TOUCH(rec->id);
+        gTree_Node *node = GTREE_NODE_BY_ID(rec->id);
+        node->data    = rec->image.data;
+        GTREE_STORE_LINK(node->child, rec->image.child);
+        GTREE_STORE_LINK(node->parent, rec->image.parent);
+        GTREE_STORE_LINK(node->sibling, rec->image.sibling);
+        GTREE_STORE_LINK(node->tail, rec->image.tail);
+    }
+    for (size_t i = 0; i < tree->undoCnt; ++i)
+        if (tree->undo[i].type == gTree_undo_Alloc)
+            GTREE_IS_OK(gTree_freeNode(tree, tree->undo[i].id));
+    gTree_clearUndo(tree);
+
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief switches concurrent mode: read APIs, batches and gTree_addChild synchronize on the reader-writer lock of the tree,
+ *        other mutators must be called between gTree_writeLock and gTree_writeUnlock;
+ *        in the mode nodes are allocated from per-thread caches (disabling returns them to the pool and stops the reaper);
+ *        enable it before other threads touch the tree, disabling waits for the readers and appenders to leave
+ * @param tree pointer to structure
+ * @param concurrent whether to enable the mode
+ * @return gTree status code
+ */
+static gTree_status gTree_setConcurrent(gTree *tree, bool concurrent)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    if (concurrent && tree->mags == NULL) {
+        tree->mags = (gTree_Magazine*)calloc(GTREE_MAX_MAGAZINES, sizeof(gTree_Magazine));
+        GTREE_ASSERT_LOG(tree->mags != NULL, gTree_status_AllocErr, tree->logStream);
+    }
+    if (concurrent && !tree->concurrent) {
+        if (!tree->magKeyOn)
+            GTREE_ASSERT_LOG(pthread_key_create(&tree->magKey, gTree_magazineExit) == 0, gTree_status_AllocErr, tree->logStream);
+        tree->magKeyOn = true;
+        gTree_syncNodeCnt(tree);
+        __atomic_store_n(&tree->concurrent, true, __ATOMIC_RELEASE);
+    }
+    if (!concurrent) {
+        gTree_stopReaper(tree);
+        bool locked = gTree_writeEnter(tree);   // the caches are emptied once nobody appends from them
+        gTree_flushMagazines(tree);
+        __atomic_store_n(&tree->concurrent, false, __ATOMIC_RELEASE);
+        if (locked)
+            gTree_writeUnlock(tree);
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief thread-safe copy of the node (its data and links)
+ * @param tree pointer to structure
+ * @param nodeId id of a node to get
+ * @param[out] node_out ptr to copy node to
+ * @return gTree status code
+ */
+static gTree_status gTree_getNode(gTree *tree, size_t nodeId, gTree_Node *node_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),     gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_GetNode);
+    GTREE_ASSERT_LOG(gPtrValid(node_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    gTree_readLock(tree);
+    gTree_Node *node = NULL;
+    gObjPool_status status = gObjPool_get(&tree->pool, nodeId, &node);
+    if (status == gObjPool_status_OK)
+        *node_out = *node;
+    gTree_readUnlock(tree);
+
+    GTREE_CHECK_POOL_STATUS(status);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief thread-safe read of the node data
+ * @param tree pointer to structure
+ * @param nodeId id of a node to read
+ * @param[out] data_out ptr to write data to
+ * @return gTree status code
+ */
+static gTree_status gTree_getData(gTree *tree, size_t nodeId, GTREE_TYPE *data_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),     gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_GetData);
+    GTREE_ASSERT_LOG(gPtrValid(data_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    gTree_Node node;
+    GTREE_IS_OK(gTree_getNode(tree, nodeId, &node));
+    *data_out = node.data;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief user-provided traversal visitor
+ * @return false to stop the traversal
+ */
+typedef bool (*gTree_VisitFunc)(size_t id, const gTree_Node *node, void *arg);
+
+
+/**
+ * @brief thread-safe preorder traversal of the subtree, writers wait until it is finished
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param visit visitor to call for each node
+ * @param arg argument to forward to visitor
+ * @return gTree status code
+ */
+static gTree_status gTree_traverse(gTree *tree, size_t rootId, gTree_VisitFunc visit, void *arg)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Traverse);
+    GTREE_ASSERT_LOG(visit != NULL,   gTree_status_BadData,      tree->logStream);
+
+    gTree_readLock(tree);
+    bool valid = gObjPool_idValid(&tree->pool, rootId);
+    for (size_t id = rootId; valid && id != -1; id = gTree_nextPreorder(tree, rootId, id))
+        if (!visit(id, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id), arg))
+            break;
+    gTree_readUnlock(tree);
+
+    GTREE_ASSERT_LOG(valid, gTree_status_BadId, tree->logStream);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief switches epoch mode: readers traverse without locks between gTree_epochEnter and gTree_epochExit,
+ *        freed nodes are retired and reused only after the readers that could reach them leave;
+ *        writers must still be serialized (e.g. with gTree_writeLock)
+ * @param tree pointer to structure
+ * @param epochMode whether to enable the mode (disabling waits for active readers and frees all retired nodes)
+ * @return gTree status code
+ */
+static gTree_status gTree_setEpochMode(gTree *tree, bool epochMode)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(!tree->txnActive, gTree_status_BadTxn, tree->logStream);
+    if (epochMode == tree->epochMode)
+        return gTree_status_OK;
+
+    if (epochMode) {
+        if (tree->readers == NULL) {
+            tree->readers = (gTree_EpochSlot*)calloc(GTREE_MAX_READERS, sizeof(gTree_EpochSlot));
+            GTREE_ASSERT_LOG(tree->readers != NULL, gTree_status_AllocErr, tree->logStream);
+            for (size_t i = 0; i < GTREE_MAX_READERS; ++i)
+                tree->readers[i].epoch = -1;
+        }
+        gTree_syncNodeCnt(tree);
+        tree->epochMode = true;
+        return gTree_status_OK;
+    }
+
+    gTree_blockReaders(tree);
+    tree->epochMode = false;
+    __atomic_store_n(&tree->growing, false, __ATOMIC_SEQ_CST);
+    GTREE_IS_OK(gTree_reclaim(tree));
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief makes sure next `cnt` allocations do not reallocate the pool (in epoch mode reallocation waits for readers),
+ *        slots allocated by hand through gObjPool_alloc are counted too
+ * @param tree pointer to structure
+ * @param cnt number of nodes to reserve
+ * @return gTree status code
+ */
+static gTree_status gTree_reserve(gTree *tree, size_t cnt)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Reserve);
+
+    gTree_syncNodeCnt(tree);
+    if (tree->nodeCnt + cnt < tree->pool.capacity)
+        return gTree_status_OK;
+
+    /* the pool grows only when its free list is empty: the free slots are taken until it grows enough
+       (at most cnt + 1 of them) and given back in reverse, so the free list keeps its order */
+    size_t *ids = (size_t*)malloc((cnt + 1) * sizeof(size_t));
+    GTREE_ASSERT_LOG(ids != NULL, gTree_status_AllocErr, tree->logStream);
+    if (tree->epochMode)
+        gTree_blockReaders(tree);
+
+    gObjPool_status status = gObjPool_status_OK;
+    size_t allocated = 0;
+    while (tree->nodeCnt + cnt >= tree->pool.capacity && status == gObjPool_status_OK)
+        if ((status = gObjPool_alloc(&tree->pool, &ids[allocated])) == gObjPool_status_OK)
+            ++allocated;
+    while (allocated > 0)
+        gObjPool_free(&tree->pool, ids[--allocated]);
+
+    if (tree->epochMode)
+        __atomic_store_n(&tree->growing, false, __ATOMIC_SEQ_CST);
+    free(ids);
+    GTREE_CHECK_POOL_STATUS(status);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief enters lock-free reader section of the epoch mode, nodes seen inside are not released until gTree_epochExit
+ *        (nodes deleted meanwhile fail id checks, but their links and payloads stay readable)
+ * @param tree pointer to structure
+ * @param[out] slot_out ptr to write reader slot to, it must be passed to gTree_epochExit
+ * @return gTree status code
+ */
+static gTree_status gTree_epochEnter(gTree *tree, size_t *slot_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),     gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(gPtrValid(slot_out), gTree_status_BadOutPtr,    tree->logStream);
+    GTREE_ASSERT_LOG(tree->epochMode,     gTree_status_BadMode,      tree->logStream);
+
+    for (;;) {
+        size_t epoch = __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST);
+        size_t slot = 0;
+        size_t freeSlot = -1;
+        while (slot < GTREE_MAX_READERS && !__atomic_compare_exchange_n(&tree->readers[slot].epoch, &freeSlot, epoch,
+                                                                false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            freeSlot = -1;
+            ++slot;
+        }
+        GTREE_ASSERT_LOG(slot < GTREE_MAX_READERS, gTree_status_BadCapacity, tree->logStream);
+
+        if (!__atomic_load_n(&tree->growing, __ATOMIC_SEQ_CST)) {
+            *slot_out = slot;
+            return gTree_status_OK;
+        }
+        __atomic_store_n(&tree->readers[slot].epoch, (size_t)-1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&tree->growing, __ATOMIC_SEQ_CST))
+            sched_yield();
+    }
+}
+
+
+/**
+ * @brief leaves reader section of the epoch mode
+ * @param tree pointer to structure
+ * @param slot reader slot returned by gTree_epochEnter
+ * @return gTree status code
+ */
+static gTree_status gTree_epochExit(gTree *tree, size_t slot)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(tree->epochMode && slot < GTREE_MAX_READERS, gTree_status_BadPos, tree->logStream);
+
+    __atomic_store_n(&tree->readers[slot].epoch, (size_t)-1, __ATOMIC_SEQ_CST);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief lock-free preorder traversal of the subtree in epoch mode, writers do not wait for it;
+ *        nodes moved concurrently could be skipped or visited twice, nodes deleted concurrently could still be visited,
+ *        but no visited slot is released or reused before the traversal ends
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param visit visitor to call for each node
+ * @param arg argument to forward to visitor
+ * @return gTree status code
+ */
+static gTree_status gTree_epochTraverse(gTree *tree, size_t rootId, gTree_VisitFunc visit, void *arg)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_EpochTraverse);
+    GTREE_ASSERT_LOG(visit != NULL,   gTree_status_BadData,      tree->logStream);
+
+    size_t slot = -1;
+    GTREE_IS_OK(gTree_epochEnter(tree, &slot));
+    bool valid = rootId < tree->pool.capacity &&
+                 __atomic_load_n(&GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, rootId)->allocated, __ATOMIC_ACQUIRE);
+    size_t id = valid ? rootId : -1;
+    while (id != -1) {
+        const gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+        if (!visit(id, node, arg))
+            break;
+        size_t next = __atomic_load_n(&node->child, __ATOMIC_ACQUIRE);
+        while (next == -1 && id != rootId && id != -1) {
+            node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+            next = __atomic_load_n(&node->sibling, __ATOMIC_ACQUIRE);
+            if (next == -1)
+                id = __atomic_load_n(&node->parent, __ATOMIC_ACQUIRE);
+        }
+        id = next;
+    }
+    gTree_epochExit(tree, slot);
+
+    GTREE_ASSERT_LOG(valid, gTree_status_BadId, tree->logStream);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief unlinks node from its parent and siblings (the node keeps its subtree)
+ * @param tree pointer to structure
+ * @param nodeId id of a node to unlink
+ * @return gTree status code
+ */
+static gTree_status gTree_unlinkNode(gTree *tree, size_t nodeId)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_UnlinkNode);
+    GTREE_ID_VAL(nodeId);
+
+    if (GTREE_NODE_BY_ID(nodeId)->parent == -1)
+        return gTree_status_OK;
+
+    GTREE_IS_OK(gTree_unlinkFrom(tree, nodeId));
+    GTREE_EVENT(gTree_ev_Move, nodeId, -1, NULL);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief batch operation types
+ */
+enum gTree_OpType
+{
+    gTree_op_AddChild,          /// Add child with `data` to `node`
+    gTree_op_AddSibling,        /// Add sibling with `data` after the last sibling of `node`
+    gTree_op_DelChild,          /// Delete child number `arg` of `node` (its children are lifted)
+    gTree_op_DelSubtree,        /// Delete subtree of `node`
+    gTree_op_Move,              /// Move subtree of `node` to be the last child of `arg`
+    gTree_op_SetData,           /// Write `data` to `node`
+    gTree_op_Cnt,
+} typedef gTree_OpType;
+
+
+/**
+ * @brief single operation of gTree_applyBatch, ids could reference results of earlier ops with GTREE_OP_REF
+ */
+struct gTree_Op
+{
+    gTree_OpType type;
+    size_t node;
+    size_t arg;
+    GTREE_TYPE data;
+} typedef gTree_Op;
+
+
+/**
+ * @brief result of a single batch operation
+ */
+struct gTree_OpResult
+{
+    gTree_status status;
+    size_t id;                  /// Id of the added node for add ops, -1 otherwise
+} typedef gTree_OpResult;
+
+
+/**
+ * @brief Macro to reference id added by batch operation number k from the later operations
+ */
+static const size_t GTREE_OP_REF_BIT = (size_t)1 << (sizeof(size_t) * 8 - 1);
+#define GTREE_OP_REF(k) (GTREE_OP_REF_BIT | (size_t)(k))
+
+
+/**
+ * @brief resolves batch operation id argument
+ * @return node id or -1 if it is invalid
+ */
+static size_t gTree_batchId(const gTree *tree, const gTree_OpResult *results, size_t opIdx, size_t id)
+{
+    if (id & GTREE_OP_REF_BIT) {
+        size_t ref = id & ~GTREE_OP_REF_BIT;
+        if (ref >= opIdx || results[ref].status != gTree_status_OK)
+            return -1;
+        id = results[ref].id;
+    }
+    if (id == -1 || !gObjPool_idValid(&tree->pool, id))
+        return -1;
+    return id;
+}
+
+
+/**
+ * @brief gTree_applyBatch body, called with the write lock held in the concurrent mode
+ */
+static gTree_status gTree_applyBatchLocked(gTree *tree, const gTree_Op *ops, size_t opCnt, gTree_OpResult *results)
+{
+    size_t addCnt = 0;
+    for (size_t i = 0; i < opCnt; ++i) {
+        const gTree_Op *op = &ops[i];
+        results[i].id = -1;
+        results[i].status = gTree_status_OK;
+
+        bool refOk = !(op->node & GTREE_OP_REF_BIT) || ((op->node & ~GTREE_OP_REF_BIT) < i);
+        if (op->type == gTree_op_Move)
+            refOk = refOk && (!(op->arg & GTREE_OP_REF_BIT) || ((op->arg & ~GTREE_OP_REF_BIT) < i));
+        if (op->type < 0 || op->type >= gTree_op_Cnt)
+            results[i].status = gTree_status_BadData;
+        else if (!refOk || (!(op->node & GTREE_OP_REF_BIT) && !gObjPool_idValid(&tree->pool, op->node)))
+            results[i].status = gTree_status_BadId;
+        else if (op->type == gTree_op_Move && !(op->arg & GTREE_OP_REF_BIT) && !gObjPool_idValid(&tree->pool, op->arg))
+            results[i].status = gTree_status_BadId;
+        else if (op->type == gTree_op_AddChild || op->type == gTree_op_AddSibling)
+            ++addCnt;
+    }
+
+    size_t *reserved = NULL;
+    if (addCnt != 0) {
+        reserved = (size_t*)malloc(addCnt * sizeof(size_t));
+        GTREE_ASSERT_LOG(reserved != NULL, gTree_status_AllocErr, tree->logStream);
+    }
+    size_t reservedCnt = 0;
+    gTree_status status = gTree_status_OK;
+    while (reservedCnt < addCnt && status == gTree_status_OK)
+        status = gTree_allocNode(tree, &reserved[reservedCnt++]);
+    if (status != gTree_status_OK) {
+        for (size_t i = 0; i + 1 < reservedCnt; ++i)
+            gTree_freeNode(tree, reserved[i]);
+        free(reserved);
+        GTREE_ASSERT_LOG(false, status, tree->logStream);
+    }
+
+    size_t used = 0;
+    for (size_t i = 0; i < opCnt; ++i) {
+        const gTree_Op *op = &ops[i];
+        gTree_OpResult *res = &results[i];
+        if (res->status != gTree_status_OK)
+            continue;
+
+        size_t nodeId = gTree_batchId(tree, results, i, op->node);
+        if (nodeId == -1) {
+            res->status = gTree_status_BadId;
+            continue;
+        }
+
+        /* ids are valid here, so ops go through the unchecked link helpers */
+        switch (op->type) {
+            case gTree_op_AddChild:
+            case gTree_op_AddSibling: {
+                size_t childId  = reserved[used];    // taken only if linked, the unused ones are freed below
+                size_t parentId = (op->type == gTree_op_AddChild) ? nodeId : GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->parent;
+                GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->data = op->data;
+                if (parentId != -1) {
+                    res->status = gTree_linkLast(tree, parentId, childId);
+                } else {
+                    while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->sibling != -1)
+                        nodeId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->sibling;
+                    res->status = gTree_touchNode(tree, nodeId);
+                    if (res->status == gTree_status_OK)
+                        GTREE_STORE_LINK(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->sibling, childId);
+                }
+                if (res->status == gTree_status_OK) {
+                    res->id = childId;
+                    ++used;
+                    GTREE_EVENT(gTree_ev_Insert, childId, parentId, NULL);
+                }
+                break;
+            }
+            case gTree_op_DelChild: {
+                size_t prevId  = -1;
+                size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->child;
+                for (size_t pos = 0; pos < op->arg && childId != -1; ++pos) {
+                    prevId  = childId;
+                    childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling;
+                }
+                GTREE_COUNT(siblingHops, op->arg);
+                res->status = (childId == -1) ? gTree_status_BadPos : gTree_liftChild(tree, nodeId, prevId, childId, NULL);
+                break;
+            }
+            case gTree_op_DelSubtree:
+                res->status = gTree_cutSubtree(tree, nodeId);
+                break;
+            case gTree_op_Move: {
+                size_t parentId = gTree_batchId(tree, results, i, op->arg);
+                size_t ancestorId = parentId;
+                while (ancestorId != -1 && ancestorId != nodeId)
+                    ancestorId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ancestorId)->parent;
+                if (parentId == -1 || ancestorId == nodeId) {
+                    res->status = gTree_status_BadId;
+                    break;
+                }
+                res->status = gTree_unlinkFrom(tree, nodeId);
+                if (res->status == gTree_status_OK)
+                    res->status = gTree_linkLast(tree, parentId, nodeId);
+                if (res->status == gTree_status_OK)
+                    GTREE_EVENT(gTree_ev_Move, nodeId, parentId, NULL);
+                break;
+            }
+            case gTree_op_SetData:
+                res->status = gTree_touchNode(tree, nodeId);
+                if (res->status == gTree_status_OK) {
+                    GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->data = op->data;
+                    GTREE_EVENT(gTree_ev_Update, nodeId, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId)->parent, NULL);
+                }
+                break;
+            case gTree_op_Cnt:
+            default:
+                res->status = gTree_status_BadData;
+        }
+    }
+
+    for (; used < reservedCnt; ++used)
+        GTREE_IS_OK(gTree_freeNode(tree, reserved[used]));
+    free(reserved);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief applies array of operations: validates them all up front, reserves nodes once and applies them in one loop
+ * @param tree pointer to structure
+ * @param ops operations to apply
+ * @param opCnt number of operations
+ * @param[out] results array of opCnt elements to write per-operation statuses and added ids to
+ * @return gTree status code (operation failures are reported in results only)
+ */
+static gTree_status gTree_applyBatch(gTree *tree, const gTree_Op *ops, size_t opCnt, gTree_OpResult *results)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),    gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_ApplyBatch);
+    GTREE_ASSERT_LOG(gPtrValid(ops),     gTree_status_BadData,      tree->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(results), gTree_status_BadOutPtr,    tree->logStream);
+    GTREE_OBSERVE_SCOPE();
+
+    bool locked = gTree_writeEnter(tree);
+    gTree_status status = gTree_applyBatchLocked(tree, ops, opCnt, results);
+    if (locked)
+        gTree_writeUnlock(tree);
+    return status;
+}
+
+
+/**
+ * @brief subtree root waiting to be walked with the tag its parent gave it (e.g. a dense index)
+ */
+struct gTree_WsItem
+{
+    size_t id;
+    size_t tag;
+} typedef gTree_WsItem;
+
+
+/**
+ * @brief per-worker deque of subtree roots, the owner takes the newest ones and thieves take the oldest (largest) ones
+ */
+struct gTree_WsDeque
+{
+    pthread_mutex_t lock;
+    gTree_WsItem *items;
+    size_t head;                /// Items are stored in [head, cnt)
+    size_t cnt;
+    size_t cap;
+} typedef gTree_WsDeque;
+
+
+/**
+ * @brief state of a work-stealing subtree walk shared by the workers
+ */
+struct gTree_WorkPool
+{
+    gTree *tree;
+    size_t rootId;
+    size_t grain;               /// Number of nodes a worker visits between offers to share its work
+    size_t nThreads;
+    gTree_WsDeque *deques;
+    size_t outstanding;         /// Number of shared subtrees not finished yet (atomic)
+    size_t nextWorker;          /// Worker index dispenser (atomic)
+    bool stop;                  /// Set to stop all workers (atomic)
+    bool failed;                /// Set on allocation failure (atomic)
+    bool (*visit)(struct gTree_WorkPool *wp, size_t id, size_t tag, size_t *childTag_out);   /// Called for every node, false stops
+                                                        /// the walk; children are tagged *childTag_out, *childTag_out + 1, ...
+    void (*post)(struct gTree_WorkPool *wp, size_t id, size_t tag, size_t childCnt);   /// Called after the children are queued
+                                                                                        /// (could be NULL)
+    void *ctx;
+} typedef gTree_WorkPool;
+
+
+/**
+ * @brief takes subtree root from own deque or steals the oldest one from others
+ * @return false if all deques are empty
+ */
+static bool gTree_wsTake(gTree_WorkPool *wp, size_t self, gTree_WsItem *item_out)
+{
+    for (size_t k = 0; k < wp->nThreads; ++k) {
+        gTree_WsDeque *dq = &wp->deques[(self + k) % wp->nThreads];
+        pthread_mutex_lock(&dq->lock);
+        bool found = (dq->head != dq->cnt);
+        if (found)
+            *item_out = (k == 0) ? dq->items[--dq->cnt] : dq->items[dq->head++];
+        if (dq->head == dq->cnt)
+            dq->head = dq->cnt = 0;
+        pthread_mutex_unlock(&dq->lock);
+        if (found)
+            return true;
+    }
+    return false;
+}
+
+
+/**
+ * @brief moves the oldest half of the private stack to own deque if it was drained by thieves
+ */
+static void gTree_wsShare(gTree_WorkPool *wp, gTree_WsDeque *dq, gTree_WsItem *stack, size_t *stackCnt)
+{
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head == dq->cnt) {
+        size_t half = *stackCnt / 2;
+        if (gTree_growArray((void**)&dq->items, &dq->cap, dq->cnt + half, sizeof(gTree_WsItem))) {
+            __atomic_add_fetch(&wp->outstanding, half, __ATOMIC_RELEASE);
+            memcpy(dq->items + dq->cnt, stack, half * sizeof(gTree_WsItem));
+            dq->cnt += half;
+            *stackCnt -= half;
+            memmove(stack, stack + half, *stackCnt * sizeof(gTree_WsItem));
+        }
+    }
+    pthread_mutex_unlock(&dq->lock);
+}
+
+
+static void *gTree_wsWorker(void *state)
+{
+    gTree_WorkPool *wp = (gTree_WorkPool*)state;
+    gTree *tree = wp->tree;
+    size_t self = __atomic_fetch_add(&wp->nextWorker, 1, __ATOMIC_RELAXED);
+    gTree_WsItem *stack = NULL;
+    size_t stackCnt = 0, stackCap = 0;
+
+    for (;;) {
+        gTree_WsItem item = {(size_t)-1, 0};
+        if (!gTree_wsTake(wp, self, &item)) {
+            if (__atomic_load_n(&wp->outstanding, __ATOMIC_ACQUIRE) == 0 || __atomic_load_n(&wp->stop, __ATOMIC_RELAXED))
+                break;
+            sched_yield();
+            continue;
+        }
+
+        stackCnt = 0;
+        bool ok = gTree_growArray((void**)&stack, &stackCap, 1, sizeof(gTree_WsItem));
+        if (ok)
+            stack[stackCnt++] = item;
+        size_t visited = 0;
+        while (ok && stackCnt != 0 && !__atomic_load_n(&wp->stop, __ATOMIC_RELAXED)) {
+            gTree_WsItem cur = stack[--stackCnt];
+            size_t childTag = 0;
+            if (!wp->visit(wp, cur.id, cur.tag, &childTag)) {
+                __atomic_store_n(&wp->stop, true, __ATOMIC_RELAXED);
+                break;
+            }
+            size_t childCnt = 0;
+            for (size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, cur.id)->child; ok && childId != -1;
+                                                    childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+                ok = gTree_growArray((void**)&stack, &stackCap, stackCnt + 1, sizeof(gTree_WsItem));
+                if (ok) {
+                    stack[stackCnt].id    = childId;
+                    stack[stackCnt++].tag = childTag + childCnt;
+                    ++childCnt;
+                }
+            }
+            if (!ok)
+                break;
+            if (wp->post != NULL)
+                wp->post(wp, cur.id, cur.tag, childCnt);
+            if (++visited >= wp->grain && stackCnt > 1) {
+                visited = 0;
+                gTree_wsShare(wp, &wp->deques[self], stack, &stackCnt);
+            }
+        }
+        if (!ok) {
+            __atomic_store_n(&wp->failed, true, __ATOMIC_RELAXED);
+            __atomic_store_n(&wp->stop,   true, __ATOMIC_RELAXED);
+        }
+        __atomic_sub_fetch(&wp->outstanding, 1, __ATOMIC_ACQ_REL);
+    }
+
+    free(stack);
+    return NULL;
+}
+
+
+/**
+ * @brief walks subtree of wp->rootId on nThreads work-stealing workers (the calling thread included)
+ * @param wp walk state with tree, rootId, grain, visit, post and ctx filled
+ * @param nThreads number of threads to use (0 or 1 means walk in the calling thread)
+ * @return gTree status code
+ */
+static gTree_status gTree_wsRun(gTree_WorkPool *wp, size_t nThreads)
+{
+    gTree *tree = wp->tree;
+    if (nThreads == 0)
+        nThreads = 1;
+    if (wp->grain == 0)
+        wp->grain = 1024;
+    wp->nThreads    = nThreads;
+    wp->outstanding = 1;
+    wp->nextWorker  = 0;
+    wp->stop        = false;
+    wp->failed      = false;
+    wp->deques = (gTree_WsDeque*)calloc(nThreads, sizeof(gTree_WsDeque));
+    GTREE_ASSERT_LOG(wp->deques != NULL, gTree_status_AllocErr, tree->logStream);
+    for (size_t i = 0; i < nThreads; ++i)
+        pthread_mutex_init(&wp->deques[i].lock, NULL);
+
+    if (gTree_growArray((void**)&wp->deques[0].items, &wp->deques[0].cap, 1, sizeof(gTree_WsItem))) {
+        wp->deques[0].items[wp->deques[0].cnt].id    = wp->rootId;
+        wp->deques[0].items[wp->deques[0].cnt++].tag = 0;
+        pthread_t *threads = (pthread_t*)calloc(nThreads, sizeof(pthread_t));
+        size_t started = 0;
+        while (threads != NULL && started + 1 < nThreads && pthread_create(&threads[started], NULL, gTree_wsWorker, wp) == 0)
+            ++started;
+        gTree_wsWorker(wp);
+        for (size_t i = 0; i < started; ++i)
+            pthread_join(threads[i], NULL);
+        free(threads);
+    } else {
+        wp->failed = true;
+    }
+
+    for (size_t i = 0; i < nThreads; ++i) {
+        pthread_mutex_destroy(&wp->deques[i].lock);
+        free(wp->deques[i].items);
+    }
+    free(wp->deques);
+    wp->deques = NULL;
+    GTREE_ASSERT_LOG(!wp->failed, gTree_status_AllocErr, tree->logStream);
+    return gTree_status_OK;
+}
+
+
+static bool gTree_forEachVisit(gTree_WorkPool *wp, size_t id, size_t, size_t *)
+{
+    void **ctx = (void**)wp->ctx;
+    return ((gTree_VisitFunc)ctx[0])(id, GOBJPOOL_VAL_BY_ID_UNSAFE(&wp->tree->pool, id), ctx[1]);
+}
+
+
+/**
+ * @brief visits every node of the subtree in parallel (in no particular order), writers wait until it is finished
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param visit visitor to call for each node, could be called from several threads at once (false stops the walk)
+ * @param arg argument to forward to visitor
+ * @param nThreads number of threads to use
+ * @param grain number of nodes a worker visits before offering to share the rest (0 for default)
+ * @return gTree status code
+ */
+static gTree_status gTree_parallelForEach(gTree *tree, size_t rootId, gTree_VisitFunc visit, void *arg, size_t nThreads, size_t grain)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_ParallelForEach);
+    GTREE_ASSERT_LOG(visit != NULL,   gTree_status_BadData,      tree->logStream);
+
+    gTree_readLock(tree);
+    gTree_status status = gTree_status_BadId;
+    if (gObjPool_idValid(&tree->pool, rootId)) {
+        void *ctx[2] = {(void*)visit, arg};
+        gTree_WorkPool wp = {};
+        wp.tree   = tree;
+        wp.rootId = rootId;
+        wp.grain  = grain;
+        wp.visit  = gTree_forEachVisit;
+        wp.ctx    = ctx;
+        status = gTree_wsRun(&wp, nThreads);
+    }
+    gTree_readUnlock(tree);
+
+    GTREE_IS_OK(status);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief user-provided reduction callbacks
+ * @param id id of a node to map
+ * @param node node to map
+ * @param[out] out value buffer to write the node value to
+ * @param acc accumulator to combine value into
+ * @param arg user argument
+ */
+typedef void (*gTree_MapFunc)    (size_t id, const gTree_Node *node, void *out, void *arg);
+typedef void (*gTree_CombineFunc)(void *acc, const void *value, void *arg);
+
+
+#ifndef GTREE_SEG_BASE
+#define GTREE_SEG_BASE 256      /// Records in the first segment of a reduction, each next one is twice larger
+#endif
+#define GTREE_SEG_CNT 48
+
+
+/**
+ * @brief per-node record of gTree_parallelReduce, the value follows it
+ */
+struct gTree_ReduceRec
+{
+    size_t parent;              /// Dense index of the parent
+    size_t childBase;           /// Dense index of the first child, the rest follow in sibling order
+    size_t pending;             /// Number of children not reduced yet (atomic)
+} typedef gTree_ReduceRec;
+
+
+/**
+ * @brief state of gTree_parallelReduce: records are indexed by a dense rank given to the children when their parent
+ *        is visited, so memory is proportional to the subtree, not to the pool
+ */
+struct gTree_ReduceCtx
+{
+    size_t valueSize;
+    size_t recSize;             /// Record with its value, rounded up to the word size
+    gTree_MapFunc map;
+    gTree_CombineFunc combine;
+    void *arg;
+    size_t nextIdx;             /// Dense index dispenser, the root has 0 (atomic)
+    char *segs[GTREE_SEG_CNT];  /// Segment k holds GTREE_SEG_BASE << k records (installed atomically)
+} typedef gTree_ReduceCtx;
+
+
+static gTree_ReduceRec *gTree_reduceRec(gTree_ReduceCtx *rc, size_t idx)
+{
+    size_t k = 63 - __builtin_clzll(idx / GTREE_SEG_BASE + 1);
+    size_t first = GTREE_SEG_BASE * (((size_t)1 << k) - 1);
+    return (gTree_ReduceRec*)(__atomic_load_n(&rc->segs[k], __ATOMIC_ACQUIRE) + (idx - first) * rc->recSize);
+}
+
+static char *gTree_reduceVal(gTree_ReduceRec *rec)
+{
+    return (char*)(rec + 1);
+}
+
+
+/**
+ * @brief makes sure records with indices below end have their segments
+ * @return false on allocation failure
+ */
+static bool gTree_reduceReserve(gTree_ReduceCtx *rc, size_t begin, size_t end)
+{
+    size_t last = 63 - __builtin_clzll((end - 1) / GTREE_SEG_BASE + 1);
+    for (size_t k = 63 - __builtin_clzll(begin / GTREE_SEG_BASE + 1); k <= last; ++k) {
+        if (__atomic_load_n(&rc->segs[k], __ATOMIC_ACQUIRE) != NULL)
+            continue;
+        char *seg = (char*)malloc(((size_t)GTREE_SEG_BASE << k) * rc->recSize);
+        if (seg == NULL)
+            return false;
+        char *expected = NULL;
+        if (!__atomic_compare_exchange_n(&rc->segs[k], &expected, seg, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            free(seg);
+    }
+    return true;
+}
+
+
+static void gTree_reduceFree(gTree_ReduceCtx *rc)
+{
+    for (size_t k = 0; k < GTREE_SEG_CNT; ++k) {
+        free(rc->segs[k]);
+        rc->segs[k] = NULL;
+    }
+}
+
+
+/**
+ * @brief maps the node and gives dense indices to its children
+ */
+static bool gTree_reduceVisit(gTree_WorkPool *wp, size_t id, size_t tag, size_t *childTag_out)
+{
+    gTree_ReduceCtx *rc = (gTree_ReduceCtx*)wp->ctx;
+    gTree *tree = wp->tree;
+    const gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    gTree_ReduceRec *rec = gTree_reduceRec(rc, tag);
+
+    size_t childCnt = 0;
+    for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling)
+        ++childCnt;
+    rec->childBase = -1;
+    if (childCnt != 0) {
+        size_t base = __atomic_fetch_add(&rc->nextIdx, childCnt, __ATOMIC_RELAXED);
+        if (!gTree_reduceReserve(rc, base, base + childCnt)) {
+            __atomic_store_n(&wp->failed, true, __ATOMIC_RELAXED);
+            return false;
+        }
+        for (size_t i = 0; i < childCnt; ++i)
+            gTree_reduceRec(rc, base + i)->parent = tag;
+        rec->childBase = base;
+        *childTag_out  = base;
+    }
+    rc->map(id, node, gTree_reduceVal(rec), rc->arg);
+    return true;
+}
+
+
+/**
+ * @brief folds children values into the node value once all of them are ready, goes up while parents get ready too
+ */
+static void gTree_reducePost(gTree_WorkPool *wp, size_t id, size_t tag, size_t childCnt)
+{
+    gTree_ReduceCtx *rc = (gTree_ReduceCtx*)wp->ctx;
+    gTree *tree = wp->tree;
+    gTree_ReduceRec *rec = gTree_reduceRec(rc, tag);
+    if (childCnt != 0) {
+        __atomic_store_n(&rec->pending, childCnt, __ATOMIC_RELEASE);
+        return;
+    }
+
+    for (;;) {
+        char *acc = gTree_reduceVal(rec);
+        size_t childIdx = rec->childBase;
+        for (size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->child; childId != -1;
+                                                    childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling)
+            rc->combine(acc, gTree_reduceVal(gTree_reduceRec(rc, childIdx++)), rc->arg);
+        if (id == wp->rootId)
+            return;
+        id  = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->parent;
+        rec = gTree_reduceRec(rc, rec->parent);
+        if (__atomic_sub_fetch(&rec->pending, 1, __ATOMIC_ACQ_REL) != 0)
+            return;
+    }
+}
+
+
+/**
+ * @brief computes reduced value of every node of the subtree in parallel (no locking)
+ * @param[out] rc records with the values by dense index, the root has 0 (must be freed with gTree_reduceFree)
+ * @return gTree status code
+ */
+static gTree_status gTree_reduceAll(gTree *tree, size_t rootId, size_t valueSize, gTree_MapFunc map, gTree_CombineFunc combine,
+                                                            void *arg, size_t nThreads, size_t grain, gTree_ReduceCtx *rc)
+{
+    GTREE_ID_VAL(rootId);
+    memset(rc, 0, sizeof(gTree_ReduceCtx));
+    rc->valueSize = valueSize;
+    rc->recSize   = (sizeof(gTree_ReduceRec) + valueSize + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+    rc->map       = map;
+    rc->combine   = combine;
+    rc->arg       = arg;
+    rc->nextIdx   = 1;
+    gTree_status status = gTree_status_AllocErr;
+    if (gTree_reduceReserve(rc, 0, 1)) {
+        gTree_WorkPool wp = {};
+        wp.tree   = tree;
+        wp.rootId = rootId;
+        wp.grain  = grain;
+        wp.visit  = gTree_reduceVisit;
+        wp.post   = gTree_reducePost;
+        wp.ctx    = rc;
+        status = gTree_wsRun(&wp, nThreads);
+    }
+    if (status != gTree_status_OK) {
+        gTree_reduceFree(rc);
+        GTREE_ASSERT_LOG(false, status, tree->logStream);
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief reduces subtree in parallel: value(v) = combine(...combine(map(v), value(child_1))..., value(child_k));
+ *        children are always folded in their order, so the result does not depend on nThreads and grain
+ *        even if combine is not associative
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root
+ * @param valueSize size of a reduced value in bytes
+ * @param map writes value of a single node, could be called from several threads at once
+ * @param combine combines value into accumulator, could be called from several threads at once
+ * @param arg argument to forward to map and combine
+ * @param[out] result_out buffer of valueSize bytes to write value(rootId) to
+ * @param nThreads number of threads to use
+ * @param grain number of nodes a worker visits before offering to share the rest (0 for default)
+ * @return gTree status code
+ */
+static gTree_status gTree_parallelReduce(gTree *tree, size_t rootId, size_t valueSize, gTree_MapFunc map, gTree_CombineFunc combine,
+                                                            void *arg, void *result_out, size_t nThreads, size_t grain)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),       gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_ParallelReduce);
+    GTREE_ASSERT_LOG(map != NULL && combine != NULL && valueSize != 0, gTree_status_BadData, tree->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(result_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    gTree_readLock(tree);
+    gTree_ReduceCtx rc;
+    gTree_status status = gTree_reduceAll(tree, rootId, valueSize, map, combine, arg, nThreads, grain, &rc);
+    if (status == gTree_status_OK) {
+        memcpy(result_out, gTree_reduceVal(gTree_reduceRec(&rc, 0)), valueSize);
+        gTree_reduceFree(&rc);
+    }
+    gTree_readUnlock(tree);
+
+    GTREE_IS_OK(status);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief reduced value of parallel gTree_cloneSubtree
+ */
+struct gTree_CloneVal
+{
+    size_t size;                /// Subtree size
+    size_t rank;                /// Preorder rank inside the cloned subtree, given by the parent during the copy
+} typedef gTree_CloneVal;
+
+
+static void gTree_sizeMap(size_t, const gTree_Node *, void *out, void *)
+{
+    ((gTree_CloneVal*)out)->size = 1;
+}
+
+static void gTree_sizeCombine(void *acc, const void *value, void *)
+{
+    ((gTree_CloneVal*)acc)->size += ((const gTree_CloneVal*)value)->size;
+}
+
+
+/**
+ * @brief state of parallel gTree_cloneSubtree, the walk is tagged with the dense indices of the size reduction
+ */
+struct gTree_CloneCtx
+{
+    gTree_ReduceCtx *sizes;     /// Subtree sizes and ranks by dense index
+    const size_t *ids;          /// Destination node ids indexed by preorder rank
+} typedef gTree_CloneCtx;
+
+
+/**
+ * @brief copies the node to its destination slot, gives ranks to its children and links them to the copy
+ */
+static bool gTree_cloneVisit(gTree_WorkPool *wp, size_t id, size_t tag, size_t *childTag_out)
+{
+    gTree_CloneCtx *cc = (gTree_CloneCtx*)wp->ctx;
+    gTree *tree = wp->tree;
+    const gTree_Node *src = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    gTree_ReduceRec *rec = gTree_reduceRec(cc->sizes, tag);
+    const gTree_CloneVal *val = (const gTree_CloneVal*)gTree_reduceVal(rec);
+    size_t rank = val->rank;
+    gTree_Node *dst = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, cc->ids[rank]);
+
+    dst->data    = src->data;
+    if (id == wp->rootId)
+        dst->parent = -1;                       // the others are linked by their parents
+    dst->sibling = (id == wp->rootId || src->sibling == -1) ? -1 : cc->ids[rank + val->size];
+    dst->child   = (src->child == -1) ? -1 : cc->ids[rank + 1];
+    dst->tail    = -1;
+    size_t childRank = rank + 1;
+    size_t childIdx  = rec->childBase;
+    for (size_t childId = src->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+        gTree_CloneVal *childVal = (gTree_CloneVal*)gTree_reduceVal(gTree_reduceRec(cc->sizes, childIdx++));
+        childVal->rank = childRank;
+        GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, cc->ids[childRank])->parent = cc->ids[rank];
+        dst->tail = cc->ids[childRank];
+        childRank += childVal->size;
+    }
+    *childTag_out = rec->childBase;
+    return true;
+}
+
+
+static int gTree_idCmp(const void *first, const void *second)
+{
+    size_t a = *(const size_t*)first, b = *(const size_t*)second;
+    return (a > b) - (a < b);
+}
+
+
+/**
+ * @brief sorts reserved slot ids, so the clone is laid out in ascending memory order
+ */
+static void gTree_sortIds(gTree *tree, size_t *ids, size_t cnt)
+{
+    if (cnt == 0)
+        return;
+    char *marks = (cnt * 8 >= tree->pool.capacity) ? (char*)calloc(tree->pool.capacity, 1) : NULL;
+    if (marks == NULL) {
+        qsort(ids, cnt, sizeof(size_t), gTree_idCmp);
+        return;
+    }
+    for (size_t i = 0; i < cnt; ++i)
+        marks[ids[i]] = 1;
+    for (size_t id = 0, i = 0; id < tree->pool.capacity; ++id)
+        if (marks[id])
+            ids[i++] = id;
+    free(marks);
+}
+
+
+/**
+ * @brief copies the subtree into slots given in preorder, walking the source and the copy side by side
+ *        (the copy is climbed by its own parent links, so no memory beyond the slot ids is needed)
+ */
+static void gTree_cloneWalk(gTree *tree, size_t rootId, const size_t *ids)
+{
+    size_t rank  = 0;
+    size_t srcId = rootId;
+    size_t dstId = ids[rank++];
+    gTree_Node *dst = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, dstId);
+    dst->parent = dst->sibling = -1;
+    for (;;) {
+        const gTree_Node *src = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, srcId);
+        dst->data  = src->data;
+        dst->child = dst->tail = -1;
+        if (src->child != -1) {
+            size_t childId = ids[rank++];
+            gTree_Node *child = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId);
+            dst->child = dst->tail = childId;
+            child->parent  = dstId;
+            child->sibling = -1;
+            srcId = src->child;
+            dstId = childId;
+            dst   = child;
+            continue;
+        }
+        while (srcId != rootId && GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, srcId)->sibling == -1) {
+            srcId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, srcId)->parent;
+            dstId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, dstId)->parent;
+        }
+        if (srcId == rootId)
+            return;
+        size_t parentId  = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, dstId)->parent;
+        size_t siblingId = ids[rank++];
+        gTree_Node *sibling = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, siblingId);
+        GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, dstId)->sibling  = siblingId;
+        GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, parentId)->tail  = siblingId;
+        sibling->parent  = parentId;
+        sibling->sibling = -1;
+        srcId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, srcId)->sibling;
+        dstId = siblingId;
+        dst   = sibling;
+    }
+}
+
+
+/**
+ * @brief clones subtree by a node in parallel: counts subtree sizes, reserves exact number of slots
+ *        and copies every child subtree into its own contiguous range, the clone is laid out in preorder
+ *        (threads share records indexed by the dense ranks of the size reduction); one thread walks the subtree once
+ *        instead; either way memory is proportional to the subtree only
+ * @param tree pointer to structure
+ * @param nodeId id of a subtree root to clone
+ * @param[out] id_out id of the cloned root
+ * @param nThreads number of threads to use
+ * @return gTree status code
+ */
+static gTree_status gTree_cloneSubtreeParallel(gTree *tree, size_t nodeId, size_t *id_out, size_t nThreads)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),   gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_CloneSubtree);
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ASSERT_LOG(gPtrValid(id_out), gTree_status_BadOutPtr,    tree->logStream);
+    GTREE_ID_VAL(nodeId);
+    #ifdef EXTRA_VERBOSE
+        fprintf(stderr, "cloneSubtree: nodeId = %lu\n", nodeId);
+    #endif
+
+    gTree_ReduceCtx sizes = {};
+    size_t cnt = 0;
+    if (nThreads <= 1) {
+        for (size_t id = nodeId; id != -1; id = gTree_nextPreorder(tree, nodeId, id))
+            ++cnt;
+    } else {
+        GTREE_IS_OK(gTree_reduceAll(tree, nodeId, sizeof(gTree_CloneVal), gTree_sizeMap, gTree_sizeCombine, NULL, nThreads, 0, &sizes));
+        gTree_CloneVal *rootVal = (gTree_CloneVal*)gTree_reduceVal(gTree_reduceRec(&sizes, 0));
+        cnt = rootVal->size;
+        rootVal->rank = 0;
+    }
+
+    gTree_CloneCtx cc = {&sizes, NULL};
+    size_t *ids = (size_t*)malloc(cnt * sizeof(size_t));
+    gTree_status status = (ids != NULL) ? gTree_status_OK : gTree_status_AllocErr;
+    size_t allocated = 0;
+    while (status == gTree_status_OK && allocated < cnt)
+        if ((status = gTree_allocNode(tree, &ids[allocated])) == gTree_status_OK)
+            ++allocated;
+
+    if (status == gTree_status_OK && nThreads <= 1) {
+        gTree_sortIds(tree, ids, cnt);
+        gTree_cloneWalk(tree, nodeId, ids);
+    } else if (status == gTree_status_OK) {
+        gTree_sortIds(tree, ids, cnt);
+        cc.ids = ids;
+        gTree_WorkPool wp = {};
+        wp.tree   = tree;
+        wp.rootId = nodeId;
+        wp.visit  = gTree_cloneVisit;
+        wp.ctx    = &cc;
+        status = gTree_wsRun(&wp, nThreads);
+    }
+    if (status != gTree_status_OK)
+        while (allocated > 0)
+            gTree_freeNode(tree, ids[--allocated]);
+    else
+        *id_out = ids[0];
+    if (status == gTree_status_OK)
+        GTREE_EVENT(gTree_ev_Insert, ids[0], -1, NULL);
+
+    gTree_reduceFree(&sizes);
+    free(ids);
+    GTREE_IS_OK(status);
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief clones subtree by a node (creates parentless subtree same as the given, laid out in preorder)
+ * @param tree pointer to structure
+ * @param nodeId id of a subtree root to clone
+ * @param[out] id_out id of the cloned root
+ * @return gTree status code
+ */
+static gTree_status gTree_cloneSubtree(gTree *tree, const size_t nodeId, size_t *id_out)
+{
+    return gTree_cloneSubtreeParallel(tree, nodeId, id_out, 1);
+}
+
+
+/**
+ * @brief detaches subtree from the tree and queues it to be freed later by gTree_collectDeferred or the reaper thread
+ *        in O(1): only the root id is rejected right away, ids below it stay valid (though unreachable from the root)
+ *        until the collector detaches them (in a transaction the subtree is deleted as usual)
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root to delete
+ * @return gTree status code
+ */
+static gTree_status gTree_delSubtreeDeferred(gTree *tree, size_t rootId)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_DelSubtreeDeferred);
+    GTREE_ID_VAL(rootId);
+    if (tree->txnActive)
+        return gTree_delSubtree(tree, rootId);
+
+    GTREE_OBSERVE_SCOPE();
+    GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->grave, &tree->graveCap, tree->graveCnt + 1, sizeof(size_t)),
+                                                                gTree_status_AllocErr, tree->logStream);
+    GTREE_EVENT(gTree_ev_Kill, rootId, GTREE_NODE_BY_ID(rootId)->parent, NULL);
+    GTREE_IS_OK(GTREE_QUIET(gTree_unlinkNode(tree, rootId)));
+    gTree_markDead(tree, rootId);
+    tree->grave[tree->graveCnt] = rootId;
+    __atomic_store_n(&tree->graveCnt, tree->graveCnt + 1, __ATOMIC_RELEASE);
+
+    if (tree->reaperOn) {
+        pthread_mutex_lock(&tree->graveLock);
+        pthread_cond_signal(&tree->graveCond);
+        pthread_mutex_unlock(&tree->graveLock);
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief frees up to budget nodes of the detached subtrees, the pause is bounded by the budget (O(1) amortized per node)
+ * @param tree pointer to structure
+ * @param budget max number of nodes to free
+ * @param[out] freed_out ptr to write number of freed nodes to (could be NULL)
+ * @return gTree status code
+ */
+static gTree_status gTree_collectDeferred(gTree *tree, size_t budget, size_t *freed_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_CollectDeferred);
+    GTREE_ASSERT_LOG(!tree->txnActive, gTree_status_BadTxn, tree->logStream);
+
+    /* the child link of a grave root is its cursor: children are detached one per step and the root is freed once
+       it has none left, so a step is O(1) and every grave entry stays a whole subtree;
+       grave roots are dead, so a child is taken off id checks as it is detached */
+    size_t freed = 0;
+    while (freed < budget && tree->graveCnt != 0) {
+        size_t id = tree->grave[tree->graveCnt - 1];
+        size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->child;
+        if (childId == -1) {
+            __atomic_store_n(&tree->graveCnt, tree->graveCnt - 1, __ATOMIC_RELEASE);
+            gTree_markLive(tree, id);
+            GTREE_POOL_FREE(id);
+            ++freed;
+            continue;
+        }
+        GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->grave, &tree->graveCap, tree->graveCnt + 1, sizeof(size_t)),
+                                                                gTree_status_AllocErr, tree->logStream);
+        GTREE_TOUCH(id);
+        GTREE_TOUCH(childId);
+        gTree_Node *child = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId);
+        GTREE_STORE_LINK(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->child, child->sibling);
+        GTREE_STORE_LINK(child->sibling, -1);
+        GTREE_STORE_LINK(child->parent, -1);
+        gTree_markDead(tree, childId);
+        tree->grave[tree->graveCnt] = childId;
+        __atomic_store_n(&tree->graveCnt, tree->graveCnt + 1, __ATOMIC_RELEASE);
+    }
+
+    if (gPtrValid(freed_out))
+        *freed_out = freed;
+    return gTree_status_OK;
+}
+
+
+static void *gTree_reaperMain(void *state)
+{
+    gTree *tree = (gTree*)state;
+    for (;;) {
+        pthread_mutex_lock(&tree->graveLock);
+        while (__atomic_load_n(&tree->graveCnt, __ATOMIC_ACQUIRE) == 0 && tree->reaperOn)
+            pthread_cond_wait(&tree->graveCond, &tree->graveLock);
+        bool on = tree->reaperOn;
+        pthread_mutex_unlock(&tree->graveLock);
+        if (!on)
+            break;
+
+        gTree_writeLock(tree);
+        if (!tree->txnActive)                   // the grave is left alone until the transaction ends
+            gTree_collectDeferred(tree, tree->reaperBatch, NULL);
+        gTree_writeUnlock(tree);
+        sched_yield();
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief starts background thread that frees detached subtrees, taking the write lock for at most batch nodes at once
+ * @param tree pointer to structure (must be in the concurrent mode)
+ * @param batch max number of nodes to free per write lock (0 for default)
+ * @return gTree status code
+ */
+static gTree_status gTree_startReaper(gTree *tree, size_t batch)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(tree->concurrent && !tree->reaperOn, gTree_status_BadMode, tree->logStream);
+
+    tree->reaperBatch = (batch == 0) ? 4096 : batch;
+    tree->reaperOn = true;
+    if (pthread_create(&tree->reaper, NULL, gTree_reaperMain, tree) != 0) {
+        tree->reaperOn = false;
+        GTREE_ASSERT_LOG(false, gTree_status_AllocErr, tree->logStream);
+    }
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief preorder intervals of the nodes reachable from the root, node a is in subtree of b iff pre[b] <= pre[a] < end[b]
+ */
+struct gTree_Intervals
+{
+    size_t *pre;                /// Preorder rank by node id (-1 for unreachable slots)
+    size_t *end;                /// Rank after the last node of the subtree by node id
+    size_t cnt;                 /// Number of slots covered (pool capacity at the moment of building)
+} typedef gTree_Intervals;
+
+
+/**
+ * @brief computes preorder intervals of the whole tree (they are valid until the next mutation)
+ * @param tree pointer to structure
+ * @param[out] intervals_out ptr to structure to build (must be destructed with gTree_intervalsDtor)
+ * @return gTree status code
+ */
+static gTree_status gTree_buildIntervals(const gTree *tree, gTree_Intervals *intervals_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),          gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_BuildIntervals);
+    GTREE_ASSERT_LOG(gPtrValid(intervals_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    size_t cnt = tree->pool.capacity;
+    size_t *pre = (size_t*)malloc(cnt * sizeof(size_t));
+    size_t *end = (size_t*)malloc(cnt * sizeof(size_t));
+    if (pre == NULL || end == NULL) {
+        free(pre);
+        free(end);
+        GTREE_ASSERT_LOG(false, gTree_status_AllocErr, tree->logStream);
+    }
+    memset(pre, 0xFF, cnt * sizeof(size_t));
+
+    size_t rank = 0;
+    for (size_t id = tree->root; id != -1; id = gTree_nextPreorder(tree, tree->root, id))
+        pre[id] = rank++;
+    for (size_t id = gTree_firstPostorder(tree, tree->root); id != -1; id = gTree_nextPostorder(tree, tree->root, id)) {
+        size_t tail = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->tail;
+        end[id] = (tail == -1) ? pre[id] + 1 : end[tail];
+    }
+
+    intervals_out->pre = pre;
+    intervals_out->end = end;
+    intervals_out->cnt = cnt;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief gTree_Intervals destructor
+ * @param intervals pointer to structure to destruct
+ * @return gTree status code
+ */
+static gTree_status gTree_intervalsDtor(gTree_Intervals *intervals)
+{
+    if (!gPtrValid(intervals))
+        return gTree_status_BadStructPtr;
+    free(intervals->pre);
+    free(intervals->end);
+    intervals->pre = NULL;
+    intervals->end = NULL;
+    intervals->cnt = 0;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief types of the payload key compared by gTree_findAll
+ */
+enum gTree_KeyType
+{
+    gTree_key_Int32,            /// int32_t
+    gTree_key_Int64,            /// int64_t
+} typedef gTree_KeyType;
+
+
+/**
+ * @brief payload predicate: nodes with lo <= key <= hi match (lo == hi for equality)
+ */
+struct gTree_Query
+{
+    size_t keyOffset;           /// Offset of the key inside GTREE_TYPE in bytes
+    gTree_KeyType keyType;
+    int64_t lo;
+    int64_t hi;
+} typedef gTree_Query;
+
+
+/**
+ * @brief number of slots compared at once by the scan kernels
+ */
+static const size_t GTREE_SCAN_BLOCK = 8;
+
+
+/**
+ * @brief checks whether the key (of the query type, may be unaligned) lies in [query->lo, query->hi]
+ */
+static bool gTree_keyInRange(const char *key, const gTree_Query *query)
+{
+    int64_t k = 0;
+    if (query->keyType == gTree_key_Int32) {
+        int32_t k32 = 0;
+        memcpy(&k32, key, sizeof(int32_t));
+        k = k32;
+    } else {
+        memcpy(&k, key, sizeof(int64_t));
+    }
+    return query->lo <= k && k <= query->hi;
+}
+
+
+#if defined(__SSE2__) && !defined(__AVX2__)
+/**
+ * @brief loads keys of 4 slots stride bytes apart into the lanes of a vector (SSE2 has no gather)
+ */
+static __m128i gTree_load4x32(const char *key, size_t stride)
+{
+    __m128i k01 = _mm_unpacklo_epi32(_mm_loadu_si32(key),              _mm_loadu_si32(key + stride));
+    __m128i k23 = _mm_unpacklo_epi32(_mm_loadu_si32(key + 2 * stride), _mm_loadu_si32(key + 3 * stride));
+    return _mm_unpacklo_epi64(k01, k23);
+}
+
+
+/**
+ * @brief signed 64-bit a > b per lane (SSE2 has only 32-bit compares, so halves are combined)
+ */
+static __m128i gTree_cmpgt64(__m128i a, __m128i b)
+{
+    #if defined(__SSE4_2__)
+    return _mm_cmpgt_epi64(a, b);
+    #else
+    __m128i bias = _mm_set_epi32(0, INT32_MIN, 0, INT32_MIN);
+    __m128i hiGt = _mm_cmpgt_epi32(a, b);
+    __m128i hiEq = _mm_cmpeq_epi32(a, b);
+    __m128i loGt = _mm_cmpgt_epi32(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+    __m128i gt   = _mm_or_si128(hiGt, _mm_and_si128(hiEq, _mm_shuffle_epi32(loGt, _MM_SHUFFLE(2, 2, 0, 0))));
+    return _mm_shuffle_epi32(gt, _MM_SHUFFLE(3, 3, 1, 1));
+    #endif
+}
+#endif
+
+
+/**
+ * @brief compares keys of GTREE_SCAN_BLOCK consecutive slots (stride bytes apart) with [lo, hi]
+ *        (AVX2 gathers the keys, SSE2 assembles lanes by direct strided loads)
+ * @return bitmask of matching slots
+ */
+static unsigned gTree_scanBlock32(const char *key, size_t stride, int32_t lo, int32_t hi)
+{
+    #if defined(__AVX2__)
+    int s = (int)stride;
+    __m256i idx = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+    __m256i x   = _mm256_i32gather_epi32((const int*)key, idx, 1);
+    __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(lo), x), _mm256_cmpgt_epi32(x, _mm256_set1_epi32(hi)));
+    return ~(unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(out)) & 0xFF;
+    #elif defined(__SSE2__)
+    __m128i vlo = _mm_set1_epi32(lo);
+    __m128i vhi = _mm_set1_epi32(hi);
+    unsigned mask = 0;
+    for (size_t half = 0; half < 2; ++half) {
+        __m128i x   = gTree_load4x32(key + half * 4 * stride, stride);
+        __m128i out = _mm_or_si128(_mm_cmplt_epi32(x, vlo), _mm_cmpgt_epi32(x, vhi));
+        mask |= (~(unsigned)_mm_movemask_ps(_mm_castsi128_ps(out)) & 0xF) << (half * 4);
+    }
+    return mask;
+    #else
+    unsigned mask = 0;
+    for (size_t i = 0; i < GTREE_SCAN_BLOCK; ++i) {
+        int32_t k = 0;
+        memcpy(&k, key + i * stride, sizeof(int32_t));
+        mask |= (unsigned)(lo <= k && k <= hi) << i;
+    }
+    return mask;
+    #endif
+}
+
+
+static unsigned gTree_scanBlock64(const char *key, size_t stride, int64_t lo, int64_t hi)
+{
+    #if defined(__AVX2__)
+    int s = (int)stride;
+    __m128i idx  = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+    __m256i vlo  = _mm256_set1_epi64x(lo);
+    __m256i vhi  = _mm256_set1_epi64x(hi);
+    unsigned mask = 0;
+    for (size_t half = 0; half < 2; ++half) {
+        __m256i x   = _mm256_i32gather_epi64((const long long*)(key + half * 4 * stride), idx, 1);
+        __m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(vlo, x), _mm256_cmpgt_epi64(x, vhi));
+        mask |= (~(unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(out)) & 0xF) << (half * 4);
+    }
+    return mask;
+    #elif defined(__SSE2__)
+    __m128i vlo = _mm_set1_epi64x(lo);
+    __m128i vhi = _mm_set1_epi64x(hi);
+    unsigned mask = 0;
+    for (size_t pair = 0; pair < GTREE_SCAN_BLOCK / 2; ++pair) {
+        const char *k = key + pair * 2 * stride;
+        __m128i x   = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)k), _mm_loadl_epi64((const __m128i*)(k + stride)));
+        __m128i out = _mm_or_si128(gTree_cmpgt64(vlo, x), gTree_cmpgt64(x, vhi));
+        mask |= (~(unsigned)_mm_movemask_pd(_mm_castsi128_pd(out)) & 0x3) << (pair * 2);
+    }
+    return mask;
+    #else
+    unsigned mask = 0;
+    for (size_t i = 0; i < GTREE_SCAN_BLOCK; ++i) {
+        int64_t k = 0;
+        memcpy(&k, key + i * stride, sizeof(int64_t));
+        mask |= (unsigned)(lo <= k && k <= hi) << i;
+    }
+    return mask;
+    #endif
+}
+
+
+/**
+ * @brief finds matching nodes of the subtree by walking it, for calls without prebuilt intervals
+ *        (O(subtree size + depth) instead of the O(capacity) pool scan)
+ */
+static gTree_status gTree_findInSubtree(gTree *tree, const gTree_Query *query, size_t rootId, size_t **ids_out, size_t *cnt_out)
+{
+    if (!gObjPool_idValid(&tree->pool, rootId) || !GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, rootId)->allocated)
+        return gTree_status_BadId;
+    size_t topId = rootId;
+    while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, topId)->parent != -1)
+        topId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, topId)->parent;
+    if (topId != tree->root)
+        return gTree_status_BadId;
+
+    size_t *ids = NULL;
+    size_t cnt = 0, cap = 0;
+    for (size_t id = rootId; id != -1; id = gTree_nextPreorder(tree, rootId, id)) {
+        if (!gTree_keyInRange((const char*)&GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->data + query->keyOffset, query))
+            continue;
+        if (!gTree_growArray((void**)&ids, &cap, cnt + 1, sizeof(size_t))) {
+            free(ids);
+            return gTree_status_AllocErr;
+        }
+        ids[cnt++] = id;
+    }
+    gTree_sortIds(tree, ids, cnt);
+    *ids_out = ids;
+    *cnt_out = cnt;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief finds all nodes of the subtree with payload key matching the query by a linear vectorized scan of the pool
+ *        (no pointer chasing, reserved and dead slots are filtered out by the preorder intervals)
+ * @param tree pointer to structure
+ * @param query payload predicate
+ * @param intervals preorder intervals built by gTree_buildIntervals (could be NULL, then the subtree is walked instead,
+ *                  which costs O(subtree size) rather than O(capacity) and suits small subtrees and one-off queries)
+ * @param rootId id of a subtree root to restrict search to (tree->root for the whole tree)
+ * @param[out] ids_out ptr to write malloc'ed array of matching ids in ascending order to
+ * @param[out] cnt_out ptr to write number of matching nodes to
+ * @return gTree status code
+ */
+static gTree_status gTree_findAll(gTree *tree, const gTree_Query *query, const gTree_Intervals *intervals, size_t rootId,
+                                                                                    size_t **ids_out, size_t *cnt_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),    gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_FindAll);
+    GTREE_ASSERT_LOG(gPtrValid(query),   gTree_status_BadData,      tree->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(ids_out), gTree_status_BadOutPtr,    tree->logStream);
+    GTREE_ASSERT_LOG(gPtrValid(cnt_out), gTree_status_BadOutPtr,    tree->logStream);
+    size_t keySize = (query->keyType == gTree_key_Int32) ? sizeof(int32_t) : sizeof(int64_t);
+    GTREE_ASSERT_LOG(query->keyOffset + keySize <= sizeof(GTREE_TYPE), gTree_status_BadData, tree->logStream);
+    if (query->keyType == gTree_key_Int32)
+        GTREE_ASSERT_LOG(INT32_MIN <= query->lo && query->hi <= INT32_MAX, gTree_status_BadData, tree->logStream);
+
+    if (!gPtrValid(intervals)) {
+        gTree_readLock(tree);
+        gTree_status status = gTree_findInSubtree(tree, query, rootId, ids_out, cnt_out);
+        gTree_readUnlock(tree);
+        GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+        return gTree_status_OK;
+    }
+
+    gTree_readLock(tree);
+    gTree_status status = gTree_status_OK;
+    if (!(rootId < intervals->cnt && intervals->pre[rootId] != -1))
+        status = gTree_status_BadId;
+
+    size_t *ids = NULL;
+    size_t cnt = 0, cap = 0;
+    if (status == gTree_status_OK) {
+        size_t lo   = intervals->pre[rootId];
+        size_t span = intervals->end[rootId] - lo;
+        size_t slotCnt = (intervals->cnt < tree->pool.capacity) ? intervals->cnt : tree->pool.capacity;
+        size_t stride  = (slotCnt < 2) ? 0 : (const char*)GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, 1) -
+                                              (const char*)GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, 0);
+        size_t blockCnt = (slotCnt < 2) ? 0 : slotCnt / GTREE_SCAN_BLOCK;
+        const char *keys = (const char*)&GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, 0)->data + query->keyOffset;
+
+        for (size_t block = 0; block <= blockCnt && status == gTree_status_OK; ++block) {
+            size_t first = block * GTREE_SCAN_BLOCK;
+            unsigned mask = 0;
+            if (block < blockCnt) {
+                mask = (query->keyType == gTree_key_Int32) ?
+                        gTree_scanBlock32(keys + first * stride, stride, (int32_t)query->lo, (int32_t)query->hi) :
+                        gTree_scanBlock64(keys + first * stride, stride, query->lo, query->hi);
+            } else {
+                for (size_t id = first; id < slotCnt; ++id) {
+                    const char *key = (const char*)&GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->data + query->keyOffset;
+                    mask |= (unsigned)gTree_keyInRange(key, query) << (id - first);
+                }
+            }
+
+            while (mask != 0) {
+                size_t id = first + __builtin_ctz(mask);
+                mask &= mask - 1;
+                if (intervals->pre[id] - lo >= span || !GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated)
+                    continue;
+                if (!gTree_growArray((void**)&ids, &cap, cnt + 1, sizeof(size_t))) {
+                    status = gTree_status_AllocErr;
+                    break;
+                }
+                ids[cnt++] = id;
+            }
+        }
+    }
+    gTree_readUnlock(tree);
+
+    if (status != gTree_status_OK)
+        free(ids);
+    GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+    *ids_out = ids;
+    *cnt_out = cnt;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief marks slots that are held by the tree while unreachable from the root: cached in magazines,
+ *        waiting in limbo or in the undo log of the transaction, kept for snapshots and detached subtrees not freed yet
+ * @param tree pointer to structure
+ * @param bits bitmap over the slots below bitCnt
+ * @param bitCnt number of slots covered by the bitmap
+ * @param deep whether to mark whole detached subtrees (otherwise only their roots)
+ * @param strict whether slots that are already marked or not covered are reported
+ * @param[out] cnt_out ptr to write number of newly marked slots to
+ * @return id of a bad slot in the strict mode (-1 if there is none)
+ */
+static size_t gTree_markReserved(const gTree *tree, uint64_t *bits, size_t bitCnt, bool deep, bool strict, size_t *cnt_out)
+{
+    size_t cnt = 0;
+    #define GTREE_MARK_RESERVED(id) ({                                          \
+        size_t markId = (id);                                                    \
+        if (markId < bitCnt && gTree_bitSet(bits, markId))                       \
+            ++cnt;                                                               \
+        else if (strict)                                                         \
+            return markId;                                                       \
+    })
+
+    if (tree->mags != NULL)
+        for (size_t i = 0; i < GTREE_MAX_MAGAZINES; ++i)
+            for (size_t j = 0; j < tree->mags[i].cnt; ++j)
+                GTREE_MARK_RESERVED(tree->mags[i].ids[j]);
+    for (size_t i = tree->limboHead; i < tree->limboCnt; ++i)
+        GTREE_MARK_RESERVED(tree->limbo[i].id);
+    if (tree->txnActive)
+        for (size_t i = 0; i < tree->undoCnt; ++i)
+            if (tree->undo[i].type == gTree_undo_Free)
+                GTREE_MARK_RESERVED(tree->undo[i].id);
+    #ifdef GTREE_VERSIONED
+    for (size_t i = 0; i < tree->verCnt; ++i) {
+        const gTree_VerRec *rec = &tree->vers[i];
+        if (rec->owner != -1 && rec->newer == -1 && GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, rec->owner)->gen == -1)
+            GTREE_MARK_RESERVED(rec->owner);
+    }
+    #endif
+    for (size_t i = 0; i < tree->graveCnt; ++i) {
+        size_t rootId = tree->grave[i];
+        GTREE_MARK_RESERVED(rootId);
+        if (!deep)
+            continue;
+        for (size_t id = gTree_nextPreorder(tree, rootId, rootId); id != -1; id = gTree_nextPreorder(tree, rootId, id))
+            GTREE_MARK_RESERVED(id);
+    }
+
+    #undef GTREE_MARK_RESERVED
+    *cnt_out = cnt;
+    return -1;
+}
+
+
+/**
+ * @brief result of gTree_verify
+ */
+struct gTree_VerifyReport
+{
+    size_t reachable;           /// Nodes reachable from the roots (checked nodes in the sampled mode)
+    size_t reserved;            /// Slots held by the tree on purpose while unreachable
+    size_t orphans;             /// Allocated slots that are neither reachable nor reserved (leaked)
+    size_t badId;               /// Id of the first node violating invariants (-1 if there is none)
+} typedef gTree_VerifyReport;
+
+
+/**
+ * @brief checks node links locally: child and tail point back, siblings share the parent, the tail ends the chain
+ * @return false if invariants are violated
+ */
+static bool gTree_checkNodeLinks(const gTree *tree, size_t id)
+{
+    #define GTREE_LINK_VALID(linkId) ((linkId) < tree->pool.capacity && GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, linkId)->allocated)
+    const gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+    bool ok = (node->child == -1) == (node->tail == -1);
+    if (ok && node->parent != -1)
+        ok = GTREE_LINK_VALID(node->parent);
+    if (ok && node->child != -1)
+        ok = GTREE_LINK_VALID(node->child) && GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, node->child)->parent == id &&
+             GTREE_LINK_VALID(node->tail)  && GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, node->tail)->parent  == id &&
+             GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, node->tail)->sibling == -1;
+    if (ok && node->sibling != -1)
+        ok = node->parent != -1 && GTREE_LINK_VALID(node->sibling) &&
+             GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, node->sibling)->parent == node->parent;
+    #undef GTREE_LINK_VALID
+    return ok;
+}
+
+
+/**
+ * @brief verifies structural invariants: parent, child, sibling and tail links agree, every node is reachable
+ *        from the root (or a parentless extra root registered with gTree_addGcRoot) at most once (no cycles or shared nodes), allocated slots are either reachable or reserved
+ *        (the full mode is a single pass with a visited bitmap, writers are held off)
+ * @param tree pointer to structure
+ * @param sampleCnt number of random slots to check locally instead of the full pass (0 for the full pass)
+ * @param[out] report_out ptr to write node accounting to (could be NULL)
+ * @return gTree status code (BadStructure if the tree is corrupted)
+ */
+static gTree_status gTree_verify(gTree *tree, size_t sampleCnt, gTree_VerifyReport *report_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Verify);
+
+    bool locked = gTree_writeEnter(tree);
+    size_t capacity = tree->pool.capacity;
+    uint64_t *bits  = (uint64_t*)calloc(capacity / 64 + 1, sizeof(uint64_t));
+    size_t *stack   = (sampleCnt == 0) ? (size_t*)malloc(capacity * sizeof(size_t)) : NULL;
+    if (bits == NULL || (sampleCnt == 0 && stack == NULL)) {
+        free(bits);
+        free(stack);
+        if (locked)
+            gTree_writeUnlock(tree);
+        GTREE_ASSERT_LOG(false, gTree_status_AllocErr, tree->logStream);
+    }
+
+    gTree_VerifyReport report = {0, 0, 0, (size_t)-1};
+    if (sampleCnt != 0) {
+        size_t badId = gTree_markReserved(tree, bits, capacity, false, true, &report.reserved);
+        uint64_t state = 0x9E3779B97F4A7C15ull ^ (uint64_t)tree->nodeCnt;
+        for (size_t i = 0; i < sampleCnt && badId == -1; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            size_t id = state % capacity;
+            if (!GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated || gTree_bitTest(bits, id))
+                continue;
+            ++report.reachable;
+            if (!gTree_checkNodeLinks(tree, id))
+                badId = id;
+        }
+        report.badId = badId;
+    } else {
+        size_t root = tree->root;
+        if (!gObjPool_idValid(&tree->pool, root) || GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, root)->parent  != -1
+                                                 || GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, root)->sibling != -1)
+            report.badId = root;
+
+        size_t stackCnt = 0;
+        if (report.badId == -1) {
+            gTree_bitSet(bits, root);
+            stack[stackCnt++] = root;
+            report.reachable = 1;
+        }
+        for (size_t i = 0; i < tree->gcRootCnt && report.badId == -1; ++i) {
+            size_t extraId = tree->gcRoots[i];
+            if (!gObjPool_idValid(&tree->pool, extraId))
+                report.badId = extraId;
+            else if (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, extraId)->parent == -1 && gTree_bitSet(bits, extraId)) {
+                stack[stackCnt++] = extraId;
+                ++report.reachable;
+            }
+        }
+        while (stackCnt != 0 && report.badId == -1) {
+            size_t id = stack[--stackCnt];
+            if (!gTree_checkNodeLinks(tree, id)) {
+                report.badId = id;
+                break;
+            }
+            size_t lastId = -1;
+            for (size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->child; childId != -1;
+                                                    childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+                if (!gObjPool_idValid(&tree->pool, childId) || GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->parent != id ||
+                                                                                        !gTree_bitSet(bits, childId)) {
+                    report.badId = childId;
+                    break;
+                }
+                stack[stackCnt++] = childId;
+                ++report.reachable;
+                lastId = childId;
+            }
+            if (report.badId == -1 && lastId != GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->tail)
+                report.badId = id;
+        }
+
+        if (report.badId == -1)
+            report.badId = gTree_markReserved(tree, bits, capacity, true, true, &report.reserved);
+        if (report.badId == -1)
+            for (size_t id = 0; id < capacity; ++id)
+                report.orphans += GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated && !gTree_bitTest(bits, id);
+    }
+
+    free(bits);
+    free(stack);
+    if (locked)
+        gTree_writeUnlock(tree);
+
+    if (gPtrValid(report_out))
+        *report_out = report;
+    GTREE_ASSERT_LOG(report.badId == -1, gTree_status_BadStructure, tree->logStream);
+    return (report.badId == -1) ? gTree_status_OK : gTree_status_BadStructure;
+}
+
+
+/**
+ * @brief registers extra root, nodes reachable from it survive gTree_collectGarbage and are not orphans for gTree_verify
+ * @param tree pointer to structure
+ * @param rootId id of a root to register (must not be called during a collection cycle)
+ * @return gTree status code
+ */
+static gTree_status gTree_addGcRoot(gTree *tree, size_t rootId)
 {
-    /* WARINING: needle and haystack must be null-terminating */
-    assert(gPtrValid(haystack));
-    assert(gPtrValid(needle));
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ID_VAL(rootId);
+    GTREE_ASSERT_LOG(tree->gcPhase == gTree_gc_Idle, gTree_status_BadMode, tree->logStream);
 
-    char *haystackIter = (char*)haystack;
-    char *needleIter   = (char*)needle;
-    while (isspace(*(haystackIter)))
-        ++haystackIter;
-    while (*needleIter != '\0' && *haystackIter != '\0') {
-        if (*needleIter != *haystackIter)
-            return false;
-        ++needleIter;
-        ++haystackIter;
+    GTREE_ASSERT_LOG(gTree_growArray((void**)&tree->gcRoots, &tree->gcRootCap, tree->gcRootCnt + 1, sizeof(size_t)),
+                                                                gTree_status_AllocErr, tree->logStream);
+    tree->gcRoots[tree->gcRootCnt++] = rootId;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief unregisters extra root
+ * @param tree pointer to structure
+ * @param rootId id of a registered root
+ * @return gTree status code
+ */
+static gTree_status gTree_removeGcRoot(gTree *tree, size_t rootId)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+
+    for (size_t i = 0; i < tree->gcRootCnt; ++i) {
+        if (tree->gcRoots[i] == rootId) {
+            tree->gcRoots[i] = tree->gcRoots[--tree->gcRootCnt];
+            return gTree_status_OK;
+        }
     }
-    if (*needleIter != '\0')
-        return false;
-    if (*haystackIter == '\0')
-        return true;
+    GTREE_ASSERT_LOG(false, gTree_status_BadId, tree->logStream);
+    return gTree_status_BadId;
+}
 
-    while (isspace(*(haystackIter)))
-        ++haystackIter;
-    if (*haystackIter == '\0')
+
+/**
+ * @brief marks node and queues it for scanning
+ * @return false on allocation failure
+ */
+static bool gTree_gcMark(gTree *tree, size_t id)
+{
+    if (id == -1 || id >= tree->gcCap || !gTree_bitSet(tree->gcBits, id))
         return true;
-    else
+    if (!gTree_growArray((void**)&tree->gcStack, &tree->gcStackCap, tree->gcStackCnt + 1, sizeof(size_t)))
         return false;
+    tree->gcStack[tree->gcStackCnt++] = id;
+    return true;
 }
 
 
 /**
- * @brief restores subTree from a file in human-readable format
+ * @brief runs garbage collection cycle: marks nodes reachable from the root, the extra roots and the reserved slots
+ *        (magazines, limbo, undo log, snapshots, detached subtrees), then frees unmarked slots of the pool in batches
+ *        (nodes unreachable when the cycle starts must not be linked back and the pool must not be used directly until it ends)
  * @param tree pointer to structure
- * @param nodeId id of a node to start restoring from
- * @param in filestream to read from
+ * @param budget max number of nodes to scan and slots to sweep in this call, bounds the pause (-1 for the whole cycle)
+ * @param[out] freed_out ptr to write number of freed slots to (could be NULL)
+ * @param[out] done_out ptr to write whether the cycle is finished to (could be NULL)
  * @return gTree status code
  */
-static gTree_status gTree_restoreSubTree(gTree *tree, size_t nodeId, FILE *in)
+static gTree_status gTree_collectGarbage(gTree *tree, size_t budget, size_t *freed_out, bool *done_out)
 {
-    /*
-     * WARNING: Tree restoration (below) just somewhat supports
-     *          empty lines and doesn't support nor checks lines
-     *          that don't follow the format.
-     */
-
-    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr,  stderr);
-    GTREE_ASSERT_LOG(gPtrValid(in),   gTree_status_FileErr,       tree->logStream);
-    GTREE_ID_VAL(nodeId);
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_CollectGarbage);
+    GTREE_ASSERT_LOG(!tree->txnActive, gTree_status_BadTxn, tree->logStream);
 
-    gTree_Node *node = GTREE_NODE_BY_ID(nodeId);
+    bool locked = gTree_writeEnter(tree);
     gTree_status status = gTree_status_OK;
+    if (tree->gcPhase == gTree_gc_Idle) {
+        tree->gcCap  = tree->pool.capacity;
+        tree->gcBits = (uint64_t*)calloc(tree->gcCap / 64 + 1, sizeof(uint64_t));
+        tree->gcStackCnt = 0;
+        tree->gcCursor   = 0;
+        if (tree->gcBits == NULL)
+            status = gTree_status_AllocErr;
+        else
+            tree->gcPhase = gTree_gc_Mark;
+        if (status == gTree_status_OK && !gTree_gcMark(tree, tree->root))
+            status = gTree_status_AllocErr;
+        for (size_t i = 0; i < tree->gcRootCnt && status == gTree_status_OK; ++i)
+            if (!gTree_gcMark(tree, tree->gcRoots[i]))
+                status = gTree_status_AllocErr;
+    }
 
-    char buffer[MAX_BUFFER_LEN] = "";
-    #ifdef EXTRA_VERBOSE
-        fprintf(stderr, "Restoring subTree from node %lu\n", nodeId);
-    #endif
+    size_t work = 0, freed = 0;
+    while (status == gTree_status_OK && tree->gcPhase != gTree_gc_Idle && work < budget) {
+        if (tree->gcPhase == gTree_gc_Mark && tree->gcStackCnt != 0) {
+            size_t id = tree->gcStack[--tree->gcStackCnt];
+            gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+            if (!gTree_gcMark(tree, node->child) || !gTree_gcMark(tree, node->sibling))
+                status = gTree_status_AllocErr;
+            ++work;
+        } else if (tree->gcPhase == gTree_gc_Mark) {
+            /* subtrees detached before or during the cycle are still to be freed by gTree_collectDeferred */
+            for (size_t i = 0; i < tree->graveCnt && status == gTree_status_OK; ++i)
+                if (!gTree_gcMark(tree, tree->grave[i]))
+                    status = gTree_status_AllocErr;
+            size_t reserved = 0;
+            gTree_markReserved(tree, tree->gcBits, tree->gcCap, false, false, &reserved);
+            if (tree->gcStackCnt == 0)
+                tree->gcPhase = gTree_gc_Sweep;
+        } else if (tree->gcCursor < tree->gcCap) {
+            size_t id = tree->gcCursor++;
+            if (GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated && !gTree_bitTest(tree->gcBits, id)) {
+                status = gTree_freeNode(tree, id);
+                ++freed;
+            }
+            ++work;
+        } else {
+            free(tree->gcBits);
+            tree->gcBits  = NULL;
+            tree->gcCap   = 0;
+            tree->gcPhase = gTree_gc_Idle;
+        }
+    }
+    if (locked)
+        gTree_writeUnlock(tree);
+
+    GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+    if (gPtrValid(freed_out))
+        *freed_out = freed;
+    if (gPtrValid(done_out))
+        *done_out = (tree->gcPhase == gTree_gc_Idle);
+    return gTree_status_OK;
+}
 
-    size_t  curChildId = -1;
-    size_t prevChildId = -1;
-    GTREE_TYPE dummyData = {};
-    int bracketCnt = 1;
-    while ((bracketCnt > 0) && !feof(in)) {
-        GTREE_ASSERT_LOG(getline(buffer, MAX_BUFFER_LEN, in) == 0, gTree_status_FileErr, tree->logStream);
-        if (consistsOnly(buffer, "{")) {
-            ++bracketCnt;
-            prevChildId = curChildId;
-            status = gTree_addChild(tree, nodeId, &curChildId, dummyData);
-            GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
-            gTree_Node *curChild = GTREE_NODE_BY_ID(curChildId);
-            curChild->parent = nodeId;
-            curChild->child  = -1;
 
-            status = gTree_restoreSubTree(tree, curChildId, in);
-            --bracketCnt;
-            GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+/**
+ * @brief result of gTree_stats
+ */
+struct gTree_Stats
+{
+    size_t nodeCnt;             /// Nodes in the subtree
+    size_t leafCnt;
+    size_t height;              /// Depth of the deepest node (0 for a single node)
+    size_t maxFanout;
+    double avgFanout;           /// Children per non-leaf node
+    size_t *depthHist;          /// Number of nodes by depth (height + 1 of them)
+    size_t capacity;            /// Pool capacity
+    size_t liveSlots;           /// Allocated slots (by the allocation flags in the whole-pool mode, held by the tree otherwise)
+    size_t holes;               /// Free slots below the highest allocated one (whole-pool mode only)
+    double fragmentation;       /// Share of preorder neighbours that are not neighbours in the pool (0 for a preorder layout)
+} typedef gTree_Stats;
 
-            if (prevChildId != -1)
-                GTREE_NODE_BY_ID(prevChildId)->sibling = curChildId;
-            else
-                GTREE_NODE_BY_ID(nodeId)->child = curChildId;
-        } else if (consistsOnly(buffer, "}")) {
-            --bracketCnt;
-        } else if (consistsOnly(buffer, "[")) {
-            GTREE_ASSERT_LOG(gTree_restoreData(&node->data, in) == 0, gTree_status_BadData, tree->logStream);
+
+/**
+ * @brief gTree_Stats destructor
+ * @param stats pointer to structure to destruct
+ * @return gTree status code
+ */
+static gTree_status gTree_statsDtor(gTree_Stats *stats)
+{
+    if (!gPtrValid(stats))
+        return gTree_status_BadStructPtr;
+    free(stats->depthHist);
+    stats->depthHist = NULL;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief computes shape statistics of the subtree in a single iterative preorder pass
+ * @param tree pointer to structure
+ * @param rootId id of a subtree root (-1 for the whole-pool mode: the whole tree plus a scan of the allocation flags)
+ * @param[out] stats_out ptr to structure to fill (must be destructed with gTree_statsDtor)
+ * @return gTree status code
+ */
+static gTree_status gTree_stats(gTree *tree, size_t rootId, gTree_Stats *stats_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),      gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_Stats);
+    GTREE_ASSERT_LOG(gPtrValid(stats_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    gTree_readLock(tree);
+    bool wholePool = (rootId == -1);
+    if (wholePool)
+        rootId = tree->root;
+    if (!gObjPool_idValid(&tree->pool, rootId)) {
+        gTree_readUnlock(tree);
+        GTREE_ASSERT_LOG(false, gTree_status_BadId, tree->logStream);
+    }
+
+    gTree_Stats stats = {};
+    size_t histCap = 0, internalCnt = 0, scattered = 0;
+    size_t prevId = -1, depth = 0;
+    bool allocated = true;
+    for (size_t id = rootId; id != -1; ) {
+        if (!gTree_growArray((void**)&stats.depthHist, &histCap, depth + 1, sizeof(size_t))) {
+            allocated = false;
+            break;
+        }
+        if (stats.nodeCnt == 0 || depth > stats.height) {      // depth grows by one at most
+            stats.depthHist[depth] = 0;
+            stats.height = depth;
+        }
+        ++stats.depthHist[depth];
+        ++stats.nodeCnt;
+        scattered += (prevId != -1 && prevId + 1 != id);
+        prevId = id;
+
+        const gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+        size_t fanout = 0;
+        for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling)
+            ++fanout;
+        if (fanout == 0)
+            ++stats.leafCnt;
+        else
+            ++internalCnt;
+        if (fanout > stats.maxFanout)
+            stats.maxFanout = fanout;
+
+        if (node->child != -1) {
+            id = node->child;
+            ++depth;
+            continue;
+        }
+        while (id != rootId && GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->sibling == -1) {
+            id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->parent;
+            --depth;
         }
+        id = (id == rootId) ? -1 : GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->sibling;
     }
 
-    #ifdef EXTRA_VERBOSE
-        fprintf(stderr, "End of restoring subTree from node %lu\n", nodeId);
-    #endif
+    stats.avgFanout     = (internalCnt == 0) ? 0 : (double)(stats.nodeCnt - 1) / internalCnt;
+    stats.fragmentation = (stats.nodeCnt < 2) ? 0 : (double)scattered / (stats.nodeCnt - 1);
+    stats.capacity      = tree->pool.capacity;
+    stats.liveSlots     = tree->nodeCnt;
+    if (wholePool) {
+        size_t highest = 0;
+        stats.liveSlots = 0;
+        for (size_t id = 0; id < stats.capacity; ++id) {
+            if (GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated) {
+                ++stats.liveSlots;
+                highest = id;
+            }
+        }
+        stats.holes = highest + 1 - stats.liveSlots;
+    }
+    gTree_readUnlock(tree);
 
-    GTREE_ASSERT_LOG(bracketCnt == 0, gTree_status_BadRestoration, tree->logStream);
+    if (!allocated)
+        free(stats.depthHist);
+    GTREE_ASSERT_LOG(allocated, gTree_status_AllocErr, tree->logStream);
+    *stats_out = stats;
     return gTree_status_OK;
 }
 
 
 /**
- * @brief constructs tree and restores it from a file in human-readable format
+ * @brief memory used by the tree in bytes, reported by gTree_memoryUsage
+ */
+struct gTree_MemoryUsage
+{
+    size_t liveNodes;           /// Pool slots held by the tree
+    size_t freeNodes;           /// Pool slots not used yet
+    size_t links;               /// Part of the held slots taken by links and pool bookkeeping
+    size_t payload;             /// Part of the held slots taken by GTREE_TYPE
+    size_t payloadHeap;         /// Heap owned by payloads (reported by the hook)
+    size_t index;               /// Magazines, reader slots, version records and collector state
+    size_t logs;                /// Undo log, limbo and queue of detached subtrees
+    size_t total;               /// All of the above plus the structure itself
+} typedef gTree_MemoryUsage;
+
+
+/**
+ * @brief sets hook reporting heap memory owned by payloads to gTree_memoryUsage
  * @param tree pointer to structure
- * @param newLogStream logStream to forward to constructor
- * @param in filestream to read from
+ * @param hook hook to set (could be NULL)
+ * @param arg argument to forward to hook
  * @return gTree status code
  */
-static gTree_status gTree_restoreTree(gTree *tree, FILE *newLogStream, FILE *in)
+static gTree_status gTree_setPayloadHeapHook(gTree *tree, gTree_PayloadHeapFunc hook, void *arg)
 {
-    /* WARNING: tree structure must be uninitialized */
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    tree->payloadHeap    = hook;
+    tree->payloadHeapArg = arg;
+    return gTree_status_OK;
+}
 
-    gTree_ctor(tree, newLogStream);
-    char buffer[MAX_BUFFER_LEN] = "";
-    GTREE_ASSERT_LOG(getline(buffer, MAX_BUFFER_LEN, in) == 0, gTree_status_FileErr, tree->logStream);
-    gTree_status status = gTree_status_OK;
 
-    if (consistsOnly(buffer, "{")) {
-        status = gTree_restoreSubTree(tree, tree->root, in);
-        GTREE_ASSERT_LOG(status == gTree_status_OK, status, tree->logStream);
+/**
+ * @brief reports memory used by the tree in O(1) (from nodeCnt and capacities of the service arrays)
+ * @param tree pointer to structure
+ * @param[out] usage_out ptr to structure to fill
+ * @return gTree status code
+ */
+static gTree_status gTree_memoryUsage(const gTree *tree, gTree_MemoryUsage *usage_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree),      gTree_status_BadStructPtr, stderr);
+    GTREE_LATENCY_SCOPE(gTree_lat_MemoryUsage);
+    GTREE_ASSERT_LOG(gPtrValid(usage_out), gTree_status_BadOutPtr,    tree->logStream);
+
+    size_t slotSize = (tree->pool.capacity < 2) ? sizeof(gTree_Node) :
+                            (size_t)((const char*)GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, 1) -
+                                     (const char*)GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, 0));
+    size_t liveCnt = (tree->nodeCnt < tree->pool.capacity) ? tree->nodeCnt : tree->pool.capacity;
+
+    gTree_MemoryUsage usage = {};
+    usage.liveNodes   = liveCnt * slotSize;
+    usage.freeNodes   = (tree->pool.capacity - liveCnt) * slotSize;
+    usage.payload     = liveCnt * sizeof(GTREE_TYPE);
+    usage.links       = usage.liveNodes - usage.payload;
+    usage.payloadHeap = (tree->payloadHeap != NULL) ? tree->payloadHeap(tree->payloadHeapArg) : 0;
+
+    if (tree->mags != NULL)
+        usage.index += GTREE_MAX_MAGAZINES * sizeof(gTree_Magazine);
+    if (tree->readers != NULL)
+        usage.index += GTREE_MAX_READERS * sizeof(gTree_EpochSlot);
+    #ifdef GTREE_VERSIONED
+    usage.index += tree->snapCap * sizeof(gTree_SnapEntry) + tree->verCap * sizeof(gTree_VerRec);
+    #endif
+    if (tree->gcBits != NULL)
+        usage.index += (tree->gcCap / 64 + 1) * sizeof(uint64_t);
+    usage.index += tree->gcStackCap * sizeof(size_t) + tree->gcRootCap * sizeof(size_t);
+
+    usage.logs = tree->undoCap * sizeof(gTree_UndoRec) + tree->undoBitsCap * sizeof(uint64_t) + tree->limboCap * sizeof(gTree_Retired) + tree->graveCap * sizeof(size_t);
+    #ifdef GTREE_OBSERVERS
+    usage.logs += tree->txnEventCap * sizeof(gTree_Event);
+    #endif
+
+    usage.total = sizeof(gTree) + usage.liveNodes + usage.freeNodes + usage.payloadHeap + usage.index + usage.logs;
+    *usage_out = usage;
+    return gTree_status_OK;
+}
+
+
+/**
+ * @brief copies hot-path counters of the tree
+ * @param tree pointer to structure
+ * @param[out] counters_out ptr to write counters to (zeroed if counters are compiled out)
+ * @return gTree status code (BadMode if GTREE_COUNTERS is not defined)
+ */
+static gTree_status gTree_getCounters(const gTree *tree, gTree_Counters *counters_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(gPtrValid(counters_out), gTree_status_BadOutPtr, tree->logStream);
+
+    #ifdef GTREE_COUNTERS
+    const size_t *src = (const size_t*)&tree->counters;
+    size_t *dst = (size_t*)counters_out;
+    for (size_t i = 0; i < sizeof(gTree_Counters) / sizeof(size_t); ++i)
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    return gTree_status_OK;
+    #else
+    memset(counters_out, 0, sizeof(gTree_Counters));
+    return gTree_status_BadMode;
+    #endif
+}
+
+
+/**
+ * @brief zeroes hot-path counters of the tree
+ * @param tree pointer to structure
+ * @return gTree status code (BadMode if GTREE_COUNTERS is not defined)
+ */
+static gTree_status gTree_resetCounters(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+
+    #ifdef GTREE_COUNTERS
+    size_t *dst = (size_t*)&tree->counters;
+    for (size_t i = 0; i < sizeof(gTree_Counters) / sizeof(size_t); ++i)
+        __atomic_store_n(&dst[i], 0, __ATOMIC_RELAXED);
+    return gTree_status_OK;
+    #else
+    return gTree_status_BadMode;
+    #endif
+}
+
+
+/**
+ * @brief latency histogram of an operation merged over all threads
+ */
+struct gTree_LatencySummary
+{
+    uint64_t cnt;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[GTREE_LAT_BUCKETS];    /// Number of samples in [gTree_latencyBucketLow(i), gTree_latencyBucketLow(i + 1))
+} typedef gTree_LatencySummary;
+
+
+/**
+ * @brief merges per-thread histograms of an operation without stopping the threads that record them
+ * @param tree pointer to structure
+ * @param op operation to merge
+ * @param[out] summary_out ptr to write merged histogram to (zeroed if histograms are compiled out)
+ * @return gTree status code (BadMode if GTREE_LATENCY is not defined)
+ */
+static gTree_status gTree_latencySummary(const gTree *tree, gTree_LatOp op, gTree_LatencySummary *summary_out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(gPtrValid(summary_out), gTree_status_BadOutPtr, tree->logStream);
+    GTREE_ASSERT_LOG(op < gTree_lat_Cnt, gTree_status_BadId, tree->logStream);
+
+    memset(summary_out, 0, sizeof(gTree_LatencySummary));
+    #ifdef GTREE_LATENCY
+    for (size_t i = 0; i <= GTREE_MAX_LAT_THREADS; ++i) {
+        gTree_LatencyHist *hist = __atomic_load_n(&tree->latency[i], __ATOMIC_ACQUIRE);
+        if (hist == NULL)
+            continue;
+        for (size_t b = 0; b < GTREE_LAT_BUCKETS; ++b) {
+            uint64_t cnt = __atomic_load_n(&hist->cnt[op][b], __ATOMIC_RELAXED);
+            summary_out->buckets[b] += cnt;
+            summary_out->cnt += cnt;
+        }
+        summary_out->sum += __atomic_load_n(&hist->sum[op], __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&hist->max[op], __ATOMIC_RELAXED);
+        if (max > summary_out->max)
+            summary_out->max = max;
+    }
+    return gTree_status_OK;
+    #else
+    return gTree_status_BadMode;
+    #endif
+}
+
+
+/**
+ * @brief q-quantile of a merged histogram (the lower bound of its bucket, so within 1 / GTREE_LAT_SUB of the real one)
+ */
+static uint64_t gTree_latencyPercentile(const gTree_LatencySummary *summary, double q)
+{
+    if (summary->cnt == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(q * (double)(summary->cnt - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < GTREE_LAT_BUCKETS; ++b)
+        if ((seen += summary->buckets[b]) >= rank)
+            return gTree_latencyBucketLow(b);
+    return summary->max;
+}
+
+
+/**
+ * @brief zeroes latency histograms of the tree (samples recorded concurrently could survive)
+ * @param tree pointer to structure
+ * @return gTree status code (BadMode if GTREE_LATENCY is not defined)
+ */
+static gTree_status gTree_resetLatency(gTree *tree)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+
+    #ifdef GTREE_LATENCY
+    for (size_t i = 0; i <= GTREE_MAX_LAT_THREADS; ++i) {
+        gTree_LatencyHist *hist = __atomic_load_n(&tree->latency[i], __ATOMIC_ACQUIRE);
+        if (hist == NULL)
+            continue;
+        uint64_t *cells = &hist->cnt[0][0];
+        size_t cellCnt = (sizeof(hist->cnt) + sizeof(hist->sum) + sizeof(hist->max)) / sizeof(uint64_t);
+        for (size_t c = 0; c < cellCnt; ++c)
+            __atomic_store_n(&cells[c], 0, __ATOMIC_RELAXED);
+    }
+    return gTree_status_OK;
+    #else
+    return gTree_status_BadMode;
+    #endif
+}
+
+
+/**
+ * @brief dumps merged latency histograms of all operations in JSON: count, mean, max, percentiles and non-empty buckets
+ * @param tree pointer to structure
+ * @param out stream to write JSON to
+ * @return gTree status code (BadMode if GTREE_LATENCY is not defined)
+ */
+static gTree_status gTree_dumpLatencyJson(const gTree *tree, FILE *out)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(gPtrValid(out), gTree_status_BadDumpOutPtr, tree->logStream);
+
+    #ifdef GTREE_LATENCY
+    gTree_LatencySummary *summary = (gTree_LatencySummary*)malloc(sizeof(gTree_LatencySummary));
+    GTREE_ASSERT_LOG(summary != NULL, gTree_status_AllocErr, tree->logStream);
+    #if defined(GTREE_LATENCY_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+    const char *unit = "ticks";
+    #else
+    const char *unit = "ns";
+    #endif
+
+    fprintf(out, "{\n\t\"unit\": \"%s\",\n\t\"ops\": {", unit);
+    for (size_t op = 0; op < gTree_lat_Cnt; ++op) {
+        gTree_latencySummary(tree, (gTree_LatOp)op, summary);
+        fprintf(out, "%s\n\t\t\"%s\": {\"count\": %" PRIu64 ", \"mean\": %.1f, \"max\": %" PRIu64 ", "
+                     "\"p50\": %" PRIu64 ", \"p90\": %" PRIu64 ", \"p99\": %" PRIu64 ", \"p999\": %" PRIu64 ", \"buckets\": [",
+                     op == 0 ? "" : ",", gTree_latOpMsg[op], summary->cnt,
+                     summary->cnt ? (double)summary->sum / (double)summary->cnt : 0.0, summary->max,
+                     gTree_latencyPercentile(summary, 0.5),  gTree_latencyPercentile(summary, 0.9),
+                     gTree_latencyPercentile(summary, 0.99), gTree_latencyPercentile(summary, 0.999));
+        bool first = true;
+        for (size_t b = 0; b < GTREE_LAT_BUCKETS; ++b) {
+            if (summary->buckets[b] == 0)
+                continue;
+            fprintf(out, "%s[%" PRIu64 ", %" PRIu64 "]", first ? "" : ", ", gTree_latencyBucketLow(b), summary->buckets[b]);
+            first = false;
+        }
+        fprintf(out, "]}");
     }
+    fprintf(out, "\n\t}\n}\n");
+    free(summary);
+    return gTree_status_OK;
+    #else
+    return gTree_status_BadMode;
+    #endif
+}
+
+
+/**
+ * @brief registers observer of the tree mutations (must not race with mutations)
+ * @param tree pointer to structure
+ * @param func observer called with the events of each public call
+ * @param arg argument to pass to the observer
+ * @return gTree status code (BadMode if GTREE_OBSERVERS is not defined)
+ */
+static gTree_status gTree_addObserver(gTree *tree, gTree_ObserverFunc func, void *arg)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+    GTREE_ASSERT_LOG(func != NULL, gTree_status_BadData, tree->logStream);
 
+    #ifdef GTREE_OBSERVERS
+    GTREE_ASSERT_LOG(tree->observerCnt < GTREE_MAX_OBSERVERS, gTree_status_BadCapacity, tree->logStream);
+    tree->observers[tree->observerCnt].func = func;
+    tree->observers[tree->observerCnt].arg  = arg;
+    ++tree->observerCnt;
     return gTree_status_OK;
+    #else
+    (void)func;
+    (void)arg;
+    return gTree_status_BadMode;
+    #endif
+}
+
+
+/**
+ * @brief unregisters observer added with the same function and argument
+ * @param tree pointer to structure
+ * @param func observer function
+ * @param arg observer argument
+ * @return gTree status code (BadId if there is no such observer, BadMode if GTREE_OBSERVERS is not defined)
+ */
+static gTree_status gTree_removeObserver(gTree *tree, gTree_ObserverFunc func, void *arg)
+{
+    GTREE_ASSERT_LOG(gPtrValid(tree), gTree_status_BadStructPtr, stderr);
+
+    #ifdef GTREE_OBSERVERS
+    for (size_t i = 0; i < tree->observerCnt; ++i) {
+        if (tree->observers[i].func == func && tree->observers[i].arg == arg) {
+            memmove(&tree->observers[i], &tree->observers[i + 1], (tree->observerCnt - i - 1) * sizeof(gTree_Observer));
+            --tree->observerCnt;
+            return gTree_status_OK;
+        }
+    }
+    return gTree_status_BadId;
+    #else
+    (void)func;
+    (void)arg;
+    return gTree_status_BadMode;
+    #endif
 }
@@ -0,0 +1,475 @@
+typedef int GTREE_TYPE;
+#define GTREE_VERSIONED
+#define GTREE_COUNTERS
+#define GTREE_LATENCY
+#define GTREE_OBSERVERS
+
+/**
+ * @file Tests of the compile-time opt-in features, test-gtree.cpp covers the default build with all of them compiled out
+ */
+
+#include "gtest/gtest.h"
+#include "gtree-gen.h"
+#include <random>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <string>
+
+std::mt19937 rnd(179);
+
+bool gTree_storeData(int data, size_t level, FILE *out)
+{
+    for (size_t i = 0; i < level; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "%d\n", data);
+    return 0;
+}
+
+bool gTree_restoreData(int *data, FILE *in)
+{
+    char buffer[MAX_BUFFER_LEN] = "";
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1 || sscanf(buffer, "%d", data) != 1)
+        return 1;
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1)
+        return 1;
+    return !consistsOnly(buffer, "]");
+}
+
+bool gTree_printData(int data, FILE *out)
+{
+    fprintf(out, "%d", data);
+    return 0;
+}
+
+static void snapshotPreorder(gTree *tree, const gTree_Snapshot *snap, size_t nodeId, std::vector<int> &out)
+{
+    gTree_Node node = {};
+    EXPECT_FALSE(gTree_snapshotNode(tree, snap, nodeId, &node));
+    out.push_back(node.data);
+    for (size_t childId = node.child; childId != -1; ) {
+        snapshotPreorder(tree, snap, childId, out);
+        EXPECT_FALSE(gTree_snapshotNode(tree, snap, childId, &node));
+        childId = node.sibling;
+    }
+}
+
+static size_t countVersions(const gTree *tree)
+{
+    size_t cnt = 0;
+    for (size_t i = 0; i < tree->verCnt; ++i)
+        cnt += (tree->vers[i].owner != -1);
+    return cnt;
+}
+
+TEST(Manual, snapshots)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+
+    size_t id = 0;
+    for (size_t i = 1; i < 100; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, rnd() % i, &id, i));
+
+    gTree_Snapshot first;
+    EXPECT_FALSE(gTree_snapshot(tree, &first));
+    std::vector<int> before;
+    snapshotPreorder(tree, &first, first.root, before);
+
+    EXPECT_FALSE(gTree_setData(tree, 5, -5));
+    EXPECT_FALSE(gTree_delSubtree(tree, 7));
+    EXPECT_FALSE(gTree_delChild(tree, 0, 0, NULL));
+    for (size_t i = 0; i < 50; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, 3, &id, 1000 + i));
+
+    gTree_Snapshot second;
+    EXPECT_FALSE(gTree_snapshot(tree, &second));
+    std::vector<int> middle;
+    snapshotPreorder(tree, &second, second.root, middle);
+    EXPECT_FALSE(gTree_delSubtree(tree, 3));
+
+    std::vector<int> after;
+    snapshotPreorder(tree, &first, first.root, after);
+    EXPECT_EQ(before, after);
+    EXPECT_FALSE(gTree_snapshotRelease(tree, &first));
+
+    after.clear();
+    snapshotPreorder(tree, &second, second.root, after);
+    EXPECT_EQ(middle, after);
+    /* the slot is held for the snapshot, but the node is deleted */
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, 3));
+    EXPECT_EQ(gTree_addChild(tree, 3, &id, 1), gTree_status_BadId);
+    EXPECT_EQ(gTree_setData(tree, 3, 1), gTree_status_BadId);
+    gTree_Node node;
+    EXPECT_FALSE(gTree_snapshotNode(tree, &second, 3, &node));
+    EXPECT_FALSE(gTree_snapshotRelease(tree, &second));
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, 3));
+    EXPECT_EQ(gTree_snapshotNode(tree, &second, 3, &node), gTree_status_BadId);     // the slot is free now
+    EXPECT_EQ(countVersions(tree), 0);
+    gTree_VerifyReport report;
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.orphans, 0);
+    EXPECT_EQ(report.badId, -1);
+
+    /* states written after both snapshots are listed by the newer one and handed to the older one on its release */
+    gTree_Snapshot older, newer;
+    EXPECT_FALSE(gTree_snapshot(tree, &older));
+    before.clear();
+    snapshotPreorder(tree, &older, older.root, before);
+    EXPECT_FALSE(gTree_snapshot(tree, &newer));
+    size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child;
+    EXPECT_FALSE(gTree_setData(tree, tree->root, -1));
+    EXPECT_FALSE(gTree_delSubtree(tree, childId));
+    EXPECT_NE(countVersions(tree), 0);
+    EXPECT_FALSE(gTree_snapshotRelease(tree, &newer));
+    EXPECT_NE(countVersions(tree), 0);
+    after.clear();
+    snapshotPreorder(tree, &older, older.root, after);
+    EXPECT_EQ(before, after);
+    EXPECT_FALSE(gTree_snapshotRelease(tree, &older));
+    EXPECT_EQ(countVersions(tree), 0);
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, childId));
+    EXPECT_EQ(gTree_snapshotRelease(tree, &older), gTree_status_BadSnapshot);
+
+    /* deferred deletes keep the subtree readable through the snapshot until it is collected and released */
+    size_t subRoot = -1;
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &subRoot, 7));
+    for (size_t i = 0; i < 20; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, subRoot, &id, i));
+    gTree_Snapshot deferred;
+    EXPECT_FALSE(gTree_snapshot(tree, &deferred));
+    before.clear();
+    snapshotPreorder(tree, &deferred, deferred.root, before);
+    EXPECT_FALSE(gTree_delSubtreeDeferred(tree, subRoot));
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, subRoot));
+    EXPECT_FALSE(gTree_snapshotNode(tree, &deferred, subRoot, &node));
+    EXPECT_EQ(node.data, 7);
+    after.clear();
+    snapshotPreorder(tree, &deferred, deferred.root, after);
+    EXPECT_EQ(before, after);
+    EXPECT_FALSE(gTree_collectDeferred(tree, 5, NULL));
+    after.clear();
+    snapshotPreorder(tree, &deferred, deferred.root, after);
+    EXPECT_EQ(before, after);
+    EXPECT_FALSE(gTree_collectDeferred(tree, -1, NULL));
+    EXPECT_FALSE(gTree_snapshotNode(tree, &deferred, id, &node));
+    EXPECT_EQ(node.data, 19);
+    after.clear();
+    snapshotPreorder(tree, &deferred, deferred.root, after);
+    EXPECT_EQ(before, after);
+    EXPECT_FALSE(gTree_snapshotRelease(tree, &deferred));
+    EXPECT_EQ(countVersions(tree), 0);
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.orphans, 0);
+    EXPECT_EQ(report.badId, -1);
+    EXPECT_EQ(tree->deadCnt, 0);
+
+    /* in the concurrent mode snapshots are taken and released in the writer section, reads see the point-in-time view */
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    gTree_Snapshot shared;
+    EXPECT_FALSE(gTree_snapshot(tree, &shared));
+    before.clear();
+    snapshotPreorder(tree, &shared, shared.root, before);
+    std::atomic<bool> done(false);
+    std::atomic<size_t> reads(0), torn(0);
+    std::thread reader([&]() {
+        while (!done) {
+            std::vector<int> seen;
+            snapshotPreorder(tree, &shared, shared.root, seen);
+            torn += (seen != before);
+            ++reads;
+        }
+    });
+    while (reads == 0)
+        std::this_thread::yield();
+    for (size_t i = 0; i < 100; ++i) {
+        gTree_writeLock(tree);
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, 2000 + i));
+        EXPECT_FALSE(gTree_setData(tree, tree->root, -(int)i));
+        gTree_Snapshot inner;
+        EXPECT_FALSE(gTree_snapshot(tree, &inner));
+        EXPECT_FALSE(gTree_snapshotRelease(tree, &inner));
+        gTree_writeUnlock(tree);
+    }
+    done = true;
+    reader.join();
+    EXPECT_EQ(torn, 0);
+    EXPECT_FALSE(gTree_snapshotRelease(tree, &shared));
+    EXPECT_EQ(countVersions(tree), 0);
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, counters)
+{
+    gTree tree_struct;
+    gTree *tree = &tree_struct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    gTree_Counters counters = {};
+    EXPECT_FALSE(gTree_getCounters(tree, &counters));
+    EXPECT_EQ(counters.siblingHops, 0);
+
+    const size_t n = 200;
+    gTree_GenParams params = {};
+    params.shape = gTree_gen_Chain;
+    params.nodeCnt = n;
+    EXPECT_FALSE(gTree_resetCounters(tree));
+    EXPECT_FALSE(gTree_generate(tree, tree->root, &params, NULL));
+    EXPECT_FALSE(gTree_getCounters(tree, &counters));
+    EXPECT_EQ(counters.poolAllocs, n - 1);
+    EXPECT_GE(counters.poolGets, n - 1);
+
+    FILE *file = tmpfile();
+    EXPECT_FALSE(gTree_storeSubTree(tree, tree->root, 0, file));
+    EXPECT_FALSE(gTree_getCounters(tree, &counters));
+    EXPECT_EQ(counters.storeBytes, ftell(file));
+    EXPECT_EQ(counters.maxDepth, n);
+
+    rewind(file);
+    gTree restored;
+    EXPECT_FALSE(gTree_restoreTree(&restored, NULL, file));
+    gTree_Counters restoredCounters = {};
+    EXPECT_FALSE(gTree_getCounters(&restored, &restoredCounters));
+    EXPECT_EQ(restoredCounters.restoreBytes + strlen("{\n"), counters.storeBytes);
+    EXPECT_EQ(restoredCounters.maxDepth, n);
+    fclose(file);
+    EXPECT_FALSE(gTree_dtor(&restored));
+
+    EXPECT_FALSE(gTree_resetCounters(tree));
+    EXPECT_FALSE(gTree_delSubtree(tree, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child));
+    EXPECT_FALSE(gTree_getCounters(tree, &counters));
+    EXPECT_EQ(counters.poolFrees, n - 1);
+    EXPECT_EQ(counters.maxDepth, 0);              // killSubtree walks by parent links
+    EXPECT_EQ(counters.siblingHops, 0);
+
+    params.shape = gTree_gen_Star;
+    std::vector<size_t> ids(n);
+    EXPECT_FALSE(gTree_generate(tree, tree->root, &params, ids.data()));
+    EXPECT_FALSE(gTree_resetCounters(tree));
+    EXPECT_FALSE(gTree_delChild(tree, tree->root, 10, NULL));
+    EXPECT_FALSE(gTree_getCounters(tree, &counters));
+    EXPECT_EQ(counters.siblingHops, 10);
+
+    EXPECT_FALSE(gTree_resetCounters(tree));
+    EXPECT_FALSE(gTree_delSubtree(tree, ids[n - 1]));         // position n - 3 after the deletion above
+    EXPECT_FALSE(gTree_getCounters(tree, &counters));
+    EXPECT_EQ(counters.siblingHops, n - 4);
+
+    size_t replaceId = -1;
+    EXPECT_FALSE(gTree_addChild(tree, ids[1], &replaceId, 0));
+    EXPECT_FALSE(gTree_unlinkNode(tree, replaceId));
+    EXPECT_FALSE(gTree_resetCounters(tree));
+    EXPECT_FALSE(gTree_replaceNode(tree, ids[n - 2], replaceId));   // now the last one at position n - 4
+    EXPECT_FALSE(gTree_getCounters(tree, &counters));
+    EXPECT_EQ(counters.siblingHops, n - 5);
+    EXPECT_FALSE(gTree_delSubtree(tree, ids[n - 2]));
+
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, latency)
+{
+    for (uint64_t value : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull}) {
+        size_t bucket = gTree_latencyBucket(value);
+        EXPECT_LT(bucket, GTREE_LAT_BUCKETS);
+        EXPECT_LE(gTree_latencyBucketLow(bucket), value);
+        if (bucket + 1 < GTREE_LAT_BUCKETS) {
+            EXPECT_GT(gTree_latencyBucketLow(bucket + 1), value);
+        }
+    }
+
+    gTree tree_struct;
+    gTree *tree = &tree_struct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+
+    const size_t threadCnt = 4, perThread = 5000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCnt; ++t)
+        threads.emplace_back([tree]() {
+            size_t id = -1;
+            for (size_t i = 0; i < perThread; ++i)
+                EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, i));
+        });
+    for (auto &thread : threads)
+        thread.join();
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+
+    gTree_LatencySummary summary = {};
+    EXPECT_FALSE(gTree_latencySummary(tree, gTree_lat_AddChild, &summary));
+    EXPECT_EQ(summary.cnt, threadCnt * perThread);
+    EXPECT_LE(gTree_latencyPercentile(&summary, 0.5), gTree_latencyPercentile(&summary, 0.99));
+    EXPECT_LE(gTree_latencyPercentile(&summary, 0.99), summary.max);
+    EXPECT_FALSE(gTree_latencySummary(tree, gTree_lat_AddExistChild, &summary));
+    EXPECT_EQ(summary.cnt, 0);                      // nested in addChild
+
+    EXPECT_FALSE(gTree_delSubtree(tree, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child));
+    EXPECT_FALSE(gTree_latencySummary(tree, gTree_lat_DelSubtree, &summary));
+    EXPECT_EQ(summary.cnt, 1);
+    EXPECT_FALSE(gTree_latencySummary(tree, gTree_lat_KillSubtree, &summary));
+    EXPECT_EQ(summary.cnt, 0);
+
+    FILE *file = tmpfile();
+    EXPECT_FALSE(gTree_dumpLatencyJson(tree, file));
+    size_t len = ftell(file);
+    rewind(file);
+    std::string json(len, '\0');
+    EXPECT_EQ(fread(&json[0], 1, len, file), len);
+    fclose(file);
+    EXPECT_NE(json.find("\"addChild\": {\"count\": 20000"), std::string::npos);
+    EXPECT_NE(json.find("\"unit\": \""), std::string::npos);
+    EXPECT_EQ(std::count(json.begin(), json.end(), '{'), std::count(json.begin(), json.end(), '}'));
+    EXPECT_EQ(std::count(json.begin(), json.end(), '['), std::count(json.begin(), json.end(), ']'));
+
+    size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child;
+    int data = 0;
+    EXPECT_FALSE(gTree_setData(tree, childId, 5));
+    EXPECT_FALSE(gTree_getData(tree, childId, &data));
+    EXPECT_FALSE(gTree_latencySummary(tree, gTree_lat_GetData, &summary));
+    EXPECT_EQ(summary.cnt, 1);
+    EXPECT_FALSE(gTree_latencySummary(tree, gTree_lat_SetData, &summary));
+    EXPECT_EQ(summary.cnt, 1);
+
+    EXPECT_FALSE(gTree_resetLatency(tree));
+    EXPECT_FALSE(gTree_latencySummary(tree, gTree_lat_AddChild, &summary));
+    EXPECT_EQ(summary.cnt, 0);
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+struct ObservedBatches
+{
+    std::vector<std::vector<gTree_Event>> batches;
+};
+
+static void recordEvents(const gTree *, const gTree_Event *events, size_t cnt, void *arg)
+{
+    ((ObservedBatches*)arg)->batches.emplace_back(events, events + cnt);
+}
+
+static int cmpInts(const int *first, const int *second)
+{
+    return (*first > *second) - (*first < *second);
+}
+
+TEST(Auto, observers)
+{
+    gTree tree_struct;
+    gTree *tree = &tree_struct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    ObservedBatches seen;
+    EXPECT_FALSE(gTree_addObserver(tree, recordEvents, &seen));
+
+    size_t a = -1, b = -1, c = -1, d = -1;
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &a, 1));
+    EXPECT_FALSE(gTree_addChild(tree, a, &b, 2));
+    EXPECT_FALSE(gTree_addChild(tree, a, &c, 3));
+    EXPECT_FALSE(gTree_addSibling(tree, a, &d, 4));
+    ASSERT_EQ(seen.batches.size(), 4);
+    EXPECT_EQ(seen.batches[0].size(), 1);
+    EXPECT_EQ(seen.batches[0][0].type, gTree_ev_Insert);
+    EXPECT_EQ(seen.batches[0][0].id, a);
+    EXPECT_EQ(seen.batches[0][0].parent, tree->root);
+    EXPECT_EQ(seen.batches[3][0].parent, tree->root);
+
+    seen.batches.clear();
+    int data = 0;
+    EXPECT_FALSE(gTree_delChild(tree, tree->root, 0, &data));       // lifts b and c
+    ASSERT_EQ(seen.batches.size(), 1);
+    ASSERT_EQ(seen.batches[0].size(), 3);
+    EXPECT_EQ(seen.batches[0][0].type, gTree_ev_Move);
+    EXPECT_EQ(seen.batches[0][1].type, gTree_ev_Move);
+    EXPECT_EQ(seen.batches[0][2].type, gTree_ev_Delete);
+    EXPECT_EQ(seen.batches[0][2].id, a);
+    EXPECT_EQ(seen.batches[0][2].data, 1);
+
+    seen.batches.clear();
+    EXPECT_FALSE(gTree_setData(tree, b, 20));
+    size_t e = -1, f = -1;
+    EXPECT_FALSE(gTree_addChild(tree, b, &e, 5));
+    EXPECT_FALSE(gTree_addChild(tree, e, &f, 6));
+    EXPECT_FALSE(gTree_delSubtree(tree, e));
+    ASSERT_EQ(seen.batches.size(), 4);
+    EXPECT_EQ(seen.batches[0][0].type, gTree_ev_Update);
+    ASSERT_EQ(seen.batches[3].size(), 1);
+    EXPECT_EQ(seen.batches[3][0].type, gTree_ev_Kill);
+    EXPECT_EQ(seen.batches[3][0].id, e);
+    EXPECT_EQ(seen.batches[3][0].parent, b);
+
+    seen.batches.clear();
+    std::vector<gTree_Op> ops(100);
+    for (size_t i = 0; i < ops.size(); ++i)
+        ops[i] = {gTree_op_AddChild, c, 0, (int)i};
+    ops[98] = {gTree_op_SetData, GTREE_OP_REF(0), 0, 7};
+    ops[99] = {gTree_op_Move, d, GTREE_OP_REF(1), 0};
+    std::vector<gTree_OpResult> results(ops.size());
+    EXPECT_FALSE(gTree_applyBatch(tree, ops.data(), ops.size(), results.data()));
+    ASSERT_EQ(seen.batches.size(), 1);          // longer than GTREE_OBSERVE_BATCH, still reported once
+    EXPECT_EQ(seen.batches[0].size(), ops.size());
+    EXPECT_EQ(seen.batches[0][0].type, gTree_ev_Insert);
+    EXPECT_EQ(seen.batches[0][0].id, results[0].id);
+    EXPECT_EQ(seen.batches[0][98].type, gTree_ev_Update);
+    EXPECT_EQ(gTree_eventBatch.spill, nullptr);
+    EXPECT_EQ(seen.batches.back().back().type, gTree_ev_Move);
+    EXPECT_EQ(seen.batches.back().back().id, d);
+    EXPECT_EQ(seen.batches.back().back().parent, results[1].id);
+
+    seen.batches.clear();
+    size_t copy = -1;
+    EXPECT_FALSE(gTree_cloneSubtree(tree, c, &copy));
+    EXPECT_FALSE(gTree_replaceNode(tree, c, copy));
+    ASSERT_EQ(seen.batches.size(), 2);
+    EXPECT_EQ(seen.batches[0].size(), 1);
+    EXPECT_EQ(seen.batches[0][0].type, gTree_ev_Insert);
+    ASSERT_EQ(seen.batches[1].size(), 2);
+    EXPECT_EQ(seen.batches[1][1].id, c);
+    EXPECT_EQ(seen.batches[1][1].parent, -1);
+
+    /* transaction events are reported on commit only */
+    seen.batches.clear();
+    size_t g = -1;
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_setData(tree, b, 30));
+    EXPECT_FALSE(gTree_addChild(tree, b, &g, 8));
+    EXPECT_TRUE(seen.batches.empty());
+    EXPECT_FALSE(gTree_rollback(tree));
+    EXPECT_TRUE(seen.batches.empty());
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_setData(tree, b, 40));
+    EXPECT_FALSE(gTree_addChild(tree, b, &g, 8));
+    EXPECT_TRUE(seen.batches.empty());
+    EXPECT_FALSE(gTree_commit(tree));
+    ASSERT_EQ(seen.batches.size(), 1);
+    ASSERT_EQ(seen.batches[0].size(), 2);
+    EXPECT_EQ(seen.batches[0][0].type, gTree_ev_Update);
+    EXPECT_EQ(seen.batches[0][1].type, gTree_ev_Insert);
+    EXPECT_EQ(seen.batches[0][1].id, g);
+
+    /* sorting reports the children that changed places */
+    size_t kids[3] = {};
+    const int keys[3] = {1, 3, 2};
+    for (size_t i = 0; i < 3; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, g, &kids[i], keys[i]));
+    seen.batches.clear();
+    EXPECT_FALSE(gTree_sortChildren(tree, g, cmpInts));
+    ASSERT_EQ(seen.batches.size(), 1);
+    ASSERT_EQ(seen.batches[0].size(), 2);
+    EXPECT_EQ(seen.batches[0][0].type, gTree_ev_Move);
+    EXPECT_EQ(seen.batches[0][0].id, kids[2]);
+    EXPECT_EQ(seen.batches[0][1].id, kids[1]);
+    EXPECT_EQ(seen.batches[0][1].parent, g);
+    seen.batches.clear();
+    EXPECT_FALSE(gTree_sortSubtree(tree, b, cmpInts, 1));
+    EXPECT_TRUE(seen.batches.empty());
+
+    seen.batches.clear();
+    EXPECT_FALSE(gTree_removeObserver(tree, recordEvents, &seen));
+    EXPECT_EQ(gTree_removeObserver(tree, recordEvents, &seen), gTree_status_BadId);
+    EXPECT_FALSE(gTree_delSubtreeDeferred(tree, copy));
+    EXPECT_FALSE(gTree_collectDeferred(tree, -1, NULL));
+    EXPECT_FALSE(gTree_delSubtree(tree, c));
+    EXPECT_TRUE(seen.batches.empty());
+    EXPECT_FALSE(gTree_dtor(tree));
+}
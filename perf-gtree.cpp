@@ -0,0 +1,254 @@
+typedef int GTREE_TYPE;
+
+#include "gtest/gtest.h"
+#include "gtree-gen.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+bool gTree_storeData(int data, size_t level, FILE *out)
+{
+    for (size_t i = 0; i < level; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "%d\n", data);
+    return 0;
+}
+
+bool gTree_restoreData(int *data, FILE *in)
+{
+    char buffer[MAX_BUFFER_LEN] = "";
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1 || sscanf(buffer, "%d", data) != 1)
+        return 1;
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1)
+        return 1;
+    return !consistsOnly(buffer, "]");
+}
+
+bool gTree_printData(int data, FILE *out)
+{
+    fprintf(out, "%d", data);
+    return 0;
+}
+
+static size_t envSize(const char *name, size_t byDefault)
+{
+    const char *value = getenv(name);
+    return (value != NULL && *value != '\0') ? (size_t)strtod(value, NULL) : byDefault;
+}
+
+static double envReal(const char *name, double byDefault)
+{
+    const char *value = getenv(name);
+    return (value != NULL && *value != '\0') ? strtod(value, NULL) : byDefault;
+}
+
+static const size_t SCALE        = 8;       /// Every operation is timed at n and SCALE * n nodes
+static const double MIN_TIME     = 0.2;     /// Seconds each size is repeated for (the fastest run counts)
+static const size_t MIN_REPEATS  = 9;
+static const double BASE_TIME    = 0.002;   /// Seconds each read pass is repeated for
+static const size_t CHAIN_DEPTH  = 480;     /// Store indents a line per level, so its chains are cut into pieces this deep
+
+static const gTree_GenShape SHAPES[] = {gTree_gen_Chain, gTree_gen_Star, gTree_gen_Recursive};
+
+/**
+ * @brief timings of one run: the operation itself and a plain read pass over the same nodes in the same order,
+ *        the latter tells how much slower memory got at the bigger size, which is not what the gate is about
+ */
+struct PerfRun
+{
+    double sec;
+    double baseSec;
+    size_t units;                   /// Input size the operation is linear in (nodes)
+} typedef PerfRun;
+
+typedef std::function<PerfRun (gTree_GenShape shape, size_t n)> PerfCase;
+
+/**
+ * @brief builds the shape of n nodes, chains deeper than maxDepth are built as maxDepth deep pieces hanging from the root,
+ *        so every line is indented by at most a fixed allowance and the output stays linear in nodes
+ */
+static void buildShape(gTree *tree, gTree_GenShape shape, size_t n, size_t maxDepth = -1)
+{
+    gTree_GenParams params = {};
+    params.shape = shape;
+    params.nodeCnt = n;
+    params.seed = 179;
+    if (shape != gTree_gen_Chain || n <= maxDepth) {
+        ASSERT_FALSE(gTree_generate(tree, tree->root, &params, NULL));
+        return;
+    }
+    for (size_t left = n - 1; left != 0; left -= params.nodeCnt - 1) {
+        params.nodeCnt = std::min(left, maxDepth) + 1;
+        ASSERT_FALSE(gTree_generate(tree, tree->root, &params, NULL));
+    }
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static volatile int sink;
+
+/**
+ * @brief seconds per pass of a read loop, repeated for at least BASE_TIME as one pass over a small tree is too short to time
+ */
+static double timePass(const std::function<int ()> &pass)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t passCnt = 0;
+    do {
+        sink = pass();
+        ++passCnt;
+    } while (secondsSince(start) < BASE_TIME);
+    return secondsSince(start) / passCnt;
+}
+
+static double timePreorder(const gTree *tree, size_t rootId)
+{
+    return timePass([tree, rootId]() {
+        int sum = 0;
+        for (size_t id = rootId; id != -1; id = gTree_nextPreorder(tree, rootId, id))
+            sum += GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->data;
+        return sum;
+    });
+}
+
+/**
+ * @brief the fastest of repeated runs at n and SCALE * n nodes, the sizes take turns so drifts of the machine hit both
+ *        and one-off stalls do not fail the gate
+ */
+static void fastestRuns(const PerfCase &run, gTree_GenShape shape, size_t n, PerfRun *small_out, PerfRun *big_out)
+{
+    PerfRun best[2] = {{1e100, 1e100, 0}, {1e100, 1e100, 0}};
+    double total = 0;
+    for (size_t rep = 0; rep < MIN_REPEATS || total < MIN_TIME; ++rep) {
+        for (size_t big = 0; big < 2; ++big) {
+            PerfRun cur = run(shape, big ? n * SCALE : n);
+            best[big].sec     = std::min(best[big].sec, cur.sec);
+            best[big].baseSec = std::min(best[big].baseSec, cur.baseSec);
+            best[big].units   = cur.units;
+            total += cur.sec;
+        }
+    }
+    *small_out = best[0];
+    *big_out   = best[1];
+}
+
+/**
+ * @brief fails if time grows faster than the linear bound times the margin when the input grows SCALE times;
+ *        the seconds the plain read pass lost to slower memory at the bigger size are allowed on top of it
+ */
+static void checkLinear(const char *name, const PerfCase &run)
+{
+    const size_t n      = envSize("GTREE_PERF_NODES", 2000);
+    const double margin = envReal("GTREE_PERF_MARGIN", 1.5);
+
+    for (gTree_GenShape shape : SHAPES) {
+        PerfRun smallRun = {}, bigRun = {};
+        fastestRuns(run, shape, n, &smallRun, &bigRun);
+
+        double memory = std::max(0.0, bigRun.baseSec - smallRun.baseSec * SCALE) / smallRun.sec;
+        double bound  = (double)bigRun.units / (double)smallRun.units * margin + memory;
+        double ratio  = bigRun.sec / smallRun.sec;
+        printf("[ PERF     ] %-12s %-10s n = %7lu..%-8lu time x%6.2f  bound x%6.2f (memory +%5.2f)\n",
+               name, gTree_genShapeMsg[shape], n, n * SCALE, ratio, bound, memory);
+        EXPECT_LE(ratio, bound) << name << " on " << gTree_genShapeMsg[shape] << " grows faster than linear";
+    }
+}
+
+TEST(Perf, addChild)
+{
+    checkLinear("addChild", [](gTree_GenShape shape, size_t n) {
+        gTree_GenParams params = {};
+        params.shape = shape;
+        params.nodeCnt = n;
+        params.seed = 179;
+        std::vector<size_t> parents(n), ids(n);
+        EXPECT_FALSE(gTree_genParents(&params, parents.data()));
+
+        gTree tree;
+        EXPECT_FALSE(gTree_ctor(&tree, NULL));
+        EXPECT_FALSE(gTree_reserve(&tree, n));     // first touch of fresh pages is not what is gated
+        PerfRun res = {0, 0, n};
+        auto start = std::chrono::steady_clock::now();
+        ids[0] = tree.root;
+        for (size_t i = 1; i < n; ++i)
+            gTree_addChild(&tree, ids[parents[i]], &ids[i], (int)i);
+        res.sec = secondsSince(start);
+
+        res.baseSec = timePass([&]() {     // appending reads the parent, then writes its last child and the node itself
+            for (size_t i = 1; i < n; ++i) {
+                gTree_Node *parent = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, ids[parents[i]]);
+                ++GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, parent->tail)->data;
+                ++GOBJPOOL_VAL_BY_ID_UNSAFE(&tree.pool, ids[i])->data;
+            }
+            return 0;
+        });
+        EXPECT_FALSE(gTree_dtor(&tree));
+        return res;
+    });
+}
+
+TEST(Perf, cloneSubtree)
+{
+    checkLinear("cloneSubtree", [](gTree_GenShape shape, size_t n) {
+        gTree tree;
+        EXPECT_FALSE(gTree_ctor(&tree, NULL));
+        buildShape(&tree, shape, n);
+        EXPECT_FALSE(gTree_reserve(&tree, n));
+        PerfRun res = {0, 0, n};
+        size_t copyId = -1;
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_FALSE(gTree_cloneSubtree(&tree, tree.root, &copyId));
+        res.sec = secondsSince(start);
+        res.baseSec = timePreorder(&tree, tree.root) + timePreorder(&tree, copyId);
+        EXPECT_FALSE(gTree_dtor(&tree));
+        return res;
+    });
+}
+
+TEST(Perf, store)
+{
+    checkLinear("store", [](gTree_GenShape shape, size_t n) {
+        gTree tree;
+        EXPECT_FALSE(gTree_ctor(&tree, NULL));
+        buildShape(&tree, shape, n, CHAIN_DEPTH);
+        FILE *out = tmpfile();
+        PerfRun res = {0, 0, n};
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_FALSE(gTree_storeSubTree(&tree, tree.root, 0, out));
+        fflush(out);
+        res.sec = secondsSince(start);
+        res.baseSec = timePreorder(&tree, tree.root);
+        fclose(out);
+        EXPECT_FALSE(gTree_dtor(&tree));
+        return res;
+    });
+}
+
+TEST(Perf, restore)
+{
+    checkLinear("restore", [](gTree_GenShape shape, size_t n) {
+        gTree tree;
+        EXPECT_FALSE(gTree_ctor(&tree, NULL));
+        buildShape(&tree, shape, n, CHAIN_DEPTH);
+        FILE *file = tmpfile();
+        EXPECT_FALSE(gTree_storeSubTree(&tree, tree.root, 0, file));
+        size_t nodeCnt = tree.nodeCnt;
+        EXPECT_FALSE(gTree_dtor(&tree));
+        PerfRun res = {0, 0, n};
+        rewind(file);
+
+        gTree restored;
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_FALSE(gTree_restoreTree(&restored, NULL, file));
+        res.sec = secondsSince(start);
+        res.baseSec = timePreorder(&restored, restored.root);
+        EXPECT_EQ(restored.nodeCnt, nodeCnt);
+        EXPECT_FALSE(gTree_dtor(&restored));
+        fclose(file);
+        return res;
+    });
+}
@@ -0,0 +1,621 @@
+typedef int GTREE_TYPE;
+
+#include "gtest/gtest.h"
+#include "gtree-gen.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+bool gTree_storeData(int data, size_t level, FILE *out)
+{
+    for (size_t i = 0; i < level; ++i)
+        fprintf(out, "\t");
+    fprintf(out, "%d\n", data);
+    return 0;
+}
+
+bool gTree_restoreData(int *data, FILE *in)
+{
+    char buffer[MAX_BUFFER_LEN] = "";
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1 || sscanf(buffer, "%d", data) != 1)
+        return 1;
+    if (getline(buffer, MAX_BUFFER_LEN, in) == 1)
+        return 1;
+    return !consistsOnly(buffer, "]");
+}
+
+bool gTree_printData(int data, FILE *out)
+{
+    fprintf(out, "%d", data);
+    return 0;
+}
+
+/**
+ * @brief size of the stress run could be set from the environment (1e6 nodes by default, up to 1e8 on big machines)
+ */
+static size_t envSize(const char *name, size_t byDefault)
+{
+    const char *value = getenv(name);
+    return (value != NULL && *value != '\0') ? (size_t)strtod(value, NULL) : byDefault;
+}
+
+/**
+ * @brief wall time and peak RSS of the stress phases
+ */
+struct PhaseLog
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    void done(const char *phase, size_t ops)
+    {
+        auto now = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(now - start).count();
+        struct rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        printf("[ PHASE    ] %-10s %10lu ops %9.3f s %10.0f ops/s  peak RSS %8.1f MiB\n",
+               phase, ops, sec, sec > 0 ? ops / sec : 0.0, usage.ru_maxrss / 1024.0);
+        start = now;
+    }
+};
+
+/**
+ * @brief reference model: child vectors, parents and payloads indexed by pool ids
+ */
+struct Model
+{
+    std::vector<std::vector<size_t>> children;
+    std::vector<size_t> parent;
+    std::vector<int> data;
+    std::vector<char> alive;
+    std::vector<size_t> live;               /// Live non-root ids in arbitrary order
+    std::vector<size_t> livePos;            /// Position of the id in `live`
+    size_t root = -1;
+
+    void reserve(size_t id)
+    {
+        if (id < parent.size())
+            return;
+        size_t cap = std::max(id + 1, parent.size() * 2);
+        children.resize(cap);
+        parent.resize(cap, -1);
+        data.resize(cap, 0);
+        alive.resize(cap, 0);
+        livePos.resize(cap, -1);
+    }
+
+    void add(size_t id, size_t parentId, int value)
+    {
+        reserve(id);
+        alive[id]  = 1;
+        parent[id] = parentId;
+        data[id]   = value;
+        children[id].clear();
+        if (parentId != -1)
+            children[parentId].push_back(id);
+        livePos[id] = live.size();
+        live.push_back(id);
+    }
+
+    void forget(size_t id)
+    {
+        alive[id] = 0;
+        children[id].clear();
+        size_t pos = livePos[id];
+        live[pos] = live.back();
+        livePos[live[pos]] = pos;
+        live.pop_back();
+    }
+
+    void detach(size_t id)
+    {
+        if (parent[id] == -1)
+            return;
+        auto &siblings = children[parent[id]];
+        siblings.erase(std::find(siblings.begin(), siblings.end(), id));
+        parent[id] = -1;
+    }
+
+    void kill(size_t id)
+    {
+        detach(id);
+        std::vector<size_t> stack = {id};
+        while (!stack.empty()) {
+            size_t cur = stack.back();
+            stack.pop_back();
+            stack.insert(stack.end(), children[cur].begin(), children[cur].end());
+            forget(cur);
+        }
+    }
+
+    /**
+     * @brief deletes child number pos of the node, its children are lifted in its place
+     */
+    void lift(size_t parentId, size_t pos)
+    {
+        auto &siblings = children[parentId];
+        size_t id = siblings[pos];
+        std::vector<size_t> lifted = children[id];
+        for (size_t childId : lifted)
+            parent[childId] = parentId;
+        siblings.erase(siblings.begin() + pos);
+        siblings.insert(siblings.begin() + pos, lifted.begin(), lifted.end());
+        children[id].clear();
+        parent[id] = -1;
+        forget(id);
+    }
+
+    void attach(size_t id, size_t parentId, size_t pos)
+    {
+        parent[id] = parentId;
+        children[parentId].insert(children[parentId].begin() + pos, id);
+    }
+
+    size_t position(size_t id) const
+    {
+        const auto &siblings = children[parent[id]];
+        return std::find(siblings.begin(), siblings.end(), id) - siblings.begin();
+    }
+
+    bool isAncestor(size_t ancestorId, size_t id) const
+    {
+        for (; id != -1; id = parent[id])
+            if (id == ancestorId)
+                return true;
+        return false;
+    }
+
+    size_t randomLive(std::mt19937_64 &gen) const
+    {
+        return live[gen() % live.size()];
+    }
+
+    /**
+     * @brief descends from the node to random children until its subtree has at most cap nodes
+     */
+    size_t smallSubtree(size_t id, size_t cap, std::mt19937_64 &gen) const
+    {
+        while (!children[id].empty()) {
+            size_t cnt = 0;
+            std::vector<size_t> stack = {id};
+            while (!stack.empty() && cnt <= cap) {
+                size_t cur = stack.back();
+                stack.pop_back();
+                ++cnt;
+                stack.insert(stack.end(), children[cur].begin(), children[cur].end());
+            }
+            if (cnt <= cap)
+                break;
+            id = children[id][gen() % children[id].size()];
+        }
+        return id;
+    }
+};
+
+static const gTree_Node *nodeOf(const gTree *tree, size_t id)
+{
+    return GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+}
+
+/**
+ * @brief adds copies of the model nodes of a freshly cloned parentless subtree (tree preorder matches model preorder)
+ */
+static void modelClone(Model &model, const gTree *tree, size_t srcId, size_t copyId)
+{
+    std::vector<std::pair<size_t, size_t>> stack = {{srcId, copyId}};
+    model.add(copyId, -1, model.data[srcId]);
+    while (!stack.empty()) {
+        auto [src, copy] = stack.back();
+        stack.pop_back();
+        size_t copyChild = nodeOf(tree, copy)->child;
+        for (size_t srcChild : std::vector<size_t>(model.children[src])) {
+            model.add(copyChild, copy, model.data[srcChild]);
+            stack.push_back({srcChild, copyChild});
+            copyChild = nodeOf(tree, copyChild)->sibling;
+        }
+    }
+}
+
+/**
+ * @brief compares every live node of the model with the tree: allocation, parent, payload, child order and tail
+ * @return number of mismatching nodes
+ */
+static size_t crossCheck(const Model &model, const gTree *tree)
+{
+    size_t bad = 0;
+    std::vector<size_t> ids = model.live;
+    ids.push_back(model.root);
+    for (size_t id : ids) {
+        const gTree_Node *node = nodeOf(tree, id);
+        bool ok = GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, id)->allocated && node->parent == model.parent[id] &&
+                  node->data == model.data[id];
+        size_t childId = node->child;
+        for (size_t expected : model.children[id]) {
+            ok = ok && childId == expected;
+            if (!ok)
+                break;
+            childId = nodeOf(tree, childId)->sibling;
+        }
+        ok = ok && childId == -1;
+        ok = ok && node->tail == (model.children[id].empty() ? -1 : model.children[id].back());
+        if (!ok && bad++ == 0)
+            ADD_FAILURE() << "node " << id << " differs from the reference model";
+    }
+    return bad;
+}
+
+enum StressOp
+{
+    Op_AddChild,
+    Op_AddSibling,
+    Op_Move,
+    Op_DelChild,
+    Op_DelSubtree,
+    Op_KillSubtree,
+    Op_Clone,
+    Op_Replace,
+    Op_SetData,
+    Op_Batch,
+    Op_Txn,
+    Op_DelDeferred,
+    Op_Collect,
+    Op_Sort,
+    Op_Patch,
+    Op_Append,
+    Op_Cnt,
+};
+
+static const unsigned OP_WEIGHTS[Op_Cnt] = {24, 12, 12, 10, 4, 4, 4, 4, 26, 3, 3, 3, 3, 2, 2, 1};
+
+static const size_t MAX_SUBTREE = 256;      /// Subtrees deleted or cloned at once are kept small, so the tree size stays stable
+static const size_t APPENDERS   = 3;        /// Threads appending at once in the concurrent mode
+static const size_t APPEND_CNT  = 16;       /// Children each of them appends
+
+static int cmpInts(const int *first, const int *second)
+{
+    return (*first > *second) - (*first < *second);
+}
+
+/**
+ * @brief one batch of every kind of its ops: two adds referenced by the later ops, a write to the added node,
+ *        a move under it, a lifting delete and a subtree delete, the targets are picked so the ops do not collide
+ */
+static void stressBatch(Model &model, gTree *tree, size_t id, std::mt19937_64 &gen)
+{
+    std::vector<gTree_Op> ops = {
+        {gTree_op_AddChild,   id,              0, (int)(gen() % 1000000)},
+        {gTree_op_AddSibling, GTREE_OP_REF(0), 0, (int)(gen() % 1000000)},
+        {gTree_op_SetData,    GTREE_OP_REF(0), 0, (int)(gen() % 1000000)},
+    };
+    size_t moveId = model.randomLive(gen);
+    if (model.isAncestor(moveId, id))
+        moveId = -1;
+    else
+        ops.push_back({gTree_op_Move, moveId, GTREE_OP_REF(1), 0});
+
+    size_t liftId = model.randomLive(gen);
+    size_t liftParentId = model.parent[liftId];
+    if (liftId == id || liftId == moveId || (moveId != -1 && model.parent[moveId] == liftParentId))
+        liftId = -1;
+    else
+        ops.push_back({gTree_op_DelChild, liftParentId, model.position(liftId), 0});
+
+    size_t cutId = model.smallSubtree(model.randomLive(gen), MAX_SUBTREE, gen);
+    if (model.isAncestor(cutId, id) || cutId == moveId || cutId == liftId)
+        cutId = -1;
+    else
+        ops.push_back({gTree_op_DelSubtree, cutId, 0, 0});
+
+    std::vector<gTree_OpResult> results(ops.size());
+    ASSERT_FALSE(gTree_applyBatch(tree, ops.data(), ops.size(), results.data()));
+    for (const gTree_OpResult &res : results)
+        ASSERT_FALSE(res.status);
+
+    model.add(results[0].id, id, ops[0].data);
+    model.add(results[1].id, id, ops[1].data);
+    model.data[results[0].id] = ops[2].data;
+    if (moveId != -1) {
+        model.detach(moveId);
+        model.attach(moveId, results[1].id, 0);
+    }
+    if (liftId != -1)
+        model.lift(liftParentId, model.position(liftId));
+    if (cutId != -1)
+        model.kill(cutId);
+}
+
+/**
+ * @brief add, write, move and delete in one transaction, which is committed or rolled back at random
+ */
+static void stressTxn(Model &model, gTree *tree, size_t id, std::mt19937_64 &gen)
+{
+    bool commit = gen() % 2;
+    int value  = (int)(gen() % 1000000);
+    int update = (int)(gen() % 1000000);
+    size_t dataId   = model.randomLive(gen);
+    size_t moveId   = model.randomLive(gen);
+    size_t targetId = model.randomLive(gen);
+    if (model.isAncestor(moveId, targetId))
+        targetId = model.root;
+    size_t cutId = model.smallSubtree(model.randomLive(gen), MAX_SUBTREE, gen);
+    bool cut = !model.isAncestor(cutId, targetId);
+
+    size_t newId = -1;
+    ASSERT_FALSE(gTree_beginTxn(tree));
+    ASSERT_FALSE(gTree_addChild(tree, id, &newId, value));
+    ASSERT_FALSE(gTree_setData(tree, dataId, update));
+    ASSERT_FALSE(gTree_unlinkNode(tree, moveId));
+    ASSERT_FALSE(gTree_addExistChild(tree, targetId, moveId));
+    if (cut) {
+        ASSERT_FALSE(gTree_delSubtree(tree, cutId));
+    }
+    if (!commit) {
+        ASSERT_FALSE(gTree_rollback(tree));
+        return;
+    }
+    ASSERT_FALSE(gTree_commit(tree));
+
+    model.add(newId, id, value);
+    model.data[dataId] = update;
+    model.detach(moveId);
+    model.attach(moveId, targetId, model.children[targetId].size());
+    if (cut)
+        model.kill(cutId);
+}
+
+/**
+ * @brief patch of a move, a delete, a write and an insert at the node, which is addressed by its path from the root
+ */
+static void stressPatch(Model &model, gTree *tree, size_t id, std::mt19937_64 &gen)
+{
+    std::vector<size_t> path;
+    for (size_t cur = id; cur != model.root; cur = model.parent[cur])
+        path.push_back(model.position(cur));
+    std::reverse(path.begin(), path.end());
+
+    std::vector<gTree_PatchOp> ops;
+    const auto &kids = model.children[id];
+    if (kids.size() >= 2) {
+        size_t from = gen() % kids.size(), pos = gen() % kids.size();
+        ops.push_back({gTree_patch_Move, 0, path.size(), pos, from, 0});
+        size_t movedId = kids[from];
+        model.detach(movedId);
+        model.attach(movedId, id, pos);
+    }
+    if (!kids.empty()) {
+        size_t pos = gen() % kids.size();
+        ops.push_back({gTree_patch_Delete, 0, path.size(), pos, 0, 0});
+        model.kill(kids[pos]);
+    }
+    int update = (int)(gen() % 1000000), value = (int)(gen() % 1000000);
+    size_t insertPos = gen() % (kids.size() + 1);
+    ops.push_back({gTree_patch_Update, 0, path.size(), 0, 0, update});
+    ops.push_back({gTree_patch_Insert, 0, path.size(), insertPos, 0, value});
+
+    gTree_Patch patch = {ops.data(), ops.size(), ops.size(), path.data(), path.size(), path.size()};
+    ASSERT_FALSE(gTree_applyPatch(tree, &patch));
+
+    model.data[id] = update;
+    size_t newId = nodeOf(tree, id)->child;
+    for (size_t i = 0; i < insertPos; ++i)
+        newId = nodeOf(tree, newId)->sibling;
+    model.add(newId, -1, value);
+    model.attach(newId, id, insertPos);
+}
+
+/**
+ * @brief appends from several threads (the tree is in the concurrent mode), each to its own parent, so the child order is known
+ */
+static void stressAppends(Model &model, gTree *tree, std::mt19937_64 &gen)
+{
+    std::vector<size_t> parents;
+    while (parents.size() < APPENDERS) {
+        size_t parentId = model.randomLive(gen);
+        if (std::find(parents.begin(), parents.end(), parentId) == parents.end())
+            parents.push_back(parentId);
+    }
+
+    std::vector<std::vector<size_t>> added(APPENDERS, std::vector<size_t>(APPEND_CNT, -1));
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < APPENDERS; ++t) {
+        writers.emplace_back([&, t]() {
+            for (size_t i = 0; i < APPEND_CNT; ++i)
+                EXPECT_FALSE(gTree_addChild(tree, parents[t], &added[t][i], (int)(t * APPEND_CNT + i)));
+        });
+    }
+    for (auto &writer : writers)
+        writer.join();
+
+    for (size_t t = 0; t < APPENDERS; ++t)
+        for (size_t i = 0; i < APPEND_CNT; ++i)
+            model.add(added[t][i], parents[t], (int)(t * APPEND_CNT + i));
+}
+
+TEST(Stress, random_interleavings)
+{
+    const size_t nodeCnt    = envSize("GTREE_STRESS_NODES", 1000000);
+    const size_t opCnt      = envSize("GTREE_STRESS_OPS", nodeCnt);
+    const size_t checkCnt   = 4;                        /// Full cross-checks during the mutation phase, each switches the concurrent mode
+    const uint64_t seed     = envSize("GTREE_STRESS_SEED", 179);
+    printf("[ STRESS   ] %lu nodes, %lu ops, seed %lu\n", nodeCnt, opCnt, seed);
+
+    std::mt19937_64 gen(seed);
+    std::discrete_distribution<int> pickOp(OP_WEIGHTS, OP_WEIGHTS + Op_Cnt);
+    PhaseLog log;
+
+    gTree tree_struct;
+    gTree *tree = &tree_struct;
+    ASSERT_FALSE(gTree_ctor(tree, NULL));
+    Model model;
+    model.reserve(tree->root);
+    model.root = tree->root;
+    model.alive[tree->root] = 1;
+
+    {
+        gTree_GenParams params = {};
+        params.shape = gTree_gen_Recursive;
+        params.nodeCnt = nodeCnt;
+        params.seed = seed;
+        params.dataFunc = [](size_t idx, void *) { return (int)idx; };
+        std::vector<size_t> parents(nodeCnt), ids(nodeCnt);
+        ASSERT_FALSE(gTree_genParents(&params, parents.data()));
+        ASSERT_FALSE(gTree_generate(tree, tree->root, &params, ids.data()));
+        for (size_t i = 1; i < nodeCnt; ++i)
+            model.add(ids[i], ids[parents[i]], (int)i);
+    }
+    log.done("build", nodeCnt);
+    ASSERT_EQ(crossCheck(model, tree), 0);
+    log.done("check", nodeCnt);
+
+    size_t applied[Op_Cnt] = {};
+    size_t buried = 0;                                  /// Nodes deleted deferred and not collected yet
+    for (size_t op = 0; op < opCnt; ++op) {
+        StressOp type = (StressOp)pickOp(gen);
+        if ((model.live.size() < 2 && type != Op_AddChild) || (type == Op_Append && !tree->concurrent))
+            type = Op_AddChild;
+        size_t id = model.live.empty() ? model.root : model.randomLive(gen);
+        size_t newId = -1;
+        int value = (int)(gen() % 1000000);
+        if (type == Op_DelSubtree || type == Op_KillSubtree || type == Op_Clone || type == Op_Replace ||
+            type == Op_DelDeferred || type == Op_Patch)
+            id = model.smallSubtree(id, MAX_SUBTREE, gen);
+
+        if (type != Op_Append)                          // a no-op out of the concurrent mode
+            gTree_writeLock(tree);
+        switch (type) {
+            case Op_AddChild:
+                ASSERT_FALSE(gTree_addChild(tree, id, &newId, value));
+                model.add(newId, id, value);
+                break;
+            case Op_AddSibling:
+                ASSERT_FALSE(gTree_addSibling(tree, id, &newId, value));
+                model.add(newId, model.parent[id], value);
+                break;
+            case Op_Move: {
+                size_t targetId = model.randomLive(gen);
+                if (model.isAncestor(id, targetId))
+                    targetId = model.root;
+                ASSERT_FALSE(gTree_unlinkNode(tree, id));
+                ASSERT_FALSE(gTree_addExistChild(tree, targetId, id));
+                model.detach(id);
+                model.parent[id] = targetId;
+                model.children[targetId].push_back(id);
+                break;
+            }
+            case Op_DelChild: {
+                size_t parentId = model.parent[id];
+                size_t pos = model.position(id);
+                int popped = -1;
+                ASSERT_FALSE(gTree_delChild(tree, parentId, pos, &popped));
+                ASSERT_EQ(popped, model.data[id]);
+                model.lift(parentId, pos);
+                break;
+            }
+            case Op_DelSubtree:
+                ASSERT_FALSE(gTree_delSubtree(tree, id));
+                model.kill(id);
+                break;
+            case Op_KillSubtree:
+                ASSERT_FALSE(gTree_unlinkNode(tree, id));
+                ASSERT_FALSE(gTree_killSubtree(tree, id));
+                model.kill(id);
+                break;
+            case Op_Clone:
+                ASSERT_FALSE(gTree_cloneSubtree(tree, id, &newId));
+                modelClone(model, tree, id, newId);
+                id = model.randomLive(gen);
+                if (id == newId || model.isAncestor(newId, id))
+                    id = model.root;
+                ASSERT_FALSE(gTree_addExistChild(tree, id, newId));
+                model.parent[newId] = id;
+                model.children[id].push_back(newId);
+                break;
+            case Op_Replace: {
+                size_t srcId = model.smallSubtree(model.randomLive(gen), MAX_SUBTREE, gen);
+                ASSERT_FALSE(gTree_cloneSubtree(tree, srcId, &newId));
+                modelClone(model, tree, srcId, newId);
+                ASSERT_FALSE(gTree_replaceNode(tree, id, newId));
+                size_t parentId = model.parent[id];
+                auto &siblings = model.children[parentId];
+                *std::find(siblings.begin(), siblings.end(), id) = newId;
+                model.parent[newId] = parentId;
+                model.parent[id] = -1;
+                ASSERT_FALSE(gTree_delSubtree(tree, id));
+                model.kill(id);
+                break;
+            }
+            case Op_SetData:
+                ASSERT_FALSE(gTree_setData(tree, id, value));
+                model.data[id] = value;
+                break;
+            case Op_Batch:
+                ASSERT_NO_FATAL_FAILURE(stressBatch(model, tree, id, gen));
+                break;
+            case Op_Txn:
+                ASSERT_NO_FATAL_FAILURE(stressTxn(model, tree, id, gen));
+                break;
+            case Op_DelDeferred: {
+                size_t liveCnt = model.live.size();
+                ASSERT_FALSE(gTree_delSubtreeDeferred(tree, id));
+                model.kill(id);
+                buried += liveCnt - model.live.size();
+                break;
+            }
+            case Op_Collect: {
+                size_t freed = 0;
+                ASSERT_FALSE(gTree_collectDeferred(tree, MAX_SUBTREE, &freed));
+                ASSERT_LE(freed, buried);
+                buried -= freed;
+                break;
+            }
+            case Op_Sort: {
+                size_t parentId = model.parent[id];
+                ASSERT_FALSE(gTree_sortChildren(tree, parentId, cmpInts));
+                std::stable_sort(model.children[parentId].begin(), model.children[parentId].end(),
+                                 [&model](size_t a, size_t b) { return model.data[a] < model.data[b]; });
+                break;
+            }
+            case Op_Patch:
+                ASSERT_NO_FATAL_FAILURE(stressPatch(model, tree, id, gen));
+                break;
+            case Op_Append:
+                ASSERT_NO_FATAL_FAILURE(stressAppends(model, tree, gen));
+                break;
+            case Op_Cnt:
+            default:
+                break;
+        }
+        if (type != Op_Append)
+            gTree_writeUnlock(tree);
+        ++applied[type];
+
+        if ((op + 1) % (opCnt / checkCnt + 1) == 0) {
+            log.done("mutate", opCnt / checkCnt + 1);
+            ASSERT_EQ(crossCheck(model, tree), 0) << "after op " << op;
+            log.done("check", model.live.size());
+            ASSERT_FALSE(gTree_setConcurrent(tree, !tree->concurrent));
+        }
+    }
+    ASSERT_FALSE(gTree_setConcurrent(tree, false));
+    log.done("mutate", opCnt % (opCnt / checkCnt + 1));
+    ASSERT_EQ(crossCheck(model, tree), 0);
+
+    size_t freed = 0;
+    EXPECT_FALSE(gTree_collectDeferred(tree, -1, &freed));
+    EXPECT_EQ(freed, buried);
+    EXPECT_EQ(tree->graveCnt, 0);
+
+    gTree_VerifyReport report = {};
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.orphans, 0);
+    EXPECT_EQ(report.reachable, model.live.size() + 1);
+    log.done("verify", model.live.size());
+
+    for (int type = 0; type < Op_Cnt; ++type)
+        EXPECT_GT(applied[type], 0) << "op " << type << " was never applied";
+
+    EXPECT_FALSE(gTree_dtor(tree));
+    log.done("teardown", model.live.size());
+}
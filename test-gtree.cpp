@@ -1,8 +1,12 @@
 typedef int GTREE_TYPE;
 
 #include "gtest/gtest.h"
-#include "gtree.h"
+#include "gtree-gen.h"
 #include <random>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 std::mt19937 rnd(179);
 
@@ -114,6 +118,54 @@ TEST(Manual, derivator)
     EXPECT_FALSE(gTree_dtor(tree));
 }
 
+TEST(Manual, hand_linked_tail)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+
+    size_t ids[3] = {};
+    for (size_t i = 0; i < 3; ++i)
+        EXPECT_FALSE(gObjPool_alloc(&tree->pool, &ids[i]));
+    for (size_t i = 0; i < 3; ++i) {            // the pool could move on alloc, so nodes are got after the last one
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[i]);
+        node->data    = (int)i;
+        node->parent  = (i == 0) ? -1 : ids[0];
+        node->child   = -1;
+        node->sibling = -1;
+    }
+    GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[0])->child   = ids[1];
+    GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[1])->sibling = ids[2];
+    GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[0])->tail    = ids[1];     // stale: the first child, not the last one
+
+    size_t c = -1, d = -1;
+    EXPECT_FALSE(gTree_addChild(tree, ids[0], &c, 3));
+    EXPECT_FALSE(gTree_addSibling(tree, ids[1], &d, 4));
+    std::vector<size_t> children;
+    for (size_t id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[0])->child; id != -1; id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->sibling)
+        children.push_back(id);
+    EXPECT_EQ(children, std::vector<size_t>({ids[1], ids[2], c, d}));
+    EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[0])->tail, d);
+
+    /* the lock-free append of the concurrent mode must not follow a tail naming a child of another node */
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    EXPECT_FALSE(gTree_reserve(tree, 10));
+    size_t e = -1, f = -1;
+    EXPECT_FALSE(gTree_addChild(tree, ids[2], &e, 5));
+    GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[2])->tail = c;
+    EXPECT_FALSE(gTree_addChild(tree, ids[2], &f, 6));
+    children.clear();
+    for (size_t id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[2])->child; id != -1; id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->sibling)
+        children.push_back(id);
+    EXPECT_EQ(children, std::vector<size_t>({e, f}));
+    EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, ids[2])->tail, f);
+    EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, d)->sibling, -1);
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+
+    EXPECT_FALSE(gTree_delSubtree(tree, ids[0]));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
 TEST(Manual, fill_store_restore)
 {
     gTree treeStruct;
@@ -196,3 +248,1301 @@ TEST(Auto, massive_random_filling)
 
     EXPECT_FALSE(gTree_dtor(tree));
 }
+
+static int randomData(size_t, void *gen)
+{
+    return (*(std::mt19937*)gen)() % 100;
+}
+
+static void randomFill(gTree *tree, size_t n, std::mt19937 &gen)
+{
+    gTree_GenParams params = {};
+    params.shape = gTree_gen_Recursive;
+    params.nodeCnt = n;
+    params.seed = gen();
+    params.dataFunc = randomData;
+    params.dataArg = &gen;
+    EXPECT_FALSE(gTree_generate(tree, tree->root, &params, NULL));
+}
+
+static std::vector<std::pair<int, size_t>> preorderShape(gTree *tree)
+{
+    std::vector<std::pair<int, size_t>> shape;
+    for (size_t id = tree->root; id != -1; id = gTree_nextPreorder(tree, tree->root, id)) {
+        size_t childCnt = 0;
+        for (size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->child; childId != -1;
+                            childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling)
+            ++childCnt;
+        shape.push_back({GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->data, childCnt});
+    }
+    return shape;
+}
+
+TEST(Auto, diff_patch)
+{
+    gTree a, b;
+    EXPECT_FALSE(gTree_ctor(&a, NULL));
+    EXPECT_FALSE(gTree_ctor(&b, NULL));
+    std::mt19937 genA(57), genB(57);
+    randomFill(&a, 1000, genA);
+    randomFill(&b, 1000, genB);
+
+    gTree_Patch patch;
+    EXPECT_FALSE(gTree_patchCtor(&patch));
+    EXPECT_FALSE(gTree_diff(&a, &b, &patch, NULL));
+    EXPECT_EQ(patch.opCnt, 0);
+
+    size_t id = 0;
+    EXPECT_FALSE(gTree_setData(&b, 10, 12345));
+    EXPECT_FALSE(gTree_delSubtree(&b, 20));
+    EXPECT_FALSE(gTree_addChild(&b, 30, &id, 777));
+    EXPECT_FALSE(gTree_addChild(&b, id, &id, 778));
+    size_t moved = 0;
+    EXPECT_FALSE(gTree_unlinkChildAt(&b, 0, 0, &moved));
+    EXPECT_FALSE(gTree_linkChildAt(&b, 0, 1, moved));
+
+    EXPECT_FALSE(gTree_diff(&a, &b, &patch, NULL));
+    EXPECT_GT(patch.opCnt, 0);
+    EXPECT_LT(patch.opCnt, 100);
+    EXPECT_NE(preorderShape(&a), preorderShape(&b));
+    EXPECT_FALSE(gTree_applyPatch(&a, &patch));
+    EXPECT_FALSE(gTree_patchDtor(&patch));
+    EXPECT_EQ(preorderShape(&a), preorderShape(&b));
+
+    EXPECT_FALSE(gTree_diff(&a, &b, &patch, NULL));
+    EXPECT_EQ(patch.opCnt, 0);
+    EXPECT_FALSE(gTree_patchDtor(&patch));
+
+    EXPECT_FALSE(gTree_dtor(&a));
+    EXPECT_FALSE(gTree_dtor(&b));
+
+    EXPECT_FALSE(gTree_ctor(&a, NULL));         // wide shuffled star and a deep chain
+    EXPECT_FALSE(gTree_ctor(&b, NULL));
+    std::vector<int> order(5000);
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    for (int data : order)
+        EXPECT_FALSE(gTree_addChild(&a, a.root, &id, data));
+    std::shuffle(order.begin(), order.end(), genB);
+    for (int data : order) {
+        if (data % 7 != 0) {
+            EXPECT_FALSE(gTree_addChild(&b, b.root, &id, data % 11 ? data : -data));
+        }
+    }
+    size_t aId = a.root, bId = b.root;
+    for (size_t i = 0; i < 100000; ++i) {
+        EXPECT_FALSE(gTree_addChild(&a, aId, &aId, i));
+        EXPECT_FALSE(gTree_addChild(&b, bId, &bId, i));
+    }
+    EXPECT_FALSE(gTree_addChild(&b, bId, &bId, -1));
+
+    EXPECT_FALSE(gTree_diff(&a, &b, &patch, NULL));
+    EXPECT_FALSE(gTree_applyPatch(&a, &patch));
+    EXPECT_FALSE(gTree_patchDtor(&patch));
+    EXPECT_EQ(preorderShape(&a), preorderShape(&b));
+    EXPECT_FALSE(gTree_diff(&a, &b, &patch, NULL));
+    EXPECT_EQ(patch.opCnt, 0);
+    EXPECT_FALSE(gTree_patchDtor(&patch));
+
+    EXPECT_FALSE(gTree_dtor(&a));
+    EXPECT_FALSE(gTree_dtor(&b));
+}
+
+static uint64_t collidingKey(const int *data)
+{
+    if (*data == 1)                             // gTree_hashMix(key, 0) of these two keys is equal
+        return 2455408162131167204ull;
+    if (*data == 2)
+        return 12350937992632313342ull;
+    return *data;
+}
+
+static uint64_t parityKey(const int *data)
+{
+    return *data % 2;
+}
+
+static int cmpLastDigit(const int *first, const int *second)
+{
+    return *first % 10 - *second % 10;
+}
+
+TEST(Auto, canonical_form)
+{
+    gTree a, b;
+    EXPECT_FALSE(gTree_ctor(&a, NULL));
+    EXPECT_FALSE(gTree_ctor(&b, NULL));
+    std::mt19937 genA(53), genB(53);
+    randomFill(&a, 500, genA);
+    randomFill(&b, 500, genB);
+
+    /* reverse children of every node of b */
+    for (size_t id = 0; id < 500; ++id) {
+        size_t cnt = 0;
+        for (size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&b.pool, id)->child; childId != -1;
+                            childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&b.pool, childId)->sibling)
+            ++cnt;
+        for (size_t i = 1; i < cnt; ++i) {
+            size_t moved = 0;
+            EXPECT_FALSE(gTree_unlinkChildAt(&b, id, i, &moved));
+            EXPECT_FALSE(gTree_linkChildAt(&b, id, 0, moved));
+        }
+    }
+
+    uint64_t hashA = 0, hashB = 0;
+    EXPECT_FALSE(gTree_canonicalHash(&a, a.root, gTree_canon_Unordered, NULL, &hashA));
+    EXPECT_FALSE(gTree_canonicalHash(&b, b.root, gTree_canon_Unordered, NULL, &hashB));
+    EXPECT_EQ(hashA, hashB);
+    EXPECT_FALSE(gTree_canonicalHash(&b, b.root, gTree_canon_Ordered, NULL, &hashB));
+    EXPECT_NE(hashA, hashB);
+
+    bool iso = false;
+    EXPECT_FALSE(gTree_isomorphic(&a, a.root, &b, b.root, gTree_canon_Unordered, NULL, NULL, &iso));
+    EXPECT_TRUE(iso);
+    EXPECT_FALSE(gTree_isomorphic(&a, a.root, &b, b.root, gTree_canon_Ordered, NULL, NULL, &iso));
+    EXPECT_FALSE(iso);
+
+    EXPECT_FALSE(gTree_canonicalHash(&a, 7, gTree_canon_Unordered, NULL, &hashA));
+    EXPECT_FALSE(gTree_canonicalHash(&b, 7, gTree_canon_Unordered, NULL, &hashB));
+    EXPECT_EQ(hashA, hashB);
+    EXPECT_FALSE(gTree_isomorphic(&a, 7, &b, 7, gTree_canon_Unordered, NULL, NULL, &iso));
+    EXPECT_TRUE(iso);
+
+    EXPECT_FALSE(gTree_setData(&b, 100, -1));
+    EXPECT_FALSE(gTree_isomorphic(&a, a.root, &b, b.root, gTree_canon_Unordered, NULL, NULL, &iso));
+    EXPECT_FALSE(iso);
+
+    /* wide stars with equal multisets of leaves */
+    gTree c, d;
+    EXPECT_FALSE(gTree_ctor(&c, NULL));
+    EXPECT_FALSE(gTree_ctor(&d, NULL));
+    std::vector<int> leaves(3000);
+    for (size_t i = 0; i < leaves.size(); ++i)
+        leaves[i] = (int)(i % 97) * 1000003;
+    size_t id = -1;
+    for (int data : leaves)
+        EXPECT_FALSE(gTree_addChild(&c, c.root, &id, data));
+    std::shuffle(leaves.begin(), leaves.end(), genA);
+    for (int data : leaves)
+        EXPECT_FALSE(gTree_addChild(&d, d.root, &id, data));
+    EXPECT_FALSE(gTree_isomorphic(&c, c.root, &d, d.root, gTree_canon_Unordered, NULL, NULL, &iso));
+    EXPECT_TRUE(iso);
+    EXPECT_FALSE(gTree_setData(&d, id, 1));
+    EXPECT_FALSE(gTree_isomorphic(&c, c.root, &d, d.root, gTree_canon_Unordered, NULL, NULL, &iso));
+    EXPECT_FALSE(iso);
+    EXPECT_FALSE(gTree_dtor(&c));
+    EXPECT_FALSE(gTree_dtor(&d));
+
+    /* leaves keyed 1 and 2 collide, so only their encodings could order them */
+    gTree e, f;
+    EXPECT_FALSE(gTree_ctor(&e, NULL));
+    EXPECT_FALSE(gTree_ctor(&f, NULL));
+    for (int data : {1, 2, 1})
+        EXPECT_FALSE(gTree_addChild(&e, e.root, &id, data));
+    for (int data : {2, 1, 1})
+        EXPECT_FALSE(gTree_addChild(&f, f.root, &id, data));
+    EXPECT_FALSE(gTree_canonicalHash(&e, id, gTree_canon_Unordered, collidingKey, &hashA));
+    EXPECT_FALSE(gTree_canonicalHash(&f, GOBJPOOL_VAL_BY_ID_UNSAFE(&f.pool, f.root)->child, gTree_canon_Unordered, collidingKey, &hashB));
+    EXPECT_EQ(hashA, hashB);
+    EXPECT_FALSE(gTree_isomorphic(&e, e.root, &f, f.root, gTree_canon_Unordered, collidingKey, NULL, &iso));
+    EXPECT_TRUE(iso);
+    EXPECT_FALSE(gTree_setData(&f, id, 2));
+    EXPECT_FALSE(gTree_isomorphic(&e, e.root, &f, f.root, gTree_canon_Unordered, collidingKey, NULL, &iso));
+    EXPECT_FALSE(iso);
+    EXPECT_FALSE(gTree_dtor(&e));
+    EXPECT_FALSE(gTree_dtor(&f));
+
+    /* payloads equal by the comparator differ in bytes, a coarser key leaves the order to the comparator */
+    gTree g, h;
+    EXPECT_FALSE(gTree_ctor(&g, NULL));
+    EXPECT_FALSE(gTree_ctor(&h, NULL));
+    size_t subId = -1;
+    EXPECT_FALSE(gTree_addChild(&g, g.root, &subId, 3));
+    EXPECT_FALSE(gTree_addChild(&g, subId, &id, 14));
+    EXPECT_FALSE(gTree_addChild(&g, g.root, &id, 25));
+    EXPECT_FALSE(gTree_addChild(&h, h.root, &id, 15));
+    EXPECT_FALSE(gTree_addChild(&h, h.root, &subId, 23));
+    EXPECT_FALSE(gTree_addChild(&h, subId, &id, 4));
+    EXPECT_FALSE(gTree_isomorphic(&g, g.root, &h, h.root, gTree_canon_Unordered, NULL, NULL, &iso));
+    EXPECT_FALSE(iso);
+    EXPECT_FALSE(gTree_isomorphic(&g, g.root, &h, h.root, gTree_canon_Unordered, NULL, cmpLastDigit, &iso));
+    EXPECT_TRUE(iso);
+    EXPECT_FALSE(gTree_isomorphic(&g, g.root, &h, h.root, gTree_canon_Unordered, parityKey, cmpLastDigit, &iso));
+    EXPECT_TRUE(iso);
+    EXPECT_FALSE(gTree_isomorphic(&g, g.root, &h, h.root, gTree_canon_Ordered, NULL, cmpLastDigit, &iso));
+    EXPECT_FALSE(iso);
+    EXPECT_FALSE(gTree_setData(&h, id, 6));
+    EXPECT_FALSE(gTree_isomorphic(&g, g.root, &h, h.root, gTree_canon_Unordered, parityKey, NULL, &iso));
+    EXPECT_TRUE(iso);                           // the key alone can't tell 14 from 6
+    EXPECT_FALSE(gTree_isomorphic(&g, g.root, &h, h.root, gTree_canon_Unordered, parityKey, cmpLastDigit, &iso));
+    EXPECT_FALSE(iso);
+    EXPECT_FALSE(gTree_isomorphic(&g, g.root, &h, h.root, gTree_canon_Unordered, NULL, cmpLastDigit, &iso));
+    EXPECT_FALSE(iso);
+    EXPECT_FALSE(gTree_dtor(&g));
+    EXPECT_FALSE(gTree_dtor(&h));
+
+    EXPECT_FALSE(gTree_dtor(&a));
+    EXPECT_FALSE(gTree_dtor(&b));
+}
+
+static int cmpTens(const int *first, const int *second)
+{
+    return *first / 10 - *second / 10;
+}
+
+static void checkSorted(gTree *tree, size_t nodeId, size_t *cnt)
+{
+    ++*cnt;
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+    int prev = -1;
+    size_t prevId = 0;
+    for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+        gTree_Node *child = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId);
+        EXPECT_EQ(child->parent, nodeId);
+        EXPECT_LE(prev / 10, child->data / 10);
+        if (prev / 10 == child->data / 10) {
+            EXPECT_LT(prevId, childId);         // children are added in ascending ids, so stable sort keeps them so
+        }
+        prev   = child->data;
+        prevId = childId;
+        checkSorted(tree, childId, cnt);
+    }
+}
+
+TEST(Auto, sort_children)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    std::mt19937 gen(54);
+    randomFill(tree, 3000, gen);
+
+    size_t cnt = 0;
+    EXPECT_FALSE(gTree_sortChildren(tree, tree->root, cmpTens));
+    EXPECT_FALSE(gTree_sortSubtree(tree, tree->root, cmpTens, 4));
+    checkSorted(tree, tree->root, &cnt);
+    EXPECT_EQ(cnt, 3000);
+
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, transactions)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    std::mt19937 gen(55);
+    randomFill(tree, 300, gen);
+
+    uint64_t before = 0, after = 0;
+    EXPECT_FALSE(gTree_canonicalHash(tree, tree->root, gTree_canon_Ordered, NULL, &before));
+
+    size_t id = 0;
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_TRUE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_setData(tree, 7, -7));
+    EXPECT_FALSE(gTree_delSubtree(tree, 12));
+    EXPECT_FALSE(gTree_delChild(tree, 0, 1, NULL));
+    EXPECT_FALSE(gTree_sortSubtree(tree, tree->root, cmpTens, 1));
+    for (size_t i = 0; i < 100; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, gen() % 300 == 12 ? 1 : 3, &id, i));
+    size_t lastAlloc = id;
+    EXPECT_FALSE(gTree_rollback(tree));
+
+    EXPECT_FALSE(gTree_canonicalHash(tree, tree->root, gTree_canon_Ordered, NULL, &after));
+    EXPECT_EQ(before, after);
+    EXPECT_TRUE(gObjPool_idValid(&tree->pool, 12));
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, lastAlloc));
+
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    for (size_t i = 0; i < 100; ++i)            // only the first write saves the node image
+        EXPECT_FALSE(gTree_setData(tree, 7, i));
+    EXPECT_EQ(tree->undoCnt, 1);
+    EXPECT_FALSE(gTree_addChild(tree, 7, &id, 0));
+    EXPECT_FALSE(gTree_setData(tree, id, 1));
+    EXPECT_EQ(tree->undoCnt, 3);                // the parent link and the allocation
+    EXPECT_FALSE(gTree_rollback(tree));
+    EXPECT_FALSE(gTree_canonicalHash(tree, tree->root, gTree_canon_Ordered, NULL, &after));
+    EXPECT_EQ(before, after);
+
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_delSubtree(tree, 12));
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, 12));       // the slot is held until the commit, but ids are checked
+    EXPECT_EQ(gTree_addChild(tree, 12, &id, 0), gTree_status_BadId);
+    EXPECT_EQ(gTree_setData(tree, 12, 0), gTree_status_BadId);
+    gTree_Op op = {gTree_op_AddChild, 12, 0, 0};
+    gTree_OpResult res = {};
+    EXPECT_FALSE(gTree_applyBatch(tree, &op, 1, &res));
+    EXPECT_EQ(res.status, gTree_status_BadId);
+    EXPECT_FALSE(gTree_rollback(tree));         // a rollback brings it back
+    EXPECT_FALSE(gTree_setData(tree, 12, 12));
+    EXPECT_EQ(tree->deadCnt, 0);
+
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_delSubtree(tree, 12));
+    EXPECT_FALSE(gTree_commit(tree));
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, 12));
+    EXPECT_EQ(tree->deadCnt, 0);
+    EXPECT_TRUE(gTree_commit(tree));
+    gTree_VerifyReport report = {};
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.orphans, 0);
+
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, batch)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    std::mt19937 gen(56);
+    randomFill(tree, 100, gen);
+
+    std::vector<gTree_Op> ops = {
+        {gTree_op_AddChild,   0,               0,   1000},
+        {gTree_op_AddChild,   GTREE_OP_REF(0), 0,   1001},
+        {gTree_op_AddSibling, GTREE_OP_REF(1), 0,   1002},
+        {gTree_op_SetData,    5,               0,   -5},
+        {gTree_op_Move,       7,               GTREE_OP_REF(2), 0},
+        {gTree_op_Move,       GTREE_OP_REF(0), GTREE_OP_REF(1), 0},
+        {gTree_op_DelSubtree, 9,               0,   0},
+        {gTree_op_SetData,    9,               0,   0},
+        {gTree_op_DelChild,   GTREE_OP_REF(0), 5,   0},
+        {gTree_op_AddChild,   GTREE_OP_REF(9), 0,   0},
+        {gTree_op_AddChild,   100500,          0,   0},
+        {gTree_op_AddChild,   9,               0,   0},
+    };
+    std::vector<gTree_OpResult> results(ops.size());
+    EXPECT_FALSE(gTree_applyBatch(tree, ops.data(), ops.size(), results.data()));
+
+    EXPECT_EQ(results[0].status, gTree_status_OK);
+    EXPECT_EQ(results[1].status, gTree_status_OK);
+    EXPECT_EQ(results[2].status, gTree_status_OK);
+    EXPECT_EQ(results[3].status, gTree_status_OK);
+    EXPECT_EQ(results[4].status, gTree_status_OK);
+    EXPECT_EQ(results[5].status, gTree_status_BadId);     // would make a cycle
+    EXPECT_EQ(results[6].status, gTree_status_OK);
+    EXPECT_EQ(results[7].status, gTree_status_BadId);     // deleted by the previous op
+    EXPECT_EQ(results[8].status, gTree_status_BadPos);
+    EXPECT_EQ(results[9].status, gTree_status_BadId);
+    EXPECT_EQ(results[10].status, gTree_status_BadId);
+    EXPECT_EQ(results[11].status, gTree_status_BadId);     // its slot was reserved, the node was deleted by op 6
+    EXPECT_EQ(results[11].id, -1);
+
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, results[1].id);
+    EXPECT_EQ(node->parent, results[0].id);
+    EXPECT_EQ(node->sibling, results[2].id);
+    EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, results[2].id)->child, 7);
+    EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, 7)->parent, results[2].id);
+    EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, 5)->data, -5);
+
+    gTree_VerifyReport report = {};             // slots reserved for the failed adds went back to the pool
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.orphans, 0);
+    EXPECT_EQ(report.reachable, tree->nodeCnt);
+
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+static bool countNode(size_t, const gTree_Node *, void *arg)
+{
+    ++*(size_t*)arg;
+    return true;
+}
+
+struct ReentrantVisit
+{
+    gTree *tree;
+    size_t cnt;
+};
+
+static bool countNodeReentrant(size_t id, const gTree_Node *node, void *arg)
+{
+    ReentrantVisit *visit = (ReentrantVisit*)arg;
+    int data = 0;                               // re-enters the read lock while a writer may be waiting for it
+    EXPECT_FALSE(gTree_getData(visit->tree, id, &data));
+    EXPECT_EQ(data, node->data);
+    ++visit->cnt;
+    return true;
+}
+
+TEST(Auto, concurrent_readers)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    std::mt19937 gen(57);
+    randomFill(tree, 1000, gen);
+
+    std::atomic<bool> done(false);
+    std::atomic<size_t> torn(0), reads(0);
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                size_t cnt = 0;
+                EXPECT_FALSE(gTree_traverse(tree, tree->root, countNode, &cnt));
+                if (cnt % 10 != 0)
+                    ++torn;
+                ReentrantVisit visit = {tree, 0};
+                EXPECT_FALSE(gTree_traverse(tree, tree->root, countNodeReentrant, &visit));
+                if (visit.cnt % 10 != 0)
+                    ++torn;
+                int data = 0;
+                EXPECT_FALSE(gTree_getData(tree, 1, &data));
+                ++reads;
+            }
+        });
+    }
+
+    while (reads == 0)
+        std::this_thread::yield();
+
+    std::vector<gTree_Op> ops(10, gTree_Op{gTree_op_AddChild, 0, 0, 0});
+    std::vector<gTree_OpResult> results(ops.size());
+    for (size_t i = 0; i < 200; ++i) {
+        for (auto &op : ops)
+            op.node = gen() % 1000;
+        EXPECT_FALSE(gTree_applyBatch(tree, ops.data(), ops.size(), results.data()));
+        gTree_writeLock(tree);
+        EXPECT_FALSE(gTree_applyBatch(tree, ops.data(), ops.size(), results.data()));
+        int data = 0;
+        EXPECT_FALSE(gTree_getData(tree, results[0].id, &data));     // reads inside the writer section
+        EXPECT_TRUE(gTree_isWriter(tree));
+        gTree_writeUnlock(tree);
+        EXPECT_FALSE(gTree_isWriter(tree));
+    }
+    done = true;
+    for (auto &reader : readers)
+        reader.join();
+
+    EXPECT_EQ(torn, 0);
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+static bool recordVisit(size_t id, const gTree_Node *node, void *arg)
+{
+    ((std::vector<std::pair<size_t, int>>*)arg)->push_back({id, node->data});
+    return true;
+}
+
+TEST(Auto, reserve)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    size_t handIds[20] = {};
+    for (size_t &id : handIds)                  // slots taken by hand count against growth too
+        EXPECT_FALSE(gObjPool_alloc(&tree->pool, &id));
+    EXPECT_FALSE(gTree_setEpochMode(tree, true));
+    EXPECT_EQ(tree->nodeCnt, 21);
+    EXPECT_FALSE(gTree_reserve(tree, 2000));
+    EXPECT_GT(tree->pool.capacity, tree->nodeCnt + 2000);
+    size_t lastId = 0;
+    for (size_t i = 0; i < 100; ++i) {          // the free list keeps its order
+        size_t id = -1;
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, i));
+        EXPECT_GT(id, lastId);
+        lastId = id;
+    }
+    EXPECT_FALSE(gTree_setEpochMode(tree, false));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, epoch_reclamation)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    EXPECT_FALSE(gTree_setEpochMode(tree, true));
+    EXPECT_FALSE(gTree_reserve(tree, 2000));
+    std::mt19937 gen(58);
+
+    /* every node gets a new payload, so a visited slot handed out again before the reader leaves is told by it */
+    std::atomic<bool> done(false);
+    std::atomic<size_t> reused(0), reads(0), rounds(0);
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < 3; ++t) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                size_t slot = -1;
+                EXPECT_FALSE(gTree_epochEnter(tree, &slot));
+                std::vector<std::pair<size_t, int>> seen;
+                EXPECT_FALSE(gTree_epochTraverse(tree, tree->root, recordVisit, &seen));
+                for (size_t start = rounds, k = 0; rounds < start + 2 && !done && k < 100; ++k)
+                    std::this_thread::yield();  // the writer deletes and allocates meanwhile (unless it waits to grow the pool)
+                for (const auto &visit : seen)
+                    reused += (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, visit.first)->data != visit.second);
+                EXPECT_FALSE(gTree_epochExit(tree, slot));
+                ++reads;
+            }
+        });
+    }
+    while (reads == 0)
+        std::this_thread::yield();
+
+    size_t rootChildren = 0;
+    int data = 0;
+    for (size_t i = 0; i < 500; ++i) {
+        size_t subRoot = -1, id = -1;
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &subRoot, ++data));
+        std::vector<size_t> nodes = {subRoot};
+        for (size_t j = 0; j < 50; ++j) {
+            EXPECT_FALSE(gTree_addChild(tree, nodes[gen() % nodes.size()], &id, ++data));
+            nodes.push_back(id);
+        }
+        if (++rootChildren > 5) {
+            EXPECT_FALSE(gTree_delSubtree(tree, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child));
+            --rootChildren;
+            std::this_thread::yield();          // let readers run while the subtree is retired
+        }
+        ++rounds;
+    }
+    done = true;
+    for (auto &reader : readers)
+        reader.join();
+
+    EXPECT_EQ(reused, 0);
+    size_t retired = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child, id = -1;
+    EXPECT_FALSE(gTree_delSubtree(tree, retired));
+    EXPECT_EQ(gTree_addChild(tree, retired, &id, 0), gTree_status_BadId);   // retired, but not released yet
+    EXPECT_FALSE(gTree_reclaim(tree));
+    EXPECT_EQ(tree->limboCnt, 0);
+    EXPECT_EQ(tree->deadCnt, 0);
+    EXPECT_EQ(tree->nodeCnt, 1 + 4 * 51);
+    EXPECT_FALSE(gTree_setEpochMode(tree, false));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+static size_t checkLinks(gTree *tree, size_t rootId)
+{
+    size_t cnt = 0;
+    for (size_t nodeId = rootId; nodeId != -1; nodeId = gTree_nextPreorder(tree, rootId, nodeId)) {
+        size_t lastId = -1;
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+        for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling) {
+            EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->parent, nodeId);
+            lastId = childId;
+        }
+        EXPECT_EQ(node->tail, lastId);
+        ++cnt;
+    }
+    return cnt;
+}
+
+TEST(Auto, concurrent_append)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    EXPECT_FALSE(gTree_reserve(tree, 1000));
+
+    const size_t threadCnt = 4, appendCnt = 5000;
+    std::vector<std::thread> writers;
+    std::vector<std::vector<int>> seen(threadCnt);
+    for (size_t t = 0; t < threadCnt; ++t) {
+        writers.emplace_back([&, t]() {
+            size_t id = -1, own = -1;
+            EXPECT_FALSE(gTree_addChild(tree, tree->root, &own, -1));
+            for (size_t i = 0; i < appendCnt; ++i) {
+                EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, t * appendCnt + i));
+                EXPECT_FALSE(gTree_addChild(tree, own, &id, i));
+            }
+        });
+    }
+    for (auto &writer : writers)
+        writer.join();
+
+    std::vector<int> values;
+    size_t ownCnt = 0;
+    for (size_t id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child; id != -1; id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->sibling) {
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+        if (node->data == -1) {
+            ++ownCnt;
+            int expect = 0;
+            for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling)
+                EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->data, expect++);
+            EXPECT_EQ(expect, appendCnt);
+        } else {
+            values.push_back(node->data);
+        }
+    }
+    EXPECT_EQ(ownCnt, threadCnt);
+    std::sort(values.begin(), values.end());
+    EXPECT_EQ(values.size(), threadCnt * appendCnt);
+    for (size_t i = 0; i < values.size(); ++i)
+        EXPECT_EQ(values[i], i);
+    EXPECT_EQ(checkLinks(tree, tree->root), 1 + threadCnt * (2 * appendCnt + 1));
+
+    std::mt19937 gen(59);
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+    for (size_t i = 0; i < 2000; ++i) {
+        size_t parentId = gen() % tree->pool.capacity;
+        if (!gObjPool_idValid(&tree->pool, parentId) || GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, parentId)->child == -1)
+            continue;
+        size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, parentId)->tail;
+        if (i % 3 == 0) {
+            EXPECT_FALSE(gTree_delChild(tree, parentId, 0, NULL));
+        } else if (i % 3 == 1) {
+            EXPECT_FALSE(gTree_delSubtree(tree, childId));
+        } else {
+            EXPECT_FALSE(gTree_addSibling(tree, childId, &childId, 0));
+        }
+    }
+    checkLinks(tree, tree->root);
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+struct VisitAppend {
+    gTree *tree;
+    size_t cnt;
+    gTree_status status;
+};
+
+static bool appendInVisit(size_t id, const gTree_Node *node, void *arg)
+{
+    VisitAppend *visit = (VisitAppend*)arg;
+    if (node->data <= 0)
+        return true;
+    size_t childId = -1;                        // the visitor holds the read lock, appends must not wait for the write one
+    gTree_status status = gTree_addChild(visit->tree, id, &childId, -node->data);
+    if (status == gTree_status_OK)
+        ++visit->cnt;
+    else
+        visit->status = status;
+    return true;
+}
+
+TEST(Auto, concurrent_append_in_visitor)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    size_t id = -1;
+    for (int data = 1; data <= 10; ++data)
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, data));
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    EXPECT_FALSE(gTree_reserve(tree, 100));
+
+    VisitAppend visit = {tree, 0, gTree_status_OK};
+    EXPECT_FALSE(gTree_traverse(tree, tree->root, appendInVisit, &visit));
+    EXPECT_EQ(visit.cnt, 10);
+    EXPECT_EQ(visit.status, gTree_status_OK);
+    EXPECT_EQ(checkLinks(tree, tree->root), 21);
+
+    /* in transaction the append needs the write lock, so it fails instead of deadlocking */
+    visit = {tree, 0, gTree_status_OK};
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_traverse(tree, tree->root, appendInVisit, &visit));
+    EXPECT_FALSE(gTree_commit(tree));
+    EXPECT_EQ(visit.cnt, 0);
+    EXPECT_EQ(visit.status, gTree_status_BadMode);
+    EXPECT_EQ(checkLinks(tree, tree->root), 21);
+
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, 0));  // out of the reader section it takes the write lock
+    EXPECT_FALSE(gTree_commit(tree));
+    EXPECT_EQ(checkLinks(tree, tree->root), 22);
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+static size_t countAllocated(gTree *tree)
+{
+    size_t cnt = 0;
+    for (size_t i = 0; i < tree->pool.capacity; ++i)
+        cnt += GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, i)->allocated;
+    return cnt;
+}
+
+TEST(Auto, magazines)
+{
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < 4; ++t) {
+        writers.emplace_back([&, t]() {
+            std::mt19937 gen(60 + t);
+            size_t id = -1, own = -1;
+            EXPECT_FALSE(gTree_addChild(tree, tree->root, &own, t));
+            for (size_t i = 0; i < 300; ++i) {
+                for (size_t j = 0; j < 20; ++j)
+                    EXPECT_FALSE(gTree_addChild(tree, own, &id, j));
+                gTree_writeLock(tree);
+                size_t childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, own)->child;
+                EXPECT_FALSE(gTree_addChild(tree, childId, &id, 0));
+                EXPECT_FALSE(gTree_delSubtree(tree, childId));
+                EXPECT_FALSE(gTree_delChild(tree, own, gen() % 5, NULL));
+                gTree_writeUnlock(tree);
+            }
+        });
+    }
+    for (auto &writer : writers)
+        writer.join();
+
+    size_t reachable = checkLinks(tree, tree->root);
+    EXPECT_EQ(reachable, 1 + 4 * (1 + 300 * 18));
+    EXPECT_EQ(countAllocated(tree), reachable);
+    EXPECT_EQ(tree->nodeCnt, reachable);        // the caches of the exited threads went back to the pool
+
+    size_t id = -1;
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, 0));
+    gTree_writeLock(tree);
+    EXPECT_FALSE(gTree_delSubtree(tree, id));
+    gTree_writeUnlock(tree);
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, id));       // cached, but no longer passes the id checks
+    EXPECT_EQ(gTree_setData(tree, id, 1), gTree_status_BadId);
+    EXPECT_EQ(countAllocated(tree), reachable);
+    EXPECT_LE(tree->nodeCnt - reachable, GTREE_MAGAZINE_SIZE);
+
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+    EXPECT_EQ(tree->nodeCnt, reachable);
+    EXPECT_EQ(countAllocated(tree), reachable);
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+static void mapData(size_t, const gTree_Node *node, void *out, void *)
+{
+    *(uint64_t*)out = node->data + 1;
+}
+
+static void combinePoly(void *acc, const void *value, void *)
+{
+    *(uint64_t*)acc = *(uint64_t*)acc * 1000003 + *(const uint64_t*)value;     // not associative nor commutative
+}
+
+static uint64_t reducePoly(gTree *tree, size_t nodeId)
+{
+    gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, nodeId);
+    uint64_t acc = node->data + 1;
+    for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling)
+        acc = acc * 1000003 + reducePoly(tree, childId);
+    return acc;
+}
+
+static bool countAtomic(size_t, const gTree_Node *node, void *arg)
+{
+    ((std::atomic<size_t>*)arg)->fetch_add(node->data + 1);
+    return true;
+}
+
+TEST(Auto, parallel_reduce)
+{
+    std::mt19937 gen(61);
+    gTree wide, chain;
+    EXPECT_FALSE(gTree_ctor(&wide,  NULL));
+    EXPECT_FALSE(gTree_ctor(&chain, NULL));
+    randomFill(&wide, 100000, gen);
+    size_t id = chain.root;
+    for (size_t i = 0; i < 20000; ++i)
+        EXPECT_FALSE(gTree_addChild(&chain, id, &id, i % 7));
+
+    for (gTree *tree : {&wide, &chain}) {
+        uint64_t expected = reducePoly(tree, tree->root);
+        size_t expectedSum = 0;
+        for (size_t i = 0; i < tree->pool.capacity; ++i)
+            if (GOBJPOOL_GET_NODE_UNSAFE(&tree->pool, i)->allocated)
+                expectedSum += GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, i)->data + 1;
+
+        for (size_t nThreads : {1, 2, 4, 8}) {
+            for (size_t grain : {1, 64, 0}) {
+                uint64_t result = 0;
+                EXPECT_FALSE(gTree_parallelReduce(tree, tree->root, sizeof(uint64_t), mapData, combinePoly, NULL, &result, nThreads, grain));
+                EXPECT_EQ(result, expected);
+                size_t leaf = tree->root;         // memory follows the subtree, not the pool
+                while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, leaf)->child != -1)
+                    leaf = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, leaf)->child;
+                size_t sub = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, leaf)->parent;
+                EXPECT_FALSE(gTree_parallelReduce(tree, sub, sizeof(uint64_t), mapData, combinePoly, NULL, &result, nThreads, grain));
+                EXPECT_EQ(result, reducePoly(tree, sub));
+
+                std::atomic<size_t> sum(0);
+                EXPECT_FALSE(gTree_parallelForEach(tree, tree->root, countAtomic, &sum, nThreads, grain));
+                EXPECT_EQ(sum, expectedSum);
+            }
+        }
+    }
+    EXPECT_FALSE(gTree_dtor(&wide));
+    EXPECT_FALSE(gTree_dtor(&chain));
+}
+
+TEST(Auto, parallel_clone)
+{
+    std::mt19937 gen(62);
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    randomFill(tree, 50000, gen);
+    size_t id = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child;
+    for (size_t i = 0; i < 20000; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, id, &id, i));
+
+    for (size_t nThreads : {1, 3, 8}) {
+        size_t cloneId = -1;
+        EXPECT_FALSE(gTree_cloneSubtreeParallel(tree, tree->root, &cloneId, nThreads));
+        EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, cloneId)->parent,  -1);
+        EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, cloneId)->sibling, -1);
+        EXPECT_EQ(checkLinks(tree, cloneId), 70000);
+
+        bool same = false;
+        EXPECT_FALSE(gTree_isomorphic(tree, tree->root, tree, cloneId, gTree_canon_Ordered, NULL, NULL, &same));
+        EXPECT_TRUE(same);
+
+        size_t prevId = cloneId, ascending = 0;
+        for (size_t id = gTree_nextPreorder(tree, cloneId, cloneId); id != -1; id = gTree_nextPreorder(tree, cloneId, id)) {
+            ascending += (id > prevId);
+            prevId = id;
+        }
+        EXPECT_EQ(ascending, 70000 - 1);
+        EXPECT_FALSE(gTree_killSubtree(tree, cloneId));
+    }
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, deferred_delete)
+{
+    std::mt19937 gen(63);
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    randomFill(tree, 20000, gen);
+
+    size_t total = checkLinks(tree, tree->root);
+    size_t nodeCnt = tree->nodeCnt;
+    while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child != -1) {
+        size_t tail = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->tail;
+        EXPECT_FALSE(gTree_delSubtreeDeferred(tree, tail));
+        EXPECT_EQ(GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tail)->parent, -1);
+        EXPECT_EQ(gTree_setData(tree, tail, 1), gTree_status_BadId);
+    }
+    EXPECT_EQ(checkLinks(tree, tree->root), 1);
+    EXPECT_EQ(tree->nodeCnt, nodeCnt);
+
+    size_t freed = 0;
+    EXPECT_FALSE(gTree_collectDeferred(tree, 100, &freed));
+    EXPECT_EQ(freed, 100);
+    EXPECT_EQ(tree->nodeCnt, nodeCnt - 100);
+    EXPECT_FALSE(gTree_collectDeferred(tree, -1, &freed));
+    EXPECT_EQ(freed, total - 1 - 100);
+    EXPECT_EQ(tree->graveCnt, 0);
+    EXPECT_EQ(tree->nodeCnt, 1);
+    EXPECT_EQ(countAllocated(tree), 1);
+
+    size_t starId = -1, id = -1;                // a step detaches one child, so the grave stays small
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &starId, 0));
+    for (size_t i = 0; i < 10000; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, starId, &id, i));
+    EXPECT_FALSE(gTree_delSubtreeDeferred(tree, starId));
+    EXPECT_EQ(gTree_addChild(tree, starId, &id, 0), gTree_status_BadId);
+    EXPECT_TRUE(gObjPool_idValid(&tree->pool, id));     // the children are taken off id checks by the collector
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_EQ(gTree_collectDeferred(tree, 1, &freed), gTree_status_BadTxn);
+    EXPECT_FALSE(gTree_commit(tree));
+    for (size_t i = 0; i < 10001; ++i) {
+        EXPECT_FALSE(gTree_collectDeferred(tree, 1, &freed));
+        EXPECT_EQ(freed, 1);
+        EXPECT_LE(tree->graveCnt, 1);
+    }
+    EXPECT_FALSE(gObjPool_idValid(&tree->pool, id));
+    EXPECT_EQ(tree->graveCnt, 0);
+    EXPECT_EQ(tree->nodeCnt, 1);
+
+    EXPECT_EQ(gTree_startReaper(tree, 0), gTree_status_BadMode);
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    EXPECT_FALSE(gTree_startReaper(tree, 256));
+    for (size_t round = 0; round < 20; ++round) {
+        size_t subRoot = -1;
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &subRoot, round));
+        id = subRoot;
+        for (size_t i = 0; i < 1000; ++i)
+            EXPECT_FALSE(gTree_addChild(tree, (i % 2) ? subRoot : id, &id, i));
+        gTree_writeLock(tree);
+        EXPECT_FALSE(gTree_delSubtreeDeferred(tree, subRoot));
+        gTree_writeUnlock(tree);
+    }
+    for (size_t i = 0; i < 100000 && __atomic_load_n(&tree->graveCnt, __ATOMIC_ACQUIRE) != 0; ++i)
+        std::this_thread::yield();
+    EXPECT_FALSE(gTree_stopReaper(tree));
+    EXPECT_FALSE(gTree_collectDeferred(tree, -1, NULL));
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+    EXPECT_EQ(checkLinks(tree, tree->root), 1);
+    EXPECT_EQ(tree->nodeCnt, 1);
+    EXPECT_EQ(countAllocated(tree), 1);
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, find_all)
+{
+    std::mt19937 gen(64);
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    randomFill(tree, 30000, gen);
+    size_t deadId = -1;
+    for (size_t i = 0; i < 3000; ++i) {
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &deadId, gen() % 100));
+        EXPECT_FALSE(gTree_delSubtreeDeferred(tree, deadId));
+    }
+    std::vector<size_t> ids;
+    for (size_t id = tree->root; id != -1; id = gTree_nextPreorder(tree, tree->root, id)) {
+        GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->data = gen() % 100;
+        ids.push_back(id);
+    }
+
+    gTree_Intervals intervals = {};
+    EXPECT_FALSE(gTree_buildIntervals(tree, &intervals));
+    for (size_t rootId : {tree->root, ids[ids.size() / 3], ids.back()}) {
+        std::vector<size_t> expected;
+        for (size_t id = rootId; id != -1; id = gTree_nextPreorder(tree, rootId, id)) {
+            int data = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->data;
+            if (10 <= data && data <= 20)
+                expected.push_back(id);
+        }
+        std::sort(expected.begin(), expected.end());
+
+        gTree_Query query = {0, gTree_key_Int32, 10, 20};
+        for (const gTree_Intervals *iv : {(const gTree_Intervals*)&intervals, (const gTree_Intervals*)NULL}) {
+            size_t *found = NULL, cnt = 0;
+            EXPECT_FALSE(gTree_findAll(tree, &query, iv, rootId, &found, &cnt));
+            EXPECT_EQ(std::vector<size_t>(found, found + cnt), expected);
+            free(found);
+        }
+    }
+    gTree_Query bad = {sizeof(int), gTree_key_Int32, 0, 0};
+    size_t *found = NULL, cnt = 0;
+    EXPECT_EQ(gTree_findAll(tree, &bad, &intervals, tree->root, &found, &cnt), gTree_status_BadData);
+    gTree_Query any = {0, gTree_key_Int32, INT32_MIN, INT32_MAX};
+    EXPECT_EQ(gTree_findAll(tree, &any, NULL, deadId, &found, &cnt), gTree_status_BadId);
+    EXPECT_FALSE(gTree_intervalsDtor(&intervals));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, verify)
+{
+    std::mt19937 gen(65);
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    randomFill(tree, 20000, gen);
+    size_t total = checkLinks(tree, tree->root);
+
+    gTree_VerifyReport report = {};
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.reachable, total);
+    EXPECT_EQ(report.reserved + report.orphans, 0);
+    EXPECT_EQ(report.badId, -1);
+
+    size_t orphanId = -1;
+    EXPECT_FALSE(gObjPool_alloc(&tree->pool, &orphanId));
+    size_t firstId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child;
+    size_t graveSize = checkLinks(tree, firstId);
+    EXPECT_FALSE(gTree_delSubtreeDeferred(tree, firstId));
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    size_t id = -1;
+    for (size_t i = 0; i < 10; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, i));
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.reachable, total - graveSize + 10);
+    EXPECT_EQ(report.orphans, 1);
+    EXPECT_EQ(report.reserved, tree->nodeCnt - report.reachable - report.orphans);   // the hand-allocated slot is counted
+    EXPECT_FALSE(gTree_verify(tree, 1000, &report));
+    EXPECT_GT(report.reachable, 0);
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+
+    size_t parentId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child;
+    size_t childId  = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->tail;
+    size_t oldParentId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->parent;
+    EXPECT_FALSE(gTree_addExistChild(tree, parentId, childId));
+    EXPECT_EQ(gTree_verify(tree, 0, &report), gTree_status_BadStructure);
+    EXPECT_TRUE(report.badId == oldParentId || report.badId == childId);
+
+    GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, parentId)->child;
+    EXPECT_EQ(gTree_verify(tree, 0, &report), gTree_status_BadStructure);
+    EXPECT_EQ(gTree_verify(tree, 4 * tree->pool.capacity, &report), gTree_status_BadStructure);
+    EXPECT_FALSE(gObjPool_free(&tree->pool, orphanId));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, collect_garbage)
+{
+    std::mt19937 gen(66);
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    randomFill(tree, 20000, gen);
+
+    size_t scratchId = -1, id = -1;
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &scratchId, 0));
+    for (size_t i = 0; i < 100; ++i)
+        EXPECT_FALSE(gTree_addChild(tree, scratchId, &id, i));
+    EXPECT_FALSE(gTree_unlinkNode(tree, scratchId));
+    EXPECT_FALSE(gTree_addGcRoot(tree, scratchId));
+
+    for (size_t i = 0; i < 50; ++i) {
+        size_t currentId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child;
+        size_t replaceId = -1;
+        EXPECT_FALSE(gTree_addChild(tree, tree->root, &replaceId, i));
+        EXPECT_FALSE(gTree_unlinkNode(tree, replaceId));
+        EXPECT_FALSE(gTree_replaceNode(tree, currentId, replaceId));
+    }
+    gTree_VerifyReport report = {};
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    size_t orphans = report.orphans;
+    EXPECT_GT(orphans, 50);
+
+    size_t freed = 0, totalFreed = 0, steps = 0;
+    bool done = false;
+    while (!done) {
+        EXPECT_FALSE(gTree_collectGarbage(tree, 64, &freed, &done));
+        EXPECT_LE(freed, 64);
+        totalFreed += freed;
+        ++steps;
+
+        std::vector<size_t> ids;
+        for (size_t id = tree->root; id != -1; id = gTree_nextPreorder(tree, tree->root, id))
+            ids.push_back(id);
+        size_t nodeId = ids[gen() % ids.size()];
+        size_t otherId = ids[gen() % ids.size()];
+        if (steps % 3 == 0) {
+            EXPECT_FALSE(gTree_addChild(tree, nodeId, &id, steps));
+        } else if (steps % 3 == 1 && nodeId != tree->root) {
+            bool ancestor = false;
+            for (size_t up = otherId; up != -1; up = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, up)->parent)
+                ancestor |= (up == nodeId);
+            if (!ancestor) {
+                EXPECT_FALSE(gTree_unlinkNode(tree, nodeId));
+                EXPECT_FALSE(gTree_addExistChild(tree, otherId, nodeId));
+            }
+        } else if (nodeId != tree->root) {
+            EXPECT_FALSE(gTree_delSubtree(tree, nodeId));
+        }
+    }
+    EXPECT_GT(steps, 100);
+    EXPECT_EQ(totalFreed, orphans);
+    EXPECT_FALSE(gTree_verify(tree, 0, &report));
+    EXPECT_EQ(report.orphans, 0);
+    EXPECT_EQ(report.reachable, checkLinks(tree, tree->root) + checkLinks(tree, scratchId));
+    EXPECT_EQ(tree->nodeCnt, report.reachable);
+
+    EXPECT_FALSE(gTree_removeGcRoot(tree, scratchId));
+    EXPECT_FALSE(gTree_collectGarbage(tree, -1, &freed, &done));
+    EXPECT_TRUE(done);
+    EXPECT_EQ(freed, 101);
+    EXPECT_EQ(tree->nodeCnt, checkLinks(tree, tree->root));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, stats)
+{
+    std::mt19937 gen(67);
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    randomFill(tree, 5000, gen);
+    for (size_t i = 0; i < 30; ++i) {
+        size_t id = 1 + gen() % (tree->pool.capacity - 1);
+        if (gObjPool_idValid(&tree->pool, id) && GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id)->parent != tree->root) {
+            EXPECT_FALSE(gTree_delSubtree(tree, id));
+        }
+    }
+
+    std::vector<size_t> hist, depths(tree->pool.capacity, 0);
+    size_t cnt = 0, leaves = 0, maxFanout = 0, internal = 0;
+    for (size_t id = tree->root; id != -1; id = gTree_nextPreorder(tree, tree->root, id)) {
+        gTree_Node *node = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, id);
+        if (node->parent != -1 && id != tree->root)
+            depths[id] = depths[node->parent] + 1;
+        if (hist.size() <= depths[id])
+            hist.resize(depths[id] + 1);
+        ++hist[depths[id]];
+        size_t fanout = 0;
+        for (size_t childId = node->child; childId != -1; childId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, childId)->sibling)
+            ++fanout;
+        ++cnt;
+        leaves += (fanout == 0);
+        internal += (fanout != 0);
+        maxFanout = std::max(maxFanout, fanout);
+    }
+
+    gTree_Stats stats = {};
+    EXPECT_FALSE(gTree_stats(tree, -1, &stats));
+    EXPECT_EQ(stats.nodeCnt, cnt);
+    EXPECT_EQ(stats.leafCnt, leaves);
+    EXPECT_EQ(stats.maxFanout, maxFanout);
+    EXPECT_DOUBLE_EQ(stats.avgFanout, (double)(cnt - 1) / internal);
+    EXPECT_EQ(stats.height + 1, hist.size());
+    EXPECT_EQ(std::vector<size_t>(stats.depthHist, stats.depthHist + stats.height + 1), hist);
+    EXPECT_EQ(stats.liveSlots, cnt);
+    EXPECT_EQ(stats.capacity, tree->pool.capacity);
+    EXPECT_GT(stats.holes, 0);
+    double fragmentation = stats.fragmentation;
+    EXPECT_GT(fragmentation, 0.5);
+    EXPECT_FALSE(gTree_statsDtor(&stats));
+
+    size_t cloneId = -1;
+    EXPECT_FALSE(gTree_cloneSubtree(tree, tree->root, &cloneId));
+    EXPECT_FALSE(gTree_stats(tree, cloneId, &stats));
+    EXPECT_EQ(stats.nodeCnt, cnt);
+    EXPECT_EQ(stats.height + 1, hist.size());
+    EXPECT_EQ(stats.liveSlots, tree->nodeCnt);
+    EXPECT_LT(stats.fragmentation, fragmentation / 4);
+    EXPECT_FALSE(gTree_statsDtor(&stats));
+
+    size_t leafId = tree->root;
+    while (GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, leafId)->child != -1)
+        leafId = GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, leafId)->child;
+    EXPECT_FALSE(gTree_stats(tree, leafId, &stats));
+    EXPECT_EQ(stats.nodeCnt, 1);
+    EXPECT_EQ(stats.leafCnt, 1);
+    EXPECT_EQ(stats.height, 0);
+    EXPECT_EQ(stats.depthHist[0], 1);
+    EXPECT_FALSE(gTree_statsDtor(&stats));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+static size_t payloadHeap(void *arg)
+{
+    return *(size_t*)arg;
+}
+
+TEST(Auto, memory_usage)
+{
+    std::mt19937 gen(68);
+    gTree treeStruct;
+    gTree *tree = &treeStruct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    randomFill(tree, 1000, gen);
+
+    gTree_MemoryUsage usage = {};
+    EXPECT_FALSE(gTree_memoryUsage(tree, &usage));
+    size_t slotSize = (usage.liveNodes + usage.freeNodes) / tree->pool.capacity;
+    EXPECT_GE(slotSize, sizeof(gTree_Node));
+    EXPECT_EQ(usage.liveNodes, 1000 * slotSize);
+    EXPECT_EQ(usage.payload, 1000 * sizeof(int));
+    EXPECT_EQ(usage.links + usage.payload, usage.liveNodes);
+    EXPECT_EQ(usage.payloadHeap, 0);
+    EXPECT_EQ(usage.logs, 0);
+
+    size_t heap = 12345;
+    EXPECT_FALSE(gTree_setPayloadHeapHook(tree, payloadHeap, &heap));
+    EXPECT_FALSE(gTree_beginTxn(tree));
+    EXPECT_FALSE(gTree_delSubtree(tree, GOBJPOOL_VAL_BY_ID_UNSAFE(&tree->pool, tree->root)->child));
+    gTree_MemoryUsage txnUsage = {};
+    EXPECT_FALSE(gTree_memoryUsage(tree, &txnUsage));
+    EXPECT_EQ(txnUsage.payloadHeap, heap);
+    EXPECT_GE(txnUsage.logs, tree->undoCnt * sizeof(gTree_UndoRec));
+    EXPECT_EQ(txnUsage.total - txnUsage.logs - txnUsage.payloadHeap, usage.total - usage.logs);
+    EXPECT_FALSE(gTree_rollback(tree));
+
+    EXPECT_FALSE(gTree_setConcurrent(tree, true));
+    size_t id = -1;
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, 0));
+    EXPECT_FALSE(gTree_memoryUsage(tree, &usage));
+    EXPECT_GE(usage.index, GTREE_MAX_MAGAZINES * sizeof(gTree_Magazine));
+    EXPECT_EQ(usage.liveNodes, tree->nodeCnt * slotSize);
+    EXPECT_FALSE(gTree_setConcurrent(tree, false));
+    EXPECT_FALSE(gTree_dtor(tree));
+}
+
+TEST(Auto, generate)
+{
+    const size_t n = 3000;
+    for (int shape = 0; shape < gTree_gen_Replay; ++shape) {
+        for (size_t arity : {0, 2, 4}) {
+            if (arity == 0 && shape == gTree_gen_Kary)
+                continue;
+            gTree_GenParams params = {};
+            params.shape = (gTree_GenShape)shape;
+            params.nodeCnt = n;
+            params.seed = 69 + arity;
+            params.arity = arity;
+
+            gTree trees[2];
+            size_t *recorded[2] = {};
+            size_t recordedCnt[2] = {};
+            for (int t = 0; t < 2; ++t) {
+                gTree *tree = &trees[t];
+                EXPECT_FALSE(gTree_ctor(tree, NULL));
+                size_t nodeCnt = tree->nodeCnt;
+                std::vector<size_t> ids(n);
+                EXPECT_FALSE(gTree_generate(tree, tree->root, &params, ids.data()));
+                EXPECT_EQ(tree->nodeCnt, nodeCnt + n - 1);
+                EXPECT_EQ(ids[0], tree->root);
+                EXPECT_FALSE(gTree_verify(tree, 0, NULL));
+                EXPECT_FALSE(gTree_recordParents(tree, tree->root, &recorded[t], &recordedCnt[t]));
+                EXPECT_EQ(recordedCnt[t], n);
+            }
+            EXPECT_EQ(memcmp(recorded[0], recorded[1], n * sizeof(size_t)), 0);
+
+            gTree_Stats stats = {};
+            EXPECT_FALSE(gTree_stats(&trees[0], -1, &stats));
+            if (shape == gTree_gen_Chain) {
+                EXPECT_EQ(stats.height, n - 1);
+            } else if (shape == gTree_gen_Star) {
+                EXPECT_EQ(stats.maxFanout, n - 1);
+            } else if (shape == gTree_gen_Kary || (shape == gTree_gen_GaltonWatson && arity != 0)) {
+                EXPECT_LE(stats.maxFanout, arity);
+                EXPECT_GT(stats.maxFanout, 1);
+            }
+            EXPECT_FALSE(gTree_statsDtor(&stats));
+
+            gTree replayed;
+            EXPECT_FALSE(gTree_ctor(&replayed, NULL));
+            gTree_GenParams replay = {};
+            replay.shape = gTree_gen_Replay;
+            replay.nodeCnt = n;
+            replay.parents = recorded[0];
+            EXPECT_FALSE(gTree_generate(&replayed, replayed.root, &replay, NULL));
+            size_t *replayedParents = NULL, replayedCnt = 0;
+            EXPECT_FALSE(gTree_recordParents(&replayed, replayed.root, &replayedParents, &replayedCnt));
+            EXPECT_EQ(replayedCnt, n);
+            EXPECT_EQ(memcmp(recorded[0], replayedParents, n * sizeof(size_t)), 0);
+
+            free(replayedParents);
+            for (int t = 0; t < 2; ++t) {
+                free(recorded[t]);
+                EXPECT_FALSE(gTree_dtor(&trees[t]));
+            }
+            EXPECT_FALSE(gTree_dtor(&replayed));
+        }
+    }
+
+    size_t badParents[] = {(size_t)-1, 0, 2};
+    gTree_GenParams bad = {};
+    bad.shape = gTree_gen_Replay;
+    bad.nodeCnt = 3;
+    bad.parents = badParents;
+    std::vector<size_t> parents(3);
+    EXPECT_EQ(gTree_genParents(&bad, parents.data()), gTree_status_BadData);
+    bad.shape = gTree_gen_Kary;
+    EXPECT_EQ(gTree_genParents(&bad, parents.data()), gTree_status_BadData);
+}
+
+static void ignoreEvents(const gTree *, const gTree_Event *, size_t, void *) {}
+
+TEST(Auto, compiled_out_features)
+{
+    gTree tree_struct;
+    gTree *tree = &tree_struct;
+    EXPECT_FALSE(gTree_ctor(tree, NULL));
+    gTree_Counters counters = {};
+    EXPECT_EQ(gTree_getCounters(tree, &counters), gTree_status_BadMode);
+    EXPECT_EQ(gTree_resetCounters(tree), gTree_status_BadMode);
+    gTree_LatencySummary summary = {};
+    EXPECT_EQ(gTree_latencySummary(tree, gTree_lat_AddChild, &summary), gTree_status_BadMode);
+    EXPECT_EQ(gTree_resetLatency(tree), gTree_status_BadMode);
+    EXPECT_EQ(gTree_addObserver(tree, ignoreEvents, NULL), gTree_status_BadMode);
+    EXPECT_EQ(gTree_removeObserver(tree, ignoreEvents, NULL), gTree_status_BadMode);
+
+    size_t id = -1;
+    EXPECT_FALSE(gTree_addChild(tree, tree->root, &id, 1));
+    EXPECT_FALSE(gTree_setData(tree, id, 2));
+    EXPECT_FALSE(gTree_delSubtree(tree, id));
+    EXPECT_FALSE(gTree_dtor(tree));
+}